@@ -20,7 +20,7 @@ public class LibraryWrapper
 
   public int add_to_arg(int v)
   {
-    int sp = (CRunTime.memory.length * 4) - 8;
+    int sp = CRunTime.getMemorySize() - 8;
     try {
     return CibylCallTable.call(this.cb_add_to_arg, sp, v, 0, 0, 0);
     } catch(Exception e)
@@ -33,7 +33,7 @@ public class LibraryWrapper
 
   public int get_int_pointer()
   {
-    int sp = (CRunTime.memory.length * 4) - 8;
+    int sp = CRunTime.getMemorySize() - 8;
     try {
     return CibylCallTable.call(this.cb_get_int_pointer, sp, 0, 0, 0, 0);
     } catch(Exception e)
@@ -46,7 +46,7 @@ public class LibraryWrapper
 
   public void update_pointer(int ptr)
   {
-    int sp = (CRunTime.memory.length * 4) - 8;
+    int sp = CRunTime.getMemorySize() - 8;
     try {
     CibylCallTable.call(this.cb_update_pointer, sp, ptr, 0, 0, 0);
     } catch(Exception e)
@@ -21,7 +21,7 @@ public class StandaloneMain
         int destructors = CibylCallTable.getAddressByName("__do_global_dtors_aux");
 
         CRunTime.init(is);
-        int sp = (CRunTime.memory.length * 4) - 8;
+        int sp = CRunTime.getMemorySize() - 8;
         CRunTime.publishCallback("Cibyl.atexit"); /* Never used! */
         CibylCallTable.call(start, sp, 0, 0, 0, 0);
         CibylCallTable.call(destructors, sp, 0, 0, 0, 0);
@@ -38,7 +38,7 @@ public class StandaloneMain
     try {
         int destructors = CibylCallTable.getAddressByName("__do_global_dtors_aux");
 
-        int sp = (CRunTime.memory.length * 4) - 8;
+        int sp = CRunTime.getMemorySize() - 8;
         CibylCallTable.call(destructors, sp, 0, 0, 0, 0);
     } catch(Exception e)
     {
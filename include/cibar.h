@@ -21,11 +21,15 @@ extern "C" {
 
 typedef struct
 {
-  uint8_t   *data;
+  uint8_t   *data;      /* NULL for v2 archives, read on demand */
   size_t     data_size;
   struct s_cibar *cibar;
 
   char      *name;
+
+  uint32_t   offset;    /* Offset from the start of the data (v2) */
+  uint32_t   hash;      /* Hash of name (v2) */
+  uint32_t   next;      /* Next entry in the hash chain (v2) */
 } cibar_file_entry_t;
 
 typedef struct s_cibar
@@ -34,6 +38,12 @@ typedef struct s_cibar
   uint8_t      *data;
   char         *strings;
 
+  int           version;
+  FILE         *fp;          /* The archive, v2 reads file data from it */
+  uint32_t      data_start;  /* Start of the data in fp (v2) */
+  uint32_t      hash_size;
+  uint32_t     *buckets;
+
   cibar_file_entry_t files[];
 } cibar_t;
 
@@ -44,10 +54,13 @@ typedef struct
 } cibar_file_t;
 
 /**
- * Open a cibar
+ * Open a cibar. For version 1 archives, all data is read into
+ * memory. For version 2 archives, only the index is read and file
+ * data is read from @a f when the files are read, so @a f must be
+ * kept open (and seekable) until the cibar is closed.
  *
  * @param f the file to read the cibar from
-  *
+ *
  * @return a pointer to the new cibar
  */
 cibar_t *cibar_open(FILE *f);
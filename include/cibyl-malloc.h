@@ -0,0 +1,53 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      cibyl-malloc.h
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Size-class allocator interface
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#ifndef __CIBYL_MALLOC_H__
+#define __CIBYL_MALLOC_H__
+
+#include <stddef.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * The default malloc in libc is a best-fit allocator on a single list
+ * of free blocks. libsizeclass-malloc replaces it with segregated
+ * size classes for small blocks and coalescing bins for large
+ * ones. Select it at link time with
+ *
+ *   -Wl,--whole-archive -lsizeclass-malloc -Wl,--no-whole-archive
+ */
+typedef struct
+{
+  size_t pool_size;            /* Size of the smalloc_set_memory_pool region */
+  size_t bytes_in_use;         /* Bytes in allocated blocks (incl. headers) */
+  size_t peak_bytes_in_use;
+  size_t bytes_cached_small;   /* Free bytes held in the size-class lists */
+  size_t bytes_free_large;     /* Free bytes in the large bins */
+  size_t largest_free_block;
+  unsigned long n_mallocs;
+  unsigned long n_frees;
+  unsigned long n_small_refills; /* Number of slabs carved for small classes */
+} cibyl_malloc_stats_t;
+
+/**
+ * Get allocator statistics. Only available with libsizeclass-malloc.
+ *
+ * @param out the structure to fill in
+ */
+void cibyl_malloc_get_stats(cibyl_malloc_stats_t *out);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !__CIBYL_MALLOC_H__ */
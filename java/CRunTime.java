@@ -15,6 +15,8 @@ import java.util.*;
 public class CRunTime
 {
   public static int memory[];
+  /* Used instead of memory when translated with memory_model=byte */
+  public static byte memoryBytes[];
 
   public static int saved_v1; /* Result from functions */
   public static int ra; /* For the debug target */
@@ -22,49 +24,146 @@ public class CRunTime
   /* Pointer to the top of the event stack */
   public static int eventStackPointer;
 
+  /*
+   * Objects passed to C are referenced by their index in
+   * objectRepository. Free slots are linked through repositoryNext
+   * from firstFree, and slots registered in an object scope are linked
+   * in a per-scope list through repositoryNext/repositoryPrev. Slot 0
+   * is the invalid object and ends the lists.
+   */
   public static Object objectRepository[];
-  private static int maxRepositoryObjects;
+  private static int repositoryNext[];
+  private static int repositoryPrev[];
+  private static int repositoryScope[];
+  private static int repositoryGeneration[];
   private static int firstFree;
-  private static Hashtable callbacksByName;
+  private static int scopeHeads[];
+  private static int scopeDepth;
+
+  /* With thread_safe=1, C threads update the repository concurrently */
+  private static final Object repositoryLock = new Object();
+
+  /*
+   * Callbacks are identified by their index in these. The slot is in
+   * the dense CibylCallTable.callCallback table, or -1 to call the
+   * address through CibylCallTable.call.
+   */
+  private static String callbackNames[];
+  private static int callbackAddresses[];
+  private static int callbackSlots[];
+  private static int nCallbacks;
+  private static Vector exitHooks = new Vector();
+
+  /* Reused for bulk copies, see getTransferBuffer() */
+  public static final Object transferLock = new Object();
+  private static byte[] transferBuffer = new byte[0];
+  private static final int TRANSFER_CHUNK_SIZE = 8192;
+
+  /* With check_object_handles, handles are (generation << 20) | index */
+  private static final int HANDLE_INDEX_BITS = 20;
+  private static final int HANDLE_INDEX_MASK = (1 << HANDLE_INDEX_BITS) - 1;
+  private static final int HANDLE_GENERATION_MASK = 0x7ff;
+
+  /* The program.data.bin header, written by the translator */
+  private static final int DATA_IMAGE_MAGIC = 0x43494d47; /* "CIMG" */
+  private static final int DATA_IMAGE_VERSION = 1;
+
+  /* Size of .data/.rodata and .bss from the data image */
+  public static int staticDataSize;
 
   /**
    * Initialize the C runtime. This must be called before the C
    * runtime is used.
    *
-   * @param memoryImage the contents of the .data and .rodata sections
+   * @param codeStream the data image (program.data.bin) with the
+   * contents of the .data and .rodata sections
    * @param memorySize the total size of the memory, should be larger
-   * than memoryImage to fit the .bss, the heap and the stack
+   * than the data image to fit the .bss, the heap and the stack
    */
   public static final void init(InputStream codeStream, int memorySize) throws Exception
   {
-    CRunTime.maxRepositoryObjects = 256;
-    CRunTime.callbacksByName = new Hashtable();
-    CRunTime.objectRepository = new Object[ CRunTime.maxRepositoryObjects ];
-    CRunTime.objectRepository[0] = null;
-
-    /* 0 is the invalid object, 1 is the exception object */
-    CRunTime.firstFree = 2;
+    DataInputStream in = new DataInputStream(codeStream);
 
-    CRunTime.memory = new int[memorySize / 4];
+    CRunTime.callbackNames = new String[8];
+    CRunTime.callbackAddresses = new int[8];
+    CRunTime.callbackSlots = new int[8];
+    CRunTime.nCallbacks = 0;
+    CRunTime.objectRepository = null;
+    CRunTime.scopeHeads = new int[8];
+    CRunTime.scopeDepth = 0;
+    CRunTime.growRepository(256);
+
+    if (in.readInt() != DATA_IMAGE_MAGIC)
+      throw new Exception("The data image is not in the Cibyl format");
+    if (in.readInt() != DATA_IMAGE_VERSION)
+      throw new Exception("Unknown data image version");
+    int imageSize = in.readInt();
+    int bssSize = in.readInt();
+    int nRecords = in.readInt();
+
+    CRunTime.staticDataSize = imageSize + bssSize;
+    if (CRunTime.staticDataSize + CibylConfig.stackSize +
+        CibylConfig.eventStackSize > memorySize)
+      throw new Exception("Memory size " + memorySize + " too small, need at least " +
+                          (CRunTime.staticDataSize + CibylConfig.stackSize +
+                           CibylConfig.eventStackSize));
+
+    if (CibylCallTable.byteMemory)
+      CRunTime.memoryBytes = new byte[memorySize];
+    else
+      CRunTime.memory = new int[memorySize / 4];
 
-    /* Copy memory */
-    int len = codeStream.available() / 4;
-    for (int i=0; i<len; i++)
+    /* Copy the records, zeroes are left out of the image */
+    byte buf[] = null;
+    for (int r = 0; r < nRecords; r++)
       {
-	int b0 = codeStream.read();
-	int b1 = codeStream.read();
-	int b2 = codeStream.read();
-	int b3 = codeStream.read();
-	CRunTime.memory[i] = ((b0 & 0xff) << 24) | ((b1 & 0xff) << 16) | ((b2 & 0xff) << 8) | (b3 & 0xff);
+        int address = in.readInt();
+        int len = in.readInt();
+
+        if (CibylCallTable.byteMemory)
+          {
+            in.readFully(CRunTime.memoryBytes, address, len);
+            continue;
+          }
+
+        if (buf == null)
+          buf = new byte[Math.min(len, 16384)];
+        else if (buf.length < len && buf.length < 16384)
+          buf = new byte[Math.min(len, 16384)];
+        while (len > 0)
+          {
+            int n = Math.min(len, buf.length);
+            int idx = address >> 2;
+
+            in.readFully(buf, 0, n);
+            for (int i = 0; i < n; i += 4)
+              CRunTime.memory[idx++] = ((buf[i] & 0xff) << 24) | ((buf[i + 1] & 0xff) << 16) |
+                ((buf[i + 2] & 0xff) << 8) | (buf[i + 3] & 0xff);
+            address += n;
+            len -= n;
+          }
       }
 
-    CRunTime.memory[1] = CibylConfig.stackSize;
-    CRunTime.memory[3] = memorySize - (CibylConfig.eventStackSize - 8);
+    CRunTime.memoryWriteWord(4, CibylConfig.stackSize);
+    CRunTime.memoryWriteWord(12, memorySize - (CibylConfig.eventStackSize - 8));
+  }
+
+  /**
+   * Get the size of the C memory in bytes
+   *
+   * @return the memory size
+   */
+  public static final int getMemorySize()
+  {
+    if (CibylCallTable.byteMemory)
+      return CRunTime.memoryBytes.length;
+    return CRunTime.memory.length * 4;
   }
 
   public static final void init(InputStream codeStream) throws Exception
   {
     CRunTime.memory = null;
+    CRunTime.memoryBytes = null;
     CRunTime.objectRepository = null;
     System.gc();
 
@@ -150,55 +249,220 @@ public class CRunTime
     return out;
   }
 
+  private static final void growRepository(int size)
+  {
+    int old = 0;
+
+    if (CRunTime.objectRepository != null)
+      old = CRunTime.objectRepository.length;
+
+    Object objs[] = new Object[size];
+    int next[] = new int[size];
+    int prev[] = new int[size];
+    int scope[] = new int[size];
+    int generation[] = new int[size];
+
+    if (old != 0)
+      {
+        System.arraycopy(CRunTime.objectRepository, 0, objs, 0, old);
+        System.arraycopy(CRunTime.repositoryNext, 0, next, 0, old);
+        System.arraycopy(CRunTime.repositoryPrev, 0, prev, 0, old);
+        System.arraycopy(CRunTime.repositoryScope, 0, scope, 0, old);
+        System.arraycopy(CRunTime.repositoryGeneration, 0, generation, 0, old);
+      }
+    else
+      old = 2; /* 0 is the invalid object, 1 is the exception object */
+
+    /* Link the new slots into the free list (which is empty here) */
+    for (int i = old; i < size - 1; i++)
+      next[i] = i + 1;
+    next[size - 1] = 0;
+
+    CRunTime.objectRepository = objs;
+    CRunTime.repositoryNext = next;
+    CRunTime.repositoryPrev = prev;
+    CRunTime.repositoryScope = scope;
+    CRunTime.repositoryGeneration = generation;
+    CRunTime.firstFree = old;
+  }
+
+  private static final int handleToIndex(int handle)
+  {
+    if (!CibylCallTable.checkObjectHandles)
+      return handle;
+
+    int idx = handle & HANDLE_INDEX_MASK;
+
+    if (handle != 0 &&
+        (idx >= CRunTime.objectRepository.length ||
+         CRunTime.objectRepository[idx] == null ||
+         (handle >>> HANDLE_INDEX_BITS) != CRunTime.repositoryGeneration[idx]))
+      throw new IllegalArgumentException("Stale object handle 0x" + Integer.toHexString(handle));
+
+    return idx;
+  }
+
   public static Object getRegisteredObject(int handle)
   {
-    return CRunTime.objectRepository[handle];
+    return CRunTime.objectRepository[CRunTime.handleToIndex(handle)];
   }
 
   public static int registerObject(Object obj)
   {
-    int ret = CRunTime.firstFree;
-    int i;
+    if (CibylCallTable.threadSafe)
+      {
+        synchronized (CRunTime.repositoryLock)
+          {
+            return CRunTime.registerObjectUnlocked(obj);
+          }
+      }
+    return CRunTime.registerObjectUnlocked(obj);
+  }
 
+  private static int registerObjectUnlocked(Object obj)
+  {
     // Invalid object
     if (obj == null)
         return 0;
 
-    CRunTime.objectRepository[ret] = obj;
-    for (i=CRunTime.firstFree; i < CRunTime.objectRepository.length; i++)
+    if (CRunTime.firstFree == 0)
+      CRunTime.growRepository(CRunTime.objectRepository.length * 2);
+
+    int idx = CRunTime.firstFree;
+    int scope = CRunTime.scopeDepth;
+
+    CRunTime.firstFree = CRunTime.repositoryNext[idx];
+    CRunTime.objectRepository[idx] = obj;
+    CRunTime.repositoryScope[idx] = scope;
+
+    /* Link into the list of the current scope */
+    if (scope > 0)
       {
-	if (CRunTime.objectRepository[i] == null)
-	  {
-	    CRunTime.firstFree = i;
-	    return ret;
-	  }
+        int head = CRunTime.scopeHeads[scope];
+
+        CRunTime.repositoryPrev[idx] = 0;
+        CRunTime.repositoryNext[idx] = head;
+        if (head != 0)
+          CRunTime.repositoryPrev[head] = idx;
+        CRunTime.scopeHeads[scope] = idx;
       }
 
-    if (i == CRunTime.objectRepository.length)
+    if (CibylCallTable.checkObjectHandles)
+      return (CRunTime.repositoryGeneration[idx] << HANDLE_INDEX_BITS) | idx;
+
+    return idx;
+  }
+
+  private static final void releaseSlot(int idx)
+  {
+    CRunTime.objectRepository[idx] = null;
+    CRunTime.repositoryScope[idx] = 0;
+    if (CibylCallTable.checkObjectHandles)
+      CRunTime.repositoryGeneration[idx] = (CRunTime.repositoryGeneration[idx] + 1) & HANDLE_GENERATION_MASK;
+    CRunTime.repositoryNext[idx] = CRunTime.firstFree;
+    CRunTime.firstFree = idx;
+  }
+
+  public static Object deRegisterObject(int handle)
+  {
+    if (CibylCallTable.threadSafe)
       {
-	CRunTime.maxRepositoryObjects = CRunTime.maxRepositoryObjects * 2;
-	Object tmp[] = new Object[CRunTime.maxRepositoryObjects];
+        synchronized (CRunTime.repositoryLock)
+          {
+            return CRunTime.deRegisterObjectUnlocked(handle);
+          }
+      }
+    return CRunTime.deRegisterObjectUnlocked(handle);
+  }
 
-	for (i = 0; i < CRunTime.objectRepository.length; i++)
-	  tmp[i] = CRunTime.objectRepository[i];
-	tmp[i] = obj;
-	CRunTime.objectRepository = tmp;
+  private static Object deRegisterObjectUnlocked(int handle)
+  {
+    int idx = CRunTime.handleToIndex(handle);
+    Object out = CRunTime.objectRepository[idx];
+
+    /* Invalid or already free */
+    if (out == null)
+      return null;
 
-	ret = i;
+    /* Unlink from the scope list */
+    int scope = CRunTime.repositoryScope[idx];
+    if (scope > 0)
+      {
+        int next = CRunTime.repositoryNext[idx];
+        int prev = CRunTime.repositoryPrev[idx];
+
+        if (prev != 0)
+          CRunTime.repositoryNext[prev] = next;
+        else
+          CRunTime.scopeHeads[scope] = next;
+        if (next != 0)
+          CRunTime.repositoryPrev[next] = prev;
       }
+    CRunTime.releaseSlot(idx);
 
-    return ret;
+    return out;
   }
 
-  public static Object deRegisterObject(int handle)
+  /**
+   * Start a new object scope. Objects registered until the matching
+   * popObjectScope are released together there.
+   */
+  public static void pushObjectScope()
   {
-    Object out = CRunTime.getRegisteredObject(handle);
+    if (CibylCallTable.threadSafe)
+      {
+        synchronized (CRunTime.repositoryLock)
+          {
+            CRunTime.pushObjectScopeUnlocked();
+          }
+        return;
+      }
+    CRunTime.pushObjectScopeUnlocked();
+  }
 
-    if (CRunTime.firstFree > handle)
-      CRunTime.firstFree = handle;
-    CRunTime.objectRepository[handle] = null;
+  private static void pushObjectScopeUnlocked()
+  {
+    CRunTime.scopeDepth++;
+    if (CRunTime.scopeDepth == CRunTime.scopeHeads.length)
+      {
+        int tmp[] = new int[CRunTime.scopeHeads.length * 2];
 
-    return out;
+        System.arraycopy(CRunTime.scopeHeads, 0, tmp, 0, CRunTime.scopeHeads.length);
+        CRunTime.scopeHeads = tmp;
+      }
+    CRunTime.scopeHeads[CRunTime.scopeDepth] = 0;
+  }
+
+  /**
+   * Release all objects still registered in the current object scope
+   */
+  public static void popObjectScope()
+  {
+    if (CibylCallTable.threadSafe)
+      {
+        synchronized (CRunTime.repositoryLock)
+          {
+            CRunTime.popObjectScopeUnlocked();
+          }
+        return;
+      }
+    CRunTime.popObjectScopeUnlocked();
+  }
+
+  private static void popObjectScopeUnlocked()
+  {
+    if (CRunTime.scopeDepth == 0)
+      return;
+
+    int idx = CRunTime.scopeHeads[CRunTime.scopeDepth];
+    while (idx != 0)
+      {
+        int next = CRunTime.repositoryNext[idx];
+
+        CRunTime.releaseSlot(idx);
+        idx = next;
+      }
+    CRunTime.scopeDepth--;
   }
 
   /**
@@ -211,68 +475,182 @@ public class CRunTime
    */
   public static int publishCallback(String name)
   {
-    int id = CRunTime.registerObject(new Integer(0)); /* Used to get an id, 0 means nothing here */
-    Integer intObject = new Integer(id);
+    int id = CRunTime.nCallbacks;
 
-    CRunTime.callbacksByName.put(name, intObject);   /* Register name:id */
+    if (id == CRunTime.callbackNames.length)
+      {
+        String names[] = new String[id * 2];
+        int addresses[] = new int[id * 2];
+        int slots[] = new int[id * 2];
+
+        System.arraycopy(CRunTime.callbackNames, 0, names, 0, id);
+        System.arraycopy(CRunTime.callbackAddresses, 0, addresses, 0, id);
+        System.arraycopy(CRunTime.callbackSlots, 0, slots, 0, id);
+        CRunTime.callbackNames = names;
+        CRunTime.callbackAddresses = addresses;
+        CRunTime.callbackSlots = slots;
+      }
+    CRunTime.callbackNames[id] = name;
+    CRunTime.callbackAddresses[id] = 0; /* Not registered */
+    CRunTime.callbackSlots[id] = -1;
+    CRunTime.nCallbacks++;
 
     return id;
   }
 
+  /**
+   * Add a hook which is run when the program exits, e.g., to write
+   * out profiling data.
+   *
+   * @param hook the hook to run
+   */
+  public static final void addExitHook(Runnable hook)
+  {
+    CRunTime.exitHooks.addElement(hook);
+  }
+
+  /**
+   * Run (and remove) the exit hooks. This is called from exit() and
+   * when the MIDlet or standalone program quits.
+   */
+  public static final void runExitHooks()
+  {
+    Vector hooks = CRunTime.exitHooks;
+
+    CRunTime.exitHooks = new Vector();
+    for (int i = 0; i < hooks.size(); i++)
+      ((Runnable)hooks.elementAt(i)).run();
+  }
+
+  /* Compare a C string with name without creating a String */
+  private static boolean charPtrEquals(int charPtr, String name)
+  {
+    int len = name.length();
+
+    for (int i = 0; i < len; i++)
+      {
+        if (CRunTime.memoryReadByteUnsigned(charPtr + i) != name.charAt(i))
+          return false;
+      }
+    return CRunTime.memoryReadByteUnsigned(charPtr + len) == 0;
+  }
+
   /**
    * Register a callback function for a particular string.
    *
    * @param charPtr a C char* with the name of the callback
    * @param fnPtr the function pointer that implements the callback
    *
-   * @return the callback id
+   * @return the previously registered function pointer
    */
   public static int registerCallback(int charPtr, int fnPtr)
   {
-    String name = CRunTime.charPtrToString(charPtr);
-    Integer id = (Integer)CRunTime.callbacksByName.get(name);
-    Integer old = (Integer)CRunTime.objectRepository[id.intValue()];
+    for (int id = 0; id < CRunTime.nCallbacks; id++)
+      {
+        if (!CRunTime.charPtrEquals(charPtr, CRunTime.callbackNames[id]))
+          continue;
+
+        int old = CRunTime.callbackAddresses[id];
+
+        CRunTime.callbackAddresses[id] = fnPtr;
+        CRunTime.callbackSlots[id] = CibylCallTable.getCallbackSlot(fnPtr);
 
-    CRunTime.objectRepository[id.intValue()] = new Integer(fnPtr); /* Replace with the fn ptr */
+        return old;
+      }
 
-    return old.intValue();
+    throw new RuntimeException("No callback " + CRunTime.charPtrToString(charPtr));
   }
 
   /* Invoke a registered callback */
   public static long invokeCallback(int which, int a0, int a1, int a2, int a3) throws Exception
   {
-    Integer id = (Integer)CRunTime.objectRepository[which];
+    int slot = CRunTime.callbackSlots[which];
+
+    if (slot >= 0)
+      return CibylCallTable.callCallback(slot, CRunTime.eventStackPointer,
+                                         a0, a1, a2, a3);
 
     /* If this callback is not yet registered, just return 0 */
-    if (id.intValue() == 0)
-	return 0;
+    if (CRunTime.callbackAddresses[which] == 0)
+      return 0;
 
-    return CibylCallTable.call(id.intValue(),
+    return CibylCallTable.call(CRunTime.callbackAddresses[which],
 			       CRunTime.eventStackPointer,
 			       a0, a1, a2, a3); /* a0 ... a3 */
   }
 
   /* Misc. utils */
+  public static final int strlen(int address)
+  {
+    int p = address;
+
+    if (CibylCallTable.byteMemory)
+      {
+        while (CRunTime.memoryBytes[p] != 0)
+          p++;
+        return p - address;
+      }
+
+    while ((p & 3) != 0)
+      {
+        if (CRunTime.memoryReadByteUnsigned(p) == 0)
+          return p - address;
+        p++;
+      }
+
+    /* Word-at-a-time until a word with a zero byte */
+    int idx = p >> 2;
+    while (true)
+      {
+        int w = CRunTime.memory[idx];
+
+        if (((w - 0x01010101) & ~w & 0x80808080) != 0)
+          break;
+        idx++;
+      }
+
+    p = idx << 2;
+    while (CRunTime.memoryReadByteUnsigned(p) != 0)
+      p++;
+
+    return p - address;
+  }
+
+  /*
+   * Strings in .rodata never change, so with cache_rodata_strings
+   * these are kept in a small direct-mapped cache
+   */
+  private static final int STRING_CACHE_SIZE = 256;
+  private static int stringCacheAddresses[];
+  private static String stringCacheStrings[];
+
   public static String charPtrToString(int address)
   {
-    int startAddress = address;
-    int i = 0;
-    int len = 0;
+    int slot = 0;
 
-    while (CRunTime.memoryReadByte(startAddress + len) != 0)
+    /* The cache is not updated atomically, so it's not used with threads */
+    if (!CibylCallTable.threadSafe &&
+        address >= CibylCallTable.rodataStart && address < CibylCallTable.rodataEnd)
       {
-	len++;
+        if (CRunTime.stringCacheStrings == null)
+          {
+            CRunTime.stringCacheAddresses = new int[STRING_CACHE_SIZE];
+            CRunTime.stringCacheStrings = new String[STRING_CACHE_SIZE];
+          }
+        slot = (address ^ (address >>> 8)) & (STRING_CACHE_SIZE - 1);
+        if (CRunTime.stringCacheAddresses[slot] == address &&
+            CRunTime.stringCacheStrings[slot] != null)
+          return CRunTime.stringCacheStrings[slot];
       }
 
+    int len = CRunTime.strlen(address);
+
     if (len == 0)
       return "";
 
     byte vec[] = new byte[len];
 
-    for (i = 0; i < len; i++)
-      {
-	vec[i] = (byte)CRunTime.memoryReadByte(startAddress + i);
-      }
+    CRunTime.memcpy(vec, 0, address, len);
     try
       {
 	String str;
@@ -281,6 +659,13 @@ public class CRunTime
 	else
 	  str = new String(vec, CibylConfig.stringEncoding);
 
+        if (CRunTime.stringCacheStrings != null &&
+            address >= CibylCallTable.rodataStart && address < CibylCallTable.rodataEnd)
+          {
+            CRunTime.stringCacheAddresses[slot] = address;
+            CRunTime.stringCacheStrings[slot] = str;
+          }
+
 	return str;
       }
     catch (UnsupportedEncodingException e)
@@ -289,8 +674,38 @@ public class CRunTime
       }
   }
 
+  /**
+   * Write a String to a C char*, truncating it to maxlen - 1
+   * characters and NULL-terminating it.
+   *
+   * @return the number of characters written
+   */
+  public static int stringToCharPtr(String str, int address, int maxlen)
+  {
+    int len = str.length();
+
+    if (maxlen <= 0)
+      return 0;
+    if (len > maxlen - 1)
+      len = maxlen - 1;
+
+    byte vec[] = new byte[len + 1];
+    for (int i = 0; i < len; i++)
+      vec[i] = (byte)str.charAt(i);
+    vec[len] = 0;
+    CRunTime.memcpy(address, vec, 0, len + 1);
+
+    return len;
+  }
+
   public static final void memoryWriteByte(int address, int in)
   {
+    if (CibylCallTable.byteMemory)
+      {
+        CRunTime.memoryBytes[address] = (byte)in;
+        return;
+      }
+
     int value = in & 0xff;
     int cur = CRunTime.memory[address / 4];
     int b = (3 - (address & 3)) << 3;
@@ -303,6 +718,13 @@ public class CRunTime
 
   public static final void memoryWriteShort(int address, int in)
   {
+    if (CibylCallTable.byteMemory)
+      {
+        CRunTime.memoryBytes[address] = (byte)(in >> 8);
+        CRunTime.memoryBytes[address + 1] = (byte)in;
+        return;
+      }
+
     int value = in & 0xffff;
     int cur = CRunTime.memory[address / 4];
     int b = (2 - (address & 2)) << 3;
@@ -315,11 +737,27 @@ public class CRunTime
 
   public static final void memoryWriteWord(int address, int in)
   {
+    if (CibylCallTable.byteMemory)
+      {
+        CRunTime.memoryBytes[address] = (byte)(in >> 24);
+        CRunTime.memoryBytes[address + 1] = (byte)(in >> 16);
+        CRunTime.memoryBytes[address + 2] = (byte)(in >> 8);
+        CRunTime.memoryBytes[address + 3] = (byte)in;
+        return;
+      }
+
     CRunTime.memory[address / 4] = in;
   }
 
   public static final void memoryWriteLong(int address, long in)
   {
+    if (CibylCallTable.byteMemory)
+      {
+        CRunTime.memoryWriteWord(address, (int)(in >> 32));
+        CRunTime.memoryWriteWord(address + 4, (int)in);
+        return;
+      }
+
     CRunTime.memory[ address >> 2 ] = (int)(in >> 32);
     CRunTime.memory[ (address + 4) >> 2 ] = (int)(in & 0xffffffffl);
   }
@@ -347,6 +785,10 @@ public class CRunTime
 
   public static final long memoryReadLong(int address)
   {
+    if (CibylCallTable.byteMemory)
+      return (((long)CRunTime.memoryReadWord(address)) << 32) |
+        (((long)CRunTime.memoryReadWord(address + 4)) & 0xffffffffl);
+
     long low = ((long)CRunTime.memory[ (address + 4) >> 2 ]) & 0xffffffffl;
     long high  = ((long)CRunTime.memory[ address >> 2 ]) & 0xffffffffl;
     long out = (high << 32) | low;
@@ -356,11 +798,20 @@ public class CRunTime
 
   public static final int memoryReadWord(int address)
   {
+    if (CibylCallTable.byteMemory)
+      return (CRunTime.memoryBytes[address] << 24) |
+        ((CRunTime.memoryBytes[address + 1] & 0xff) << 16) |
+        ((CRunTime.memoryBytes[address + 2] & 0xff) << 8) |
+        (CRunTime.memoryBytes[address + 3] & 0xff);
+
     return CRunTime.memory[address >> 2];
   }
 
   public static final int memoryReadByteUnsigned(int address)
   {
+    if (CibylCallTable.byteMemory)
+      return CRunTime.memoryBytes[address] & 0xff;
+
     int val = CRunTime.memory[address >> 2];
     int b = (3 - (address & 3)) << 3;
 
@@ -370,6 +821,9 @@ public class CRunTime
 
   public static final int memoryReadByte(int address)
   {
+    if (CibylCallTable.byteMemory)
+      return CRunTime.memoryBytes[address];
+
     int val = CRunTime.memory[address >> 2];
     int b = (3 - (address & 3)) << 3;
     int out = (val >>> b) & 0xff;
@@ -383,6 +837,10 @@ public class CRunTime
 
   public static final int memoryReadShortUnsigned(int address)
   {
+    if (CibylCallTable.byteMemory)
+      return ((CRunTime.memoryBytes[address] & 0xff) << 8) |
+        (CRunTime.memoryBytes[address + 1] & 0xff);
+
     int val = CRunTime.memory[address >> 2];
     int b = (2 - (address & 2)) << 3;
 
@@ -402,63 +860,264 @@ public class CRunTime
 
   public static final void memcpy(int addr, byte[] bytes, int off, int size)
   {
-    while (((addr & 0x3) != 0) && (size > 0)) {
-      byte b = bytes[off++];
-      CRunTime.memoryWriteByte(addr, b);
-      addr++;
-      size--;
-      if (size == 0) return;
-    }
+    if (CibylCallTable.byteMemory)
+      {
+        System.arraycopy(bytes, off, CRunTime.memoryBytes, addr, size);
+        return;
+      }
+    if (size <= 0)
+      return;
+
+    int[] memory = CRunTime.memory;
+    int idx = addr >> 2;
 
-    while (size > 3) {
-      int i = 0;
-      for (int j=0; j<4; j++) {
-	i = i << 8;
-	int b = bytes[off++] & 0xff;
-	i |= b;
+    /* Merge an unaligned start into the first word */
+    if ((addr & 3) != 0)
+      {
+        int w = memory[idx];
+
+        for (int b = (3 - (addr & 3)) << 3; b >= 0 && size > 0; b -= 8)
+          {
+            w = (w & ~(0xff << b)) | ((bytes[off++] & 0xff) << b);
+            size--;
+          }
+        memory[idx++] = w;
       }
 
-      CRunTime.memoryWriteWord(addr, i);
-      addr += 4;
-      size -= 4;
-    }
+    while (size > 3)
+      {
+        memory[idx++] = (bytes[off] << 24) | ((bytes[off + 1] & 0xff) << 16) |
+          ((bytes[off + 2] & 0xff) << 8) | (bytes[off + 3] & 0xff);
+        off += 4;
+        size -= 4;
+      }
 
-    while (size > 0) {
-      byte b = bytes[off++];
-      CRunTime.memoryWriteByte(addr, b);
-      addr++;
-      size--;
-    }
+    /* ... and the tail into the last */
+    if (size > 0)
+      {
+        int w = memory[idx];
+
+        for (int b = 24; size > 0; b -= 8)
+          {
+            w = (w & ~(0xff << b)) | ((bytes[off++] & 0xff) << b);
+            size--;
+          }
+        memory[idx] = w;
+      }
   }
 
   public static final void memcpy(byte[] bytes, int off, int addr, int size)
   {
-    while (size > 0) {
-      bytes[off++] = (byte)CRunTime.memoryReadByte(addr);
-      addr++;
-      size--;
-    }
+    if (CibylCallTable.byteMemory)
+      {
+        System.arraycopy(CRunTime.memoryBytes, addr, bytes, off, size);
+        return;
+      }
+    if (size <= 0)
+      return;
+
+    int[] memory = CRunTime.memory;
+    int idx = addr >> 2;
+
+    if ((addr & 3) != 0)
+      {
+        int w = memory[idx++];
+
+        for (int b = (3 - (addr & 3)) << 3; b >= 0 && size > 0; b -= 8)
+          {
+            bytes[off++] = (byte)(w >> b);
+            size--;
+          }
+      }
+
+    while (size > 3)
+      {
+        int w = memory[idx++];
+
+        bytes[off] = (byte)(w >> 24);
+        bytes[off + 1] = (byte)(w >> 16);
+        bytes[off + 2] = (byte)(w >> 8);
+        bytes[off + 3] = (byte)w;
+        off += 4;
+        size -= 4;
+      }
+
+    if (size > 0)
+      {
+        int w = memory[idx];
+
+        for (int b = 24; size > 0; b -= 8)
+          {
+            bytes[off++] = (byte)(w >> b);
+            size--;
+          }
+      }
+  }
+
+  /**
+   * Get the buffer used for copies between Java byte arrays and C
+   * memory. It is reused to avoid garbage, so transferLock must be
+   * held while it's in use.
+   *
+   * @param size the minimum size of the buffer
+   *
+   * @return a buffer of at least size bytes
+   */
+  public static final byte[] getTransferBuffer(int size)
+  {
+    if (CRunTime.transferBuffer.length < size)
+      {
+        int n = 256;
+
+        while (n < size)
+          n <<= 1;
+        CRunTime.transferBuffer = new byte[n];
+      }
+
+    return CRunTime.transferBuffer;
+  }
+
+  /**
+   * Read up to size bytes from a stream into C memory. Reading stops
+   * at a short read, so this blocks no more than InputStream.read.
+   *
+   * @return the number of bytes read, or -1 at the end of the stream
+   */
+  public static final int readInto(InputStream is, int addr, int size) throws IOException
+  {
+    int count = 0;
+
+    /* Nothing to copy */
+    if (CibylCallTable.byteMemory)
+      return is.read(CRunTime.memoryBytes, addr, size);
+
+    synchronized (CRunTime.transferLock)
+      {
+        byte[] buf = CRunTime.getTransferBuffer(size < TRANSFER_CHUNK_SIZE ? size : TRANSFER_CHUNK_SIZE);
+
+        while (count < size)
+          {
+            int n = size - count;
+            int r;
+
+            if (n > buf.length)
+              n = buf.length;
+            r = is.read(buf, 0, n);
+            if (r < 0)
+              return count == 0 ? -1 : count;
+            CRunTime.memcpy(addr + count, buf, 0, r);
+            count += r;
+            if (r < n)
+              break;
+          }
+      }
+
+    return count;
+  }
+
+  /**
+   * Write size bytes from C memory to a stream.
+   */
+  public static final void writeFrom(OutputStream os, int addr, int size) throws IOException
+  {
+    if (CibylCallTable.byteMemory)
+      {
+        os.write(CRunTime.memoryBytes, addr, size);
+        return;
+      }
+
+    synchronized (CRunTime.transferLock)
+      {
+        byte[] buf = CRunTime.getTransferBuffer(size < TRANSFER_CHUNK_SIZE ? size : TRANSFER_CHUNK_SIZE);
 
-    return;
+        while (size > 0)
+          {
+            int n = size;
+
+            if (n > buf.length)
+              n = buf.length;
+            CRunTime.memcpy(buf, 0, addr, n);
+            os.write(buf, 0, n);
+            addr += n;
+            size -= n;
+          }
+      }
   }
 
-  /* The nasty lwl/lwr and swl/swr instructions */
+  /*
+   * The nasty lwl/lwr and swl/swr instructions. Pairs are translated
+   * to an unaligned word access at the lwl/swl address, which is a
+   * single array access if it's aligned and two merged words otherwise.
+   */
   public static final int memoryReadWordLeft(int address)
   {
-    int b0 = CRunTime.memoryReadByteUnsigned(address + 3);
-    int b1 = CRunTime.memoryReadByteUnsigned(address + 2);
-    int b2 = CRunTime.memoryReadByteUnsigned(address + 1);
-    int b3 = CRunTime.memoryReadByteUnsigned(address + 0);
+    int k = address & 3;
+
+    if (CibylCallTable.byteMemory)
+      return CRunTime.memoryReadWord(address);
+    if (k == 0)
+      return CRunTime.memory[address >> 2];
 
-    return (b0 | (b1 << 8) | (b2 << 16) | (b3 << 24));
+    k <<= 3;
+    return (CRunTime.memory[address >> 2] << k) |
+      (CRunTime.memory[(address >> 2) + 1] >>> (32 - k));
   }
 
   public static final void memoryWriteWordLeft(int address, int rtVal)
   {
-    CRunTime.memoryWriteByte(address + 3, (rtVal));
-    CRunTime.memoryWriteByte(address + 2, (rtVal >> 8));
-    CRunTime.memoryWriteByte(address + 1, (rtVal >> 16));
-    CRunTime.memoryWriteByte(address + 0, (rtVal >> 24));
+    int idx = address >> 2;
+    int k = address & 3;
+
+    if (CibylCallTable.byteMemory || k == 0)
+      {
+        CRunTime.memoryWriteWord(address, rtVal);
+        return;
+      }
+
+    k <<= 3;
+    CRunTime.memory[idx] = (CRunTime.memory[idx] & ~(-1 >>> k)) | (rtVal >>> k);
+    CRunTime.memory[idx + 1] = (CRunTime.memory[idx + 1] & (-1 >>> k)) | (rtVal << (32 - k));
+  }
+
+  /* Unpaired instructions merge part of a word with rt */
+  public static final int memoryReadWordLeftPart(int address, int rtVal)
+  {
+    int k = (address & 3) << 3;
+    int w = CRunTime.memoryReadWord(address & ~3);
+
+    if (k == 0)
+      return w;
+    return (w << k) | (rtVal & ((1 << k) - 1));
+  }
+
+  public static final int memoryReadWordRightPart(int address, int rtVal)
+  {
+    int k = (3 - (address & 3)) << 3;
+    int w = CRunTime.memoryReadWord(address & ~3);
+
+    if (k == 0)
+      return w;
+    return (w >>> k) | (rtVal & ~(-1 >>> k));
+  }
+
+  public static final void memoryWriteWordLeftPart(int address, int rtVal)
+  {
+    int k = (address & 3) << 3;
+    int w = CRunTime.memoryReadWord(address & ~3);
+
+    if (k != 0)
+      rtVal = (w & ~(-1 >>> k)) | (rtVal >>> k);
+    CRunTime.memoryWriteWord(address & ~3, rtVal);
+  }
+
+  public static final void memoryWriteWordRightPart(int address, int rtVal)
+  {
+    int k = (3 - (address & 3)) << 3;
+    int w = CRunTime.memoryReadWord(address & ~3);
+
+    if (k != 0)
+      rtVal = (w & (-1 >>> (32 - k))) | (rtVal << k);
+    CRunTime.memoryWriteWord(address & ~3, rtVal);
   }
 
   public static final void memoryWriteWordLeftPc(int pc, int address, int rtVal)
@@ -469,6 +1128,8 @@ public class CRunTime
 
   public static final void kill()
   {
+    if (CibylCallTable.byteMemory)
+      CRunTime.memoryBytes[-1] = 0;
     CRunTime.memory[-1] = 0;
   }
 
@@ -496,6 +1157,34 @@ public class CRunTime
     return (high << 32) | low;
   }
 
+  /* Unsigned 64-bit division, used by the __udivdi3 builtin when
+   * either of the operands has the top bit set */
+  public static final long udivdi3(long a, long b)
+  {
+    long q, r;
+
+    if (b < 0)
+      {
+        /* b >= 2^63, so the quotient is either 0 or 1 */
+        if ((a ^ 0x8000000000000000l) >= (b ^ 0x8000000000000000l))
+          return 1;
+        return 0;
+      }
+
+    /* Divide a / 2 (always positive) and fixup the lost bit */
+    q = ((a >>> 1) / b) << 1;
+    r = a - q * b;
+    if ((r ^ 0x8000000000000000l) >= (b ^ 0x8000000000000000l))
+      q++;
+
+    return q;
+  }
+
+  public static final long umoddi3(long a, long b)
+  {
+    return a - CRunTime.udivdi3(a, b) * b;
+  }
+
   public static final long multu(int rsVal, int rtVal)
   {
     long a = (long)rsVal;
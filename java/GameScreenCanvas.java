@@ -141,7 +141,7 @@ public class GameScreenCanvas extends GameCanvas implements Runnable
       Syscalls.midletHandle = CRunTime.registerObject( this.main );
 
       /* Start the virtual machine */
-      int sp = (CRunTime.memory.length * 4) - 8;
+      int sp = CRunTime.getMemorySize() - 8;
       CibylCallTable.call(start, sp, 0, 0, 0, 0);
 
     } catch (OutOfMemoryError e) {
@@ -53,6 +53,7 @@ public class Main extends MIDlet implements CommandListener
     if (c.getCommandType() == Command.EXIT)
       {
         this.canvas.invokeCallback(this.cb_atExit, 0, 0);
+        CRunTime.runExitHooks();
 	this.destroyApp(true);
 	this.notifyDestroyed();
       }
@@ -54,9 +54,10 @@ public class StandaloneMain
         int start = CibylCallTable.getAddressByName("__start");
 
         CRunTime.init(is);
-        int sp = (CRunTime.memory.length * 4) - 8;
+        int sp = CRunTime.getMemorySize() - 8;
         CRunTime.publishCallback("Cibyl.atexit"); /* Never used! */
         CibylCallTable.call(start, sp, 0, 0, 0, 0);
+        CRunTime.runExitHooks();
     } catch(Exception e)
     {
     	System.out.println(e.getMessage());
@@ -30,16 +30,33 @@ static void __attribute__((constructor)) setup_ansi_support(void)
   __setup_io((void*)&os_stdout, (void*)&os_stderr);
   stdout = NOPH_OutputStream_createFILE(os_stdout);
   stderr = NOPH_OutputStream_createFILE(os_stderr);
-}
 
-#undef putchar
-int putchar(int c) { return __putchar(c); }
+  /* Console output is line buffered, errors go out directly */
+  setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+  setvbuf(stderr, NULL, _IONBF, 0);
+}
 
-/* We need this to handle inlined puts (with __puts) and automatically
- * generated puts from printfs correctly
+/* GCC turns printf("...\n") into puts and printf("\n") into putchar,
+ * so these must go through the stdout buffer as well to keep the order
  */
-#undef puts
-int puts(const char* string) {return __puts(string);}
+int putchar(int c)
+{
+  if (!stdout)
+    return __putchar(c);
+
+  return fputc(c, stdout);
+}
+
+int puts(const char* string)
+{
+  if (!stdout)
+    return __puts(string);
+
+  if (fputs(string, stdout) < 0 || fputc('\n', stdout) == EOF)
+    return EOF;
+
+  return 1;
+}
 
 #undef fputs
 int fputs(const char* ptr, FILE* stream) { return __fputs(ptr, stream); } /* Not generated */
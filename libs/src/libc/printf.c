@@ -115,8 +115,6 @@ int printf(const char *fmt, ...)
     if ( r > 0 )
 	fputs(outbuf, stdout);
 
-    fflush(stdout);
-
     return r;
 }
 
@@ -141,8 +139,6 @@ int vprintf(const char *fmt, va_list ap)
      */
     if ( r > 0 )
 	fputs(outbuf, stdout);
-
-    fflush(stdout);
     return r;
 }
 
@@ -0,0 +1,194 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      pthread.c
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   pthreads on top of Java threads
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <java/lang.h>
+
+struct __pthread
+{
+  NOPH_CibylThread_t thread;
+  void *stack;
+};
+
+/* Mutexes and conditions from the static initializers are created here */
+static NOPH_CibylMutex_t get_mutex(pthread_mutex_t *mutex)
+{
+  if (!mutex->mutex)
+    {
+      __cibyl_libc_lock();
+      if (!mutex->mutex)
+        mutex->mutex = NOPH_CibylMutex_new();
+      __cibyl_libc_unlock();
+    }
+
+  return mutex->mutex;
+}
+
+static NOPH_CibylCondition_t get_cond(pthread_cond_t *cond)
+{
+  if (!cond->cond)
+    {
+      __cibyl_libc_lock();
+      if (!cond->cond)
+        cond->cond = NOPH_CibylCondition_new();
+      __cibyl_libc_unlock();
+    }
+
+  return cond->cond;
+}
+
+int pthread_attr_init(pthread_attr_t *attr)
+{
+  attr->stacksize = NOPH_STACK_SIZE;
+
+  return 0;
+}
+
+int pthread_attr_destroy(pthread_attr_t *attr)
+{
+  return 0;
+}
+
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize)
+{
+  if (stacksize < 256)
+    return EINVAL;
+  attr->stacksize = stacksize;
+
+  return 0;
+}
+
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                   void *(*start_routine)(void *), void *arg)
+{
+  size_t stacksize = attr ? attr->stacksize : NOPH_STACK_SIZE;
+  struct __pthread *out;
+  uint32_t sp;
+
+  if (!NOPH_CibylThread_isSupported())
+    return EAGAIN;
+
+  /* From here on, libc has to take the lock */
+  if (!__cibyl_threads_active)
+    {
+      __cibyl_libc_mutex = NOPH_CibylMutex_new();
+      __cibyl_threads_active = 1;
+    }
+
+  out = (struct __pthread*)malloc(sizeof(struct __pthread));
+  if (!out)
+    return ENOMEM;
+  out->stack = malloc(stacksize);
+  if (!out->stack)
+    {
+      free(out);
+      return ENOMEM;
+    }
+
+  /* Same as for the main thread: 8-byte aligned, 8 bytes below the top */
+  sp = ((uint32_t)out->stack + stacksize - 8) & ~7;
+  out->thread = NOPH_CibylThread_new((int)start_routine, (int)arg, (int)sp);
+  NOPH_CibylThread_start(out->thread);
+  *thread = out;
+
+  return 0;
+}
+
+int pthread_join(pthread_t thread, void **value_ptr)
+{
+  int ret = NOPH_CibylThread_join(thread->thread);
+
+  if (value_ptr)
+    *value_ptr = (void*)ret;
+  NOPH_delete(thread->thread);
+  free(thread->stack);
+  free(thread);
+
+  return 0;
+}
+
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
+{
+  mutex->mutex = NOPH_CibylMutex_new();
+
+  return 0;
+}
+
+int pthread_mutex_destroy(pthread_mutex_t *mutex)
+{
+  if (mutex->mutex)
+    NOPH_delete(mutex->mutex);
+  mutex->mutex = 0;
+
+  return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+  NOPH_CibylMutex_lock(get_mutex(mutex));
+
+  return 0;
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *mutex)
+{
+  if (!NOPH_CibylMutex_tryLock(get_mutex(mutex)))
+    return EBUSY;
+
+  return 0;
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+  NOPH_CibylMutex_unlock(get_mutex(mutex));
+
+  return 0;
+}
+
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr)
+{
+  cond->cond = NOPH_CibylCondition_new();
+
+  return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *cond)
+{
+  if (cond->cond)
+    NOPH_delete(cond->cond);
+  cond->cond = 0;
+
+  return 0;
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  NOPH_CibylCondition_await(get_cond(cond), get_mutex(mutex));
+
+  return 0;
+}
+
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+  NOPH_CibylCondition_signal(get_cond(cond));
+
+  return 0;
+}
+
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+  NOPH_CibylCondition_broadcast(get_cond(cond));
+
+  return 0;
+}
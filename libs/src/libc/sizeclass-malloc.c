@@ -0,0 +1,413 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      sizeclass-malloc.c
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Segregated size-class malloc
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <cibyl-malloc.h>
+
+/*
+ * All blocks start with an 8-byte header holding the size of the
+ * previous block (0 for the first one) and the size of this block,
+ * including the header, with flags in the low bits.
+ *
+ * Blocks up to SMALL_MAX bytes are never coalesced. They are carved
+ * from the large bins in slabs and kept in exact-size free lists
+ * indexed by size / 8, so small malloc and free are O(1).
+ *
+ * Larger blocks are kept in doubly linked bins by power of two size
+ * and coalesced with their neighbours on free.
+ */
+#define ALIGNMENT   8
+#define HEADER_SIZE (sizeof(block_t) - 2 * sizeof(block_t*))
+#define MIN_BLOCK   (sizeof(block_t))
+
+#define SMALL_MAX   256
+#define N_CLASSES   (SMALL_MAX / ALIGNMENT + 1)
+#define SLAB_SIZE   2048
+#define N_BINS      32
+
+#define F_INUSE     1
+#define F_SMALL     2
+#define F_MASK      (ALIGNMENT - 1)
+
+#define BLOCK_SIZE(b)  ((b)->size & ~F_MASK)
+#define NEXT_BLOCK(b)  ((block_t*)((uint8_t*)(b) + BLOCK_SIZE(b)))
+#define PREV_BLOCK(b)  ((block_t*)((uint8_t*)(b) - (b)->prev_size))
+#define PAYLOAD(b)     ((void*)((uint8_t*)(b) + HEADER_SIZE))
+#define TO_BLOCK(p)    ((block_t*)((uint8_t*)(p) - HEADER_SIZE))
+
+typedef struct s_block
+{
+  size_t prev_size;
+  size_t size;
+
+  /* Only valid for free blocks */
+  struct s_block *next;
+  struct s_block *prev;
+} block_t;
+
+static block_t *small_classes[N_CLASSES];
+static block_t *bins[N_BINS];
+static uint32_t bin_map;
+static block_t *pool_end;
+
+static cibyl_malloc_stats_t stats;
+
+static inline size_t class_of(size_t size)
+{
+  size_t out = size / ALIGNMENT;
+
+  /* Slab leftovers can make the last block slightly larger */
+  if (out >= N_CLASSES)
+    return N_CLASSES - 1;
+  return out;
+}
+
+static inline int bin_of(size_t size)
+{
+  int out = 0;
+
+  while (size >>= 1)
+    out++;
+
+  return out;
+}
+
+static inline void set_size(block_t *b, size_t size, int flags)
+{
+  b->size = size | flags;
+  NEXT_BLOCK(b)->prev_size = size;
+}
+
+static void bin_insert(block_t *b)
+{
+  int bin = bin_of(BLOCK_SIZE(b));
+
+  b->prev = NULL;
+  b->next = bins[bin];
+  if (b->next)
+    b->next->prev = b;
+  bins[bin] = b;
+  bin_map |= (1U << bin);
+  stats.bytes_free_large += BLOCK_SIZE(b);
+}
+
+static void bin_remove(block_t *b)
+{
+  int bin = bin_of(BLOCK_SIZE(b));
+
+  if (b->prev)
+    b->prev->next = b->next;
+  else
+    bins[bin] = b->next;
+  if (b->next)
+    b->next->prev = b->prev;
+  if (!bins[bin])
+    bin_map &= ~(1U << bin);
+  stats.bytes_free_large -= BLOCK_SIZE(b);
+}
+
+/* Take a free block of at least size bytes from the bins */
+static block_t *bin_take(size_t size)
+{
+  int bin = bin_of(size);
+  block_t *b;
+
+  /* First-fit in the bin of the size, which might be too small... */
+  for (b = bins[bin]; b; b = b->next)
+    {
+      if (BLOCK_SIZE(b) >= size)
+        {
+          bin_remove(b);
+          return b;
+        }
+    }
+
+  /* ... but everything in the bins above will fit */
+  for (bin = bin + 1; bin < N_BINS; bin++)
+    {
+      if (bin_map & (1U << bin))
+        {
+          b = bins[bin];
+          bin_remove(b);
+          return b;
+        }
+    }
+
+  return NULL;
+}
+
+static block_t *large_alloc(size_t size, int flags)
+{
+  block_t *b = bin_take(size);
+  size_t left;
+
+  if (!b)
+    return NULL;
+
+  /* Split off the rest if it's large enough to hold a free block */
+  left = BLOCK_SIZE(b) - size;
+  if (left >= MIN_BLOCK)
+    {
+      block_t *rest;
+
+      set_size(b, size, flags);
+      rest = NEXT_BLOCK(b);
+      set_size(rest, left, 0);
+      bin_insert(rest);
+    }
+  else
+    b->size = BLOCK_SIZE(b) | flags;
+
+  return b;
+}
+
+static void large_free(block_t *b)
+{
+  size_t size = BLOCK_SIZE(b);
+  block_t *next = NEXT_BLOCK(b);
+
+  /* Coalesce with the neighbours */
+  if (!(next->size & F_INUSE))
+    {
+      bin_remove(next);
+      size += BLOCK_SIZE(next);
+    }
+  if (b->prev_size != 0 && !(PREV_BLOCK(b)->size & F_INUSE))
+    {
+      block_t *prev = PREV_BLOCK(b);
+
+      bin_remove(prev);
+      size += BLOCK_SIZE(prev);
+      b = prev;
+    }
+  set_size(b, size, 0);
+  bin_insert(b);
+}
+
+/* Carve a slab of blocks for a small size class, returns the first one */
+static block_t *small_refill(size_t size)
+{
+  size_t n = SLAB_SIZE / size;
+  block_t *slab;
+  block_t *b;
+  size_t slab_size;
+
+  slab = large_alloc(n * size, F_INUSE | F_SMALL);
+  if (!slab)
+    {
+      /* Low on memory, try a single block */
+      n = 1;
+      slab = large_alloc(size, F_INUSE | F_SMALL);
+      if (!slab)
+        return NULL;
+    }
+  slab_size = BLOCK_SIZE(slab);
+  stats.n_small_refills++;
+
+  /* The last block gets what was too small to split off */
+  b = slab;
+  while (--n > 0)
+    {
+      block_t *next;
+
+      set_size(b, size, F_INUSE | F_SMALL);
+      slab_size -= size;
+      next = NEXT_BLOCK(b);
+
+      /* Keep the first, cache the rest */
+      if (b != slab)
+        {
+          block_t **head = &small_classes[class_of(size)];
+
+          b->next = *head;
+          *head = b;
+          stats.bytes_cached_small += size;
+        }
+      b = next;
+    }
+  set_size(b, slab_size, F_INUSE | F_SMALL);
+  if (b != slab)
+    {
+      block_t **head = &small_classes[class_of(slab_size)];
+
+      b->next = *head;
+      *head = b;
+      stats.bytes_cached_small += slab_size;
+    }
+
+  return slab;
+}
+
+static inline size_t request_size(size_t size)
+{
+  size = (size + HEADER_SIZE + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  if (size < MIN_BLOCK)
+    return MIN_BLOCK;
+
+  return size;
+}
+
+/*---------------------------------------------------------------------------*/
+/*----------------------------- USER INTERFACE: -----------------------------*/
+/*---------------------------------------------------------------------------*/
+
+static void *do_malloc(size_t user_size)
+{
+  size_t size;
+  block_t *b;
+
+  /* Overflow */
+  if (user_size > (size_t)~0 - SLAB_SIZE)
+    return NULL;
+
+  size = request_size(user_size);
+  if (size <= SMALL_MAX)
+    {
+      block_t **head = &small_classes[class_of(size)];
+
+      b = *head;
+      if (b)
+        {
+          *head = b->next;
+          stats.bytes_cached_small -= BLOCK_SIZE(b);
+        }
+      else if ( !(b = small_refill(size)) )
+        return NULL;
+    }
+  else
+    {
+      b = large_alloc(size, F_INUSE);
+      if (!b)
+        return NULL;
+    }
+
+  stats.n_mallocs++;
+  stats.bytes_in_use += BLOCK_SIZE(b);
+  if (stats.bytes_in_use > stats.peak_bytes_in_use)
+    stats.peak_bytes_in_use = stats.bytes_in_use;
+
+  return PAYLOAD(b);
+}
+
+static void do_free(void *ptr)
+{
+  block_t *b;
+
+  if (!ptr)
+    return;
+
+  b = TO_BLOCK(ptr);
+  stats.n_frees++;
+  stats.bytes_in_use -= BLOCK_SIZE(b);
+
+  if (b->size & F_SMALL)
+    {
+      block_t **head = &small_classes[class_of(BLOCK_SIZE(b))];
+
+      b->next = *head;
+      *head = b;
+      stats.bytes_cached_small += BLOCK_SIZE(b);
+      return;
+    }
+
+  large_free(b);
+}
+
+void *malloc(size_t size)
+{
+  void *out;
+
+  __cibyl_libc_lock();
+  out = do_malloc(size);
+  __cibyl_libc_unlock();
+
+  return out;
+}
+
+void free(void *ptr)
+{
+  __cibyl_libc_lock();
+  do_free(ptr);
+  __cibyl_libc_unlock();
+}
+
+void *realloc(void *ptr, size_t size)
+{
+  size_t old_size;
+  void *out;
+
+  if (!ptr)
+    return malloc(size);
+  if (size == 0)
+    {
+      free(ptr);
+      return NULL;
+    }
+
+  /* Still fits */
+  old_size = BLOCK_SIZE(TO_BLOCK(ptr)) - HEADER_SIZE;
+  if (size <= old_size)
+    return ptr;
+
+  out = malloc(size);
+  if (!out)
+    return NULL;
+
+  memcpy(out, ptr, old_size);
+  free(ptr);
+
+  return out;
+}
+
+void cibyl_malloc_get_stats(cibyl_malloc_stats_t *out)
+{
+  int i;
+
+  __cibyl_libc_lock();
+  *out = stats;
+  out->largest_free_block = 0;
+  for (i = 0; i < N_BINS; i++)
+    {
+      block_t *b;
+
+      for (b = bins[i]; b; b = b->next)
+        {
+          if (BLOCK_SIZE(b) - HEADER_SIZE > out->largest_free_block)
+            out->largest_free_block = BLOCK_SIZE(b) - HEADER_SIZE;
+        }
+    }
+  __cibyl_libc_unlock();
+}
+
+void smalloc_set_memory_pool(void *memory_start, void *memory_end)
+{
+  uint32_t start = ((uint32_t)memory_start + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  uint32_t end = ((uint32_t)memory_end - HEADER_SIZE) & ~(ALIGNMENT - 1);
+  block_t *b = (block_t*)start;
+
+  memset(small_classes, 0, sizeof(small_classes));
+  memset(bins, 0, sizeof(bins));
+  memset(&stats, 0, sizeof(stats));
+  bin_map = 0;
+
+  /* The end sentinel is always "in use" and stops coalescing */
+  pool_end = (block_t*)end;
+  pool_end->size = 0 | F_INUSE;
+
+  b->prev_size = 0;
+  set_size(b, end - start, 0);
+  bin_insert(b);
+
+  stats.pool_size = end - start;
+}
@@ -33,6 +33,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #define INT_MAX         ((int)(~0U>>1))
 #define MAXINT INT_MAX
@@ -330,18 +331,29 @@ static void _free(void * ptr)
 /*----------------------------- USER INTERFACE: -----------------------------*/
 /*---------------------------------------------------------------------------*/
 
-void* malloc(size_t size)
+/* Weak so that libsizeclass-malloc can replace it at link time */
+#define WEAK __attribute__((weak))
+
+WEAK void* malloc(size_t size)
 {
-    return _malloc(size);
+    void *out;
+
+    __cibyl_libc_lock();
+    out = _malloc(size);
+    __cibyl_libc_unlock();
+
+    return out;
 } /* malloc */
 
 
-void free(void *ptr)
+WEAK void free(void *ptr)
 {
+    __cibyl_libc_lock();
     _free(ptr);
+    __cibyl_libc_unlock();
 } /* free */
 
-void *realloc(void *ptr, size_t size)
+WEAK void *realloc(void *ptr, size_t size)
 {
   void *out = (void*)malloc(size);
 
@@ -355,7 +367,7 @@ void *realloc(void *ptr, size_t size)
   return out;
 }
 
-void smalloc_set_memory_pool(void *memory_start, void *memory_end)
+WEAK void smalloc_set_memory_pool(void *memory_start, void *memory_end)
 {
   node *n = (node *)memory_start;
   size_t size = ADDR(memory_end) - ADDR(memory_start);
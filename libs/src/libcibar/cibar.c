@@ -16,6 +16,13 @@
 #include <cibar.h>
 #include <cibyl-memoryfs.h>
 
+#include <cibyl-fileops.h>
+
+#define CIBAR_V1_MAGIC 0x12344321
+#define CIBAR_V2_MAGIC 0x43424132 /* "CBA2" */
+
+#define NO_ENTRY       0xffffffff
+
 typedef struct
 {
   uint32_t strtab_offset;
@@ -23,45 +30,165 @@ typedef struct
   uint32_t data_size;
 } cibar_internal_file_entry_t;
 
+/* After the magic */
 typedef struct
 {
-  uint32_t magic;
   uint32_t total_length;
   uint32_t strtab_length;
   uint32_t data_length;
   uint32_t n_file_entries;
   uint32_t data_start;
-
-  cibar_file_entry_t entries[];
 } cibar_internal_t;
 
+/*
+ * Version 2 layout:
+ *
+ *   header, buckets[hash_size], entries[n_file_entries], strtab, data
+ *
+ * The buckets hold the index of the first entry with that hash, and
+ * the entries are chained through next.
+ */
+typedef struct
+{
+  uint32_t hash;
+  uint32_t strtab_offset;
+  uint32_t data_offset;
+  uint32_t data_size;
+  uint32_t next;
+} cibar_v2_file_entry_t;
+
+typedef struct
+{
+  uint32_t n_file_entries;
+  uint32_t hash_size;    /* Power of two */
+  uint32_t strtab_length;
+  uint32_t data_start;   /* From the start of the archive */
+} cibar_v2_t;
+
+/* FNV-1a, the same as in tools/cibyl-generate-cibar */
+static uint32_t cibar_hash(const char *name)
+{
+  uint32_t out = 2166136261U;
+
+  while (*name)
+    {
+      out ^= (uint8_t)*name++;
+      out *= 16777619U;
+    }
+
+  return out;
+}
+
 void cibar_close(cibar_t *p)
 {
+  free(p->buckets);
   free(p->strings);
   free(p->data);
   free(p);
 }
 
+/* --- Files in v2 archives, read from the archive when needed --- */
+typedef struct
+{
+  cibar_file_entry_t *entry;
+} cibar_v2_file_t;
+
+static size_t v2_read(FILE *fp, void *ptr, size_t in_size)
+{
+  cibar_v2_file_t *p = (cibar_v2_file_t*)fp->priv;
+  cibar_t *cibar = p->entry->cibar;
+  size_t size;
+
+  if (fp->fptr >= fp->file_size)
+    {
+      fp->eof = 1;
+      return 0;
+    }
+  size = fp->file_size - fp->fptr;
+  if (in_size < size)
+    size = in_size;
+
+  if (fseek(cibar->fp, cibar->data_start + p->entry->offset + fp->fptr,
+            SEEK_SET) != 0)
+    return 0;
+
+  return fread(ptr, 1, size, cibar->fp);
+}
+
+static size_t v2_write(FILE *fp, const void *ptr, size_t in_size)
+{
+  /* Read-only */
+  return 0;
+}
+
+static void v2_seek(FILE *fp, long offset)
+{
+  /* Nothing, reads use fp->fptr */
+}
+
+static int v2_close(FILE *fp)
+{
+  return 0;
+}
+
+static cibyl_fops_t cibar_v2_fops =
+{
+  .priv_data_size = sizeof(cibar_v2_file_t),
+  .open = NULL,
+  .close = v2_close,
+  .read = v2_read,
+  .write = v2_write,
+  .seek = v2_seek,
+};
+
+static cibar_file_entry_t *v2_lookup(cibar_t *p, const char *name)
+{
+  uint32_t hash = cibar_hash(name);
+  uint32_t i;
+
+  for (i = p->buckets[hash & (p->hash_size - 1)];
+       i != NO_ENTRY;
+       i = p->files[i].next)
+    {
+      cibar_file_entry_t *cur = &p->files[i];
+
+      if (cur->hash == hash && strcmp(cur->name, name) == 0)
+        return cur;
+    }
+
+  return NULL;
+}
+
 FILE *cibar_file_open(cibar_t *p, const char *name)
 {
+  cibar_file_entry_t *entry;
+  cibar_v2_file_t *priv;
+  FILE *out;
   int i;
 
-  for (i = 0; i < p->n_files; i++)
+  if (p->version == 1)
     {
-      if (strlen(p->files[i].name) == strlen(name) &&
-          strcmp(p->files[i].name, name) == 0)
+      for (i = 0; i < p->n_files; i++)
         {
-          FILE *out = NOPH_MemoryFile_open(p->files[i].data,
-                                           p->files[i].data_size, 0);
-
-          return out;
+          if (strcmp(p->files[i].name, name) == 0)
+            return NOPH_MemoryFile_open(p->files[i].data,
+                                        p->files[i].data_size, 0);
         }
+      return NULL;
     }
 
-  return NULL;
+  if ( !(entry = v2_lookup(p, name)) )
+    return NULL;
+  if ( !(out = cibyl_file_alloc(&cibar_v2_fops)) )
+    return NULL;
+  priv = (cibar_v2_file_t*)out->priv;
+  priv->entry = entry;
+  out->file_size = entry->data_size;
+
+  return out;
 }
 
-cibar_t *cibar_open(FILE *f)
+static cibar_t *cibar_open_v1(FILE *f)
 {
   cibar_internal_file_entry_t *entries;
   char *strings;
@@ -70,17 +197,9 @@ cibar_t *cibar_open(FILE *f)
   cibar_t *out;
   int i;
 
-  if (!f)
-    return NULL;
-
   /* Read the header */
-  fread(&cb, sizeof(cibar_internal_t), 1, f);
-
-  if (cb.magic != 0x12344321)
-    {
-      printf("cibar: Wrong magic: 0x%08x\n", cb.magic);
-      goto error_1;
-    }
+  if (fread(&cb, sizeof(cibar_internal_t), 1, f) != 1)
+    goto error_1;
 
   /* Allocate structures */
   if ( !(entries = (cibar_internal_file_entry_t*)malloc(sizeof(cibar_internal_file_entry_t) * cb.n_file_entries)) )
@@ -91,17 +210,20 @@ cibar_t *cibar_open(FILE *f)
     goto error_3;
   if ( !(out = (cibar_t*)malloc( sizeof(cibar_t) + sizeof(cibar_file_entry_t) * cb.n_file_entries)) )
     goto error_4;
+  memset(out, 0, sizeof(cibar_t));
 
   /* Read the rest of the file */
   if (fread(entries, 1, sizeof(cibar_internal_file_entry_t) * cb.n_file_entries, f) !=
       sizeof(cibar_internal_file_entry_t) * cb.n_file_entries)
-    goto error_4;
+    goto error_5;
   if (fread(strings, 1, cb.strtab_length, f) != cb.strtab_length)
-    goto error_4;
+    goto error_5;
   if (fread(data, 1, cb.data_length, f) != cb.data_length)
-    goto error_4;
+    goto error_5;
 
   /* Fill in the out stucture */
+  out->version = 1;
+  out->fp = f;
   out->n_files = cb.n_file_entries;
   out->strings = strings;
   out->data = data;
@@ -118,6 +240,8 @@ cibar_t *cibar_open(FILE *f)
   free(entries);
 
   return out;
+ error_5:
+  free(out);
  error_4:
   free(data);
  error_3:
@@ -128,6 +252,93 @@ cibar_t *cibar_open(FILE *f)
   return NULL;
 }
 
+static cibar_t *cibar_open_v2(FILE *f)
+{
+  cibar_v2_file_entry_t *entries;
+  uint32_t *buckets;
+  char *strings;
+  cibar_v2_t cb;
+  cibar_t *out;
+  int i;
+
+  /* Only the header and the index is read */
+  if (fread(&cb, sizeof(cibar_v2_t), 1, f) != 1)
+    goto error_1;
+
+  if ( !(buckets = (uint32_t*)malloc(sizeof(uint32_t) * cb.hash_size)) )
+    goto error_1;
+  if ( !(entries = (cibar_v2_file_entry_t*)malloc(sizeof(cibar_v2_file_entry_t) * cb.n_file_entries)) )
+    goto error_2;
+  if ( !(strings = (char*)malloc( cb.strtab_length )) )
+    goto error_3;
+  if ( !(out = (cibar_t*)malloc( sizeof(cibar_t) + sizeof(cibar_file_entry_t) * cb.n_file_entries)) )
+    goto error_4;
+  memset(out, 0, sizeof(cibar_t));
+
+  if (fread(buckets, sizeof(uint32_t), cb.hash_size, f) != cb.hash_size)
+    goto error_5;
+  if (fread(entries, sizeof(cibar_v2_file_entry_t), cb.n_file_entries, f) !=
+      cb.n_file_entries)
+    goto error_5;
+  if (fread(strings, 1, cb.strtab_length, f) != cb.strtab_length)
+    goto error_5;
+
+  out->version = 2;
+  out->fp = f;
+  out->n_files = cb.n_file_entries;
+  out->strings = strings;
+  out->data = NULL;
+  out->data_start = cb.data_start;
+  out->hash_size = cb.hash_size;
+  out->buckets = buckets;
+  for (i = 0; i < cb.n_file_entries; i++)
+    {
+      cibar_file_entry_t *p = &out->files[i];
+
+      p->cibar = out;
+      p->data = NULL;
+      p->data_size = entries[i].data_size;
+      p->name = strings + entries[i].strtab_offset;
+      p->offset = entries[i].data_offset;
+      p->hash = entries[i].hash;
+      p->next = entries[i].next;
+    }
+
+  free(entries);
+
+  return out;
+ error_5:
+  free(out);
+ error_4:
+  free(strings);
+ error_3:
+  free(entries);
+ error_2:
+  free(buckets);
+ error_1:
+  return NULL;
+}
+
+cibar_t *cibar_open(FILE *f)
+{
+  uint32_t magic;
+
+  if (!f)
+    return NULL;
+
+  if (fread(&magic, sizeof(uint32_t), 1, f) != 1)
+    return NULL;
+
+  if (magic == CIBAR_V1_MAGIC)
+    return cibar_open_v1(f);
+  else if (magic == CIBAR_V2_MAGIC)
+    return cibar_open_v2(f);
+
+  printf("cibar: Wrong magic: 0x%08x\n", magic);
+
+  return NULL;
+}
+
 /* --- DIRop interface to cibars --- */
 typedef struct
 {
@@ -155,8 +366,10 @@ static DIR *open_dir(const char *dirname)
 static int close_dir(DIR *dir)
 {
   cibar_dir_t *p = (cibar_dir_t*)dir->priv;
+  FILE *fp = p->cibar->fp;
 
   cibar_close(p->cibar);
+  fclose(fp);
 
   return 0;
 }
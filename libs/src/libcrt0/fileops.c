@@ -10,11 +10,20 @@
  *
  ********************************************************************/
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include <cibyl-fileops.h>
 
 #include <java/lang.h>
 
+#define min(x,y) ( (x) < (y) ? (x) : (y) )
+
+/* FILE buf_flags */
+#define BUF_OWNED   1
+#define BUF_READING 2
+#define BUF_WRITING 4
+
 typedef struct
 {
   cibyl_fops_t **table;
@@ -79,6 +88,9 @@ void cibyl_dops_register(const char *uri, cibyl_dops_t *dop, int is_default)
 }
 
 
+/* All open files, for fflush(NULL) */
+static FILE *open_files;
+
 FILE *cibyl_file_alloc(cibyl_fops_t *fop)
 {
   FILE *out;
@@ -91,12 +103,32 @@ FILE *cibyl_file_alloc(cibyl_fops_t *fop)
 
   out->ops = fop;
   out->priv = (void*)(out + 1);
+  out->buf_mode = _IOFBF;
+
+  __cibyl_libc_lock();
+  out->next = open_files;
+  open_files = out;
+  __cibyl_libc_unlock();
 
   return out;
 }
 
 void cibyl_file_free(FILE *fp)
 {
+  FILE **pp;
+
+  __cibyl_libc_lock();
+  for (pp = &open_files; *pp; pp = &(*pp)->next)
+    {
+      if (*pp == fp)
+        {
+          *pp = fp->next;
+          break;
+        }
+    }
+  __cibyl_libc_unlock();
+  if (fp->buf_flags & BUF_OWNED)
+    free(fp->buf);
   free(fp);
 }
 
@@ -231,57 +263,301 @@ FILE *fopen(const char *path, const char *in_mode)
 }
 
 
-int fclose(FILE *fp)
+/*
+ * Buffering: buf holds either data read ahead from the backend
+ * (BUF_READING, buf_pos..buf_len not yet consumed, fptr is the backend
+ * position after the buffer) or data not yet written (BUF_WRITING,
+ * buf_len pending bytes which go to fptr). vfptr is always the
+ * position seen by the user.
+ *
+ * The buffers are shared between threads (stdout in particular), so
+ * the functions using them take the libc lock.
+ */
+static int get_buffer(FILE *fp)
 {
-  int out = fp->ops->close(fp);
+  if (fp->buf_mode == _IONBF)
+    return 0;
+  if (fp->buf)
+    return 1;
 
-  cibyl_file_free(fp);
-  return out;
-}
+  if ( !(fp->buf = (unsigned char*)malloc(BUFSIZ)) )
+    {
+      fp->buf_mode = _IONBF;
+      return 0;
+    }
+  fp->buf_size = BUFSIZ;
+  fp->buf_flags |= BUF_OWNED;
 
+  return 1;
+}
 
-size_t fread(void *ptr, size_t in_size, size_t nmemb, FILE *fp)
+static int flush_write_buffer(FILE *fp)
 {
-  size_t size = in_size * nmemb;
+  size_t len = fp->buf_len;
   size_t ret;
 
-  if (size == 0)
+  if ( !(fp->buf_flags & BUF_WRITING) )
     return 0;
 
-  /* Do we need to seek? */
-  if (fp->fptr != fp->vfptr)
+  fp->buf_flags &= ~BUF_WRITING;
+  fp->buf_len = fp->buf_pos = 0;
+  if (len == 0)
+    return 0;
+
+  ret = fp->ops->write(fp, fp->buf, len);
+  fp->fptr += ret;
+  if (ret != len)
+    {
+      fp->error = 1;
+      return EOF;
+    }
+
+  return 0;
+}
+
+static void drop_read_buffer(FILE *fp)
+{
+  fp->buf_flags &= ~BUF_READING;
+  fp->buf_len = fp->buf_pos = 0;
+}
+
+/* Move the backend to the user file pointer */
+static void sync_file_pointer(FILE *fp)
+{
+  if (fp->fptr != fp->vfptr && fp->ops->seek)
     {
       fp->ops->seek(fp, fp->vfptr - fp->fptr);
       fp->fptr = fp->vfptr;
     }
+}
+
+static int do_setvbuf(FILE *fp, char *buf, int mode, size_t size)
+{
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+  if (flush_write_buffer(fp) != 0)
+    return EOF;
+  drop_read_buffer(fp);
+
+  if (fp->buf_flags & BUF_OWNED)
+    free(fp->buf);
+  fp->buf_flags &= ~BUF_OWNED;
+  fp->buf = NULL;
+  fp->buf_size = 0;
+  fp->buf_mode = mode;
+
+  if (mode == _IONBF)
+    return 0;
+
+  if (!buf && size > 0)
+    {
+      if ( !(buf = (char*)malloc(size)) )
+        return EOF;
+      fp->buf_flags |= BUF_OWNED;
+    }
+  fp->buf = (unsigned char*)buf;
+  fp->buf_size = size;
+  if (!buf)
+    return get_buffer(fp) ? 0 : EOF;
+
+  return 0;
+}
+
+int setvbuf(FILE *fp, char *buf, int mode, size_t size)
+{
+  int out;
+
+  __cibyl_libc_lock();
+  out = do_setvbuf(fp, buf, mode, size);
+  __cibyl_libc_unlock();
+
+  return out;
+}
+
+int fclose(FILE *fp)
+{
+  int out;
+
+  __cibyl_libc_lock();
+  flush_write_buffer(fp);
+  out = fp->ops->close(fp);
+
+  cibyl_file_free(fp);
+  __cibyl_libc_unlock();
+
+  return out;
+}
+
+/* Read directly from the backend */
+static size_t read_unbuffered(FILE *fp, void *ptr, size_t size)
+{
+  size_t ret;
+
+  sync_file_pointer(fp);
 
   /* Read and update the file pointers */
   ret = fp->ops->read(fp, ptr, size);
   fp->fptr += ret;
   fp->vfptr = fp->fptr;
 
-  return ret / in_size;
+  return ret;
 }
 
-size_t fwrite(const void *ptr, size_t in_size, size_t nmemb, FILE *fp)
+static size_t do_fread(void *ptr, size_t in_size, size_t nmemb, FILE *fp)
 {
   size_t size = in_size * nmemb;
-  size_t ret;
+  size_t n = 0;
 
   if (size == 0)
     return 0;
 
-  ret = fp->ops->write(fp, ptr, size) / in_size;
+  flush_write_buffer(fp);
+
+  /* Served from the buffer */
+  if (fp->buf_flags & BUF_READING)
+    {
+      n = min(size, fp->buf_len - fp->buf_pos);
+      memcpy(ptr, fp->buf + fp->buf_pos, n);
+      fp->buf_pos += n;
+      fp->vfptr += n;
+      if (n == size)
+        return nmemb;
+      drop_read_buffer(fp);
+    }
+
+  /* Large reads go directly to the backend */
+  if (size - n >= fp->buf_size || !get_buffer(fp))
+    return (n + read_unbuffered(fp, (char*)ptr + n, size - n)) / in_size;
+
+  while (n < size)
+    {
+      size_t ret;
+      size_t cur;
+
+      ret = read_unbuffered(fp, fp->buf, fp->buf_size);
+      fp->vfptr -= ret; /* Not yet consumed */
+      if (ret == 0)
+        break;
+
+      /* The backend might set eof with data left in the buffer */
+      fp->eof = 0;
+      cur = min(ret, size - n);
+      memcpy((char*)ptr + n, fp->buf, cur);
+      n += cur;
+      fp->vfptr += cur;
+
+      fp->buf_flags |= BUF_READING;
+      fp->buf_len = ret;
+      fp->buf_pos = cur;
+    }
+  if (n < size)
+    fp->eof = 1;
+
+  return n / in_size;
+}
 
+size_t fread(void *ptr, size_t in_size, size_t nmemb, FILE *fp)
+{
+  size_t out;
+
+  __cibyl_libc_lock();
+  out = do_fread(ptr, in_size, nmemb, fp);
+  __cibyl_libc_unlock();
+
+  return out;
+}
+
+/* Write directly to the backend */
+static size_t write_unbuffered(FILE *fp, const void *ptr, size_t size)
+{
+  size_t ret;
+
+  sync_file_pointer(fp);
+
+  ret = fp->ops->write(fp, ptr, size);
   fp->fptr += ret;
   fp->vfptr = fp->fptr;
+
   return ret;
 }
 
+static size_t do_fwrite(const void *ptr, size_t in_size, size_t nmemb, FILE *fp)
+{
+  size_t size = in_size * nmemb;
+  int flush = 0;
+
+  if (size == 0)
+    return 0;
+
+  if (fp->buf_flags & BUF_READING)
+    drop_read_buffer(fp);
+
+  if (!get_buffer(fp))
+    return write_unbuffered(fp, ptr, size) / in_size;
+
+  /* Does not fit in what's left, flush first */
+  if (size > fp->buf_size - fp->buf_len)
+    {
+      if (flush_write_buffer(fp) != 0)
+        return 0;
+      if (size >= fp->buf_size)
+        return write_unbuffered(fp, ptr, size) / in_size;
+    }
+
+  if ( !(fp->buf_flags & BUF_WRITING) )
+    {
+      /* Pending data is written at the user position */
+      sync_file_pointer(fp);
+      fp->buf_flags |= BUF_WRITING;
+    }
+  memcpy(fp->buf + fp->buf_len, ptr, size);
+  fp->buf_len += size;
+  fp->vfptr += size;
+
+  if (fp->buf_mode == _IOLBF)
+    {
+      const char *p;
+
+      for (p = (const char*)ptr; p < (const char*)ptr + size; p++)
+        {
+          if (*p == '\n')
+            {
+              flush = 1;
+              break;
+            }
+        }
+    }
+  if (flush || fp->buf_len == fp->buf_size)
+    {
+      if (flush_write_buffer(fp) != 0)
+        return 0;
+    }
+
+  return nmemb;
+}
+
+size_t fwrite(const void *ptr, size_t in_size, size_t nmemb, FILE *fp)
+{
+  size_t out;
+
+  __cibyl_libc_lock();
+  out = do_fwrite(ptr, in_size, nmemb, fp);
+  __cibyl_libc_unlock();
+
+  return out;
+}
+
 int fseek(FILE *fp, long offset, int whence)
 {
   long skip = offset;
 
+  __cibyl_libc_lock();
+  if (flush_write_buffer(fp) != 0)
+    {
+      __cibyl_libc_unlock();
+      return -1;
+    }
+
   switch (whence)
     {
     case SEEK_SET:
@@ -295,10 +571,24 @@ int fseek(FILE *fp, long offset, int whence)
       /* Do nothing */
       break;
     default:
+      __cibyl_libc_unlock();
       NOPH_throw(NOPH_Exception_new_string("Invalid seek mode"));
     }
 
   fp->vfptr += skip;
+  fp->eof = 0;
+
+  /* Still within the read buffer? */
+  if (fp->buf_flags & BUF_READING)
+    {
+      long buf_start = fp->fptr - (long)fp->buf_len;
+
+      if (fp->vfptr >= buf_start && fp->vfptr <= fp->fptr)
+        fp->buf_pos = fp->vfptr - buf_start;
+      else
+        drop_read_buffer(fp);
+    }
+  __cibyl_libc_unlock();
 
   return 0;
 }
@@ -331,18 +621,50 @@ int feof(FILE *fp)
 
 int fflush(FILE* fp)
 {
-  if (fp->ops->flush == NULL)
-    return 0;
-  return fp->ops->flush(fp);
+  int out;
+
+  /* Flush all open files */
+  if (fp == NULL)
+    {
+      out = 0;
+      __cibyl_libc_lock();
+      for (fp = open_files; fp; fp = fp->next)
+        {
+          if (fflush(fp) != 0)
+            out = EOF;
+        }
+      __cibyl_libc_unlock();
+      return out;
+    }
+
+  __cibyl_libc_lock();
+  out = flush_write_buffer(fp);
+  if (fp->ops->flush)
+    out |= fp->ops->flush(fp);
+  __cibyl_libc_unlock();
+
+  return out;
 }
 
 int fgetc(FILE* fp)
 {
-  char out;
+  unsigned char out;
 
-  if (fread(&out, 1, 1, fp) < 0)
+  /* Fast path, from the buffer */
+  __cibyl_libc_lock();
+  if ((fp->buf_flags & BUF_READING) && fp->buf_pos < fp->buf_len)
     {
-      /* FIXME: Do some error handling here */
+      fp->vfptr++;
+      out = fp->buf[fp->buf_pos++];
+      __cibyl_libc_unlock();
+      return out;
+    }
+  __cibyl_libc_unlock();
+
+  if (fread(&out, 1, 1, fp) != 1)
+    {
+      fp->eof = 1;
+      return EOF;
     }
 
   return out;
@@ -350,48 +672,49 @@ int fgetc(FILE* fp)
 
 char* fgets(char* s, int size, FILE* fp)
 {
-  char *out = s;
   char *itr = s;
-  int c;
 
-  do
+  if (size <= 0)
+    return NULL;
+
+  /* Leave space for the NULL-termination */
+  while (size > 1)
     {
-      c = fgetc(fp);
-      if (feof(fp)) {
-        if (itr == s) return NULL;
-	else c = '\0';
-      }
-
-      *itr = c;
-      itr++;
-      size--;
-    } while (c != '\0' && c != '\n' && size);
+      int c = fgetc(fp);
 
-    *itr = '\0';
+      if (c == EOF)
+        {
+          if (itr == s)
+            return NULL;
+          break;
+        }
 
-  return out;
+      *itr++ = c;
+      size--;
+      if (c == '\n')
+        break;
+    }
+  *itr = '\0';
+
+  return s;
 }
 
 int fputc(int c, FILE* fp)
 {
-  if (fwrite(&c, 1, 1, fp) < 0)
-    {
-      /* FIXME: Do some error handling here */
-    }
+  unsigned char ch = c;
+
+  if (fwrite(&ch, 1, 1, fp) != 1)
+    return EOF;
 
-  return c;
+  return ch;
 }
 
 int __fputs(const char* ptr, FILE* fp)
 {
-  char *p;
-  int n = 0;
+  size_t n = strlen(ptr);
 
-  for (p = (char*)ptr; *p; p++, n++)
-    {
-      if (fwrite(p, 1, 1, fp) < 0)
-	return EOF;
-    }
+  if (n > 0 && fwrite(ptr, 1, n, fp) != n)
+    return EOF;
 
   return n;
 }
@@ -11,6 +11,7 @@
  ********************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <cibyl.h>
 
 #include <java/lang.h>
@@ -131,6 +132,14 @@ int __NOPH_setjmp(void)
   return 0;
 }
 
+void __NOPH_longjmp(int cookie, int val)
+{
+}
+
+/* Set by the first pthread_create */
+int __cibyl_threads_active;
+NOPH_CibylMutex_t __cibyl_libc_mutex;
+
 /* --- atexit(3) handling */
 static void (**atexit_list)(void);
 static int atexit_n = 0;
@@ -138,11 +147,14 @@ static int atexit_n = 0;
 /* atexit implementation */
 int atexit( void (*fn)(void) )
 {
-  int cur = atexit_n;
+  int cur;
 
+  __cibyl_libc_lock();
+  cur = atexit_n;
   atexit_n++;
   atexit_list = realloc(atexit_list, sizeof(void (*)(void)) * atexit_n);
   atexit_list[cur] = fn;
+  __cibyl_libc_unlock();
   NOPH_panic_if(!atexit_list, "realloc of atexit lists failed");
 
   return 0;
@@ -155,4 +167,7 @@ static void atexit_run(void)
 
   run_list(start, end);
   __do_global_dtors_aux();
+
+  /* Write out what's left in the stdio buffers */
+  fflush(NULL);
 }
@@ -18,3 +18,31 @@ void __ashrdi3(int64_t a, unsigned int b)
 void __ashldi3(int64_t a, unsigned int b)
 {
 }
+
+void __udivdi3(uint64_t a, uint64_t b)
+{
+}
+
+void __umoddi3(uint64_t a, uint64_t b)
+{
+}
+
+void __muldi3(int64_t a, int64_t b)
+{
+}
+
+void __negdi2(int64_t a)
+{
+}
+
+void __cmpdi2(int64_t a, int64_t b)
+{
+}
+
+void __ucmpdi2(uint64_t a, uint64_t b)
+{
+}
+
+void __lshrdi3(uint64_t a, unsigned int b)
+{
+}
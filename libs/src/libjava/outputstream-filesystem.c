@@ -14,13 +14,10 @@ static int close(FILE *fp)
 static size_t write(FILE *fp, const void *ptr, size_t in_size)
 {
   NOPH_OutputStream_file_t *p = (NOPH_OutputStream_file_t *)fp->priv;
-  char *s;
 
-  /* One byte at a time */
-  for ( s = (char *)ptr; s < (char*)ptr + in_size; s++)
-    NOPH_OutputStream_write(p->os, *s);
+  NOPH_OutputStream_write_from(p->os, (const char*)ptr, in_size);
 
-  return s - (char*)ptr;
+  return in_size;
 }
 
 static int flush(FILE* fp)
@@ -0,0 +1,63 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      CibylCondition.java
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Condition variable for pthread_cond_t
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+public class CibylCondition
+{
+    private int waiters;
+    private int signals;
+
+    public CibylCondition()
+    {
+    }
+
+    /**
+     * Release the mutex and wait for a signal, then take the mutex
+     * again. The waiter is counted before the mutex is released, so a
+     * signal in between is not lost.
+     */
+    public void await(CibylMutex mutex)
+    {
+        int count;
+
+        synchronized (this) {
+            this.waiters++;
+        }
+        count = mutex.release();
+
+        synchronized (this) {
+            while (this.signals == 0)
+            {
+                try {
+                    this.wait();
+                } catch (InterruptedException e) {
+                }
+            }
+            this.signals--;
+            this.waiters--;
+        }
+        mutex.acquire(count);
+    }
+
+    public synchronized void signal()
+    {
+        if (this.waiters > this.signals)
+        {
+            this.signals++;
+            this.notify();
+        }
+    }
+
+    public synchronized void broadcast()
+    {
+        this.signals = this.waiters;
+        this.notifyAll();
+    }
+}
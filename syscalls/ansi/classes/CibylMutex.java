@@ -0,0 +1,77 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      CibylMutex.java
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Recursive mutex for pthread_mutex_t
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+public class CibylMutex
+{
+    private Thread owner;
+    private int count;
+
+    public CibylMutex()
+    {
+    }
+
+    public synchronized void lock()
+    {
+        Thread self = Thread.currentThread();
+
+        while (this.owner != null && this.owner != self)
+        {
+            try {
+                this.wait();
+            } catch (InterruptedException e) {
+            }
+        }
+        this.owner = self;
+        this.count++;
+    }
+
+    public synchronized boolean tryLock()
+    {
+        Thread self = Thread.currentThread();
+
+        if (this.owner != null && this.owner != self)
+            return false;
+        this.owner = self;
+        this.count++;
+
+        return true;
+    }
+
+    public synchronized void unlock()
+    {
+        if (this.owner != Thread.currentThread())
+            throw new IllegalMonitorStateException("Unlock of a mutex owned by another thread");
+        this.count--;
+        if (this.count == 0)
+        {
+            this.owner = null;
+            this.notify();
+        }
+    }
+
+    /* Release the mutex completely, for CibylCondition */
+    synchronized int release()
+    {
+        int out = this.count;
+
+        this.count = 1;
+        this.unlock();
+
+        return out;
+    }
+
+    /* Take it back with the count from release() */
+    synchronized void acquire(int count)
+    {
+        this.lock();
+        this.count = count;
+    }
+}
@@ -0,0 +1,71 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      CibylThread.java
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Java thread running a C function, for pthread_create
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+public class CibylThread implements Runnable
+{
+    private Thread thread;
+    private int fn;
+    private int arg;
+    private int sp;
+    private int result;
+
+    /**
+     * Create a thread which runs fn(arg) on the stack at sp. The
+     * stack is allocated (and freed) by the C code.
+     */
+    public CibylThread(int fn, int arg, int sp)
+    {
+        this.fn = fn;
+        this.arg = arg;
+        this.sp = sp;
+    }
+
+    /**
+     * Threads need code translated with thread_safe=1, which returns
+     * values on the Java stack instead of through CRunTime.saved_v1
+     */
+    public static boolean isSupported()
+    {
+        return CibylCallTable.threadSafe;
+    }
+
+    public void start()
+    {
+        if (!CibylThread.isSupported())
+            throw new RuntimeException("C threads need thread_safe=1 in the translator");
+
+        this.thread = new Thread(this);
+        this.thread.start();
+    }
+
+    public void run()
+    {
+        try {
+            this.result = (int)CibylCallTable.call(this.fn, this.sp, this.arg, 0, 0, 0);
+        } catch (Exception e) {
+            System.err.println("Uncaught exception in C thread: " + e);
+            e.printStackTrace();
+        }
+    }
+
+    /* Wait for the thread to finish and return the value it returned */
+    public int join()
+    {
+        while (true)
+        {
+            try {
+                this.thread.join();
+                return this.result;
+            } catch (InterruptedException e) {
+            }
+        }
+    }
+}
@@ -1,11 +1,32 @@
 public class SetjmpException extends Exception
 {
+    /* longjmp throws this one from the thread which first used it */
+    private static final SetjmpException shared = new SetjmpException(0, 0);
+    private static final Thread sharedThread = Thread.currentThread();
+
     public SetjmpException(int cookie, int val)
     {
         this.cookie = cookie;
         this.val = val;
     }
 
+    public static SetjmpException get(int cookie, int val)
+    {
+        if (Thread.currentThread() != sharedThread)
+            return new SetjmpException(cookie, val);
+
+        shared.cookie = cookie;
+        shared.val = val;
+
+        return shared;
+    }
+
+    /* No stack trace is needed to get back to the setjmp (not in CLDC) */
+    public Throwable fillInStackTrace()
+    {
+        return this;
+    }
+
     public int getCookie()
     {
         return this.cookie;
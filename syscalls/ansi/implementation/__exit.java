@@ -1,4 +1,5 @@
 	public static final void __exit(int a0) {
+	  CRunTime.runExitHooks();
 #if defined(NOJ2ME)
 	  System.exit(a0);
 #else
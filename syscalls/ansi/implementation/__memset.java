@@ -17,7 +17,7 @@ public static final int __memset(int s, int c, int n)
   }
 
   while (n > 3) {
-    CRunTime.memory[s >> 2] = i;
+    CRunTime.memoryWriteWord(s, i);
     s += 4;
     n -= 4;
   }
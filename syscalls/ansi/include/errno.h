@@ -15,4 +15,10 @@
 /* TMP! */
 #define errno 0
 
+/* Returned by pthread_* */
+#define ENOMEM  12
+#define EBUSY   16
+#define EINVAL  22
+#define EAGAIN  11
+
 #endif /* !__ERRNO_H__ */
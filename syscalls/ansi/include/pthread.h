@@ -0,0 +1,118 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      pthread.h
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Threads mapped to Java threads
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#ifndef __PTHREAD_H__
+#define __PTHREAD_H__
+
+#include <cibyl.h>
+#include <stddef.h>
+#include <errno.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*
+ * A small subset of pthreads. Each thread is a Java thread running
+ * on its own stack, allocated with malloc. The program must be
+ * translated with thread_safe=1, otherwise pthread_create returns
+ * EAGAIN.
+ *
+ * malloc/free, atexit and the stdio FILE functions (and with them
+ * printf, puts and putchar) are serialized once the first thread has
+ * been created. Object scopes (NOPH_pushObjectScope) and callbacks
+ * are shared by all threads, and errno is not per-thread.
+ */
+typedef int NOPH_CibylThread_t;
+typedef int NOPH_CibylMutex_t;
+typedef int NOPH_CibylCondition_t;
+
+NOPH_CibylThread_t NOPH_CibylThread_new(int fn, int arg, int sp);
+bool_t NOPH_CibylThread_isSupported(void);
+void NOPH_CibylThread_start(NOPH_CibylThread_t thread);
+int NOPH_CibylThread_join(NOPH_CibylThread_t thread);
+
+NOPH_CibylMutex_t NOPH_CibylMutex_new(void);
+void NOPH_CibylMutex_lock(NOPH_CibylMutex_t mutex);
+bool_t NOPH_CibylMutex_tryLock(NOPH_CibylMutex_t mutex);
+void NOPH_CibylMutex_unlock(NOPH_CibylMutex_t mutex);
+
+NOPH_CibylCondition_t NOPH_CibylCondition_new(void);
+void NOPH_CibylCondition_await(NOPH_CibylCondition_t cond, NOPH_CibylMutex_t mutex);
+void NOPH_CibylCondition_signal(NOPH_CibylCondition_t cond);
+void NOPH_CibylCondition_broadcast(NOPH_CibylCondition_t cond);
+
+typedef struct __pthread *pthread_t;
+
+typedef struct
+{
+  size_t stacksize;
+} pthread_attr_t;
+
+/* Mutexes are recursive, the Java object is created on first use */
+typedef struct
+{
+  NOPH_CibylMutex_t mutex;
+} pthread_mutex_t;
+
+typedef int pthread_mutexattr_t;
+
+typedef struct
+{
+  NOPH_CibylCondition_t cond;
+} pthread_cond_t;
+
+typedef int pthread_condattr_t;
+
+#define PTHREAD_MUTEX_INITIALIZER { 0 }
+#define PTHREAD_COND_INITIALIZER { 0 }
+
+extern int pthread_attr_init(pthread_attr_t *attr);
+extern int pthread_attr_destroy(pthread_attr_t *attr);
+extern int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize);
+
+extern int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+                          void *(*start_routine)(void *), void *arg);
+extern int pthread_join(pthread_t thread, void **value_ptr);
+
+extern int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
+extern int pthread_mutex_destroy(pthread_mutex_t *mutex);
+extern int pthread_mutex_lock(pthread_mutex_t *mutex);
+extern int pthread_mutex_trylock(pthread_mutex_t *mutex);
+extern int pthread_mutex_unlock(pthread_mutex_t *mutex);
+
+extern int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
+extern int pthread_cond_destroy(pthread_cond_t *cond);
+extern int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+extern int pthread_cond_signal(pthread_cond_t *cond);
+extern int pthread_cond_broadcast(pthread_cond_t *cond);
+
+/* Serializes libc (malloc, atexit, stdio) once threads are running */
+extern int __cibyl_threads_active;
+extern NOPH_CibylMutex_t __cibyl_libc_mutex;
+
+static inline void __cibyl_libc_lock(void)
+{
+  if (__cibyl_threads_active)
+    NOPH_CibylMutex_lock(__cibyl_libc_mutex);
+}
+
+static inline void __cibyl_libc_unlock(void)
+{
+  if (__cibyl_threads_active)
+    NOPH_CibylMutex_unlock(__cibyl_libc_mutex);
+}
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !__PTHREAD_H__ */
@@ -28,6 +28,7 @@ typedef int jmp_buf[1];
 
 /* "Builtins" */
 extern int __NOPH_setjmp(int cookie);
+extern void __NOPH_longjmp(int cookie, int val);
 
 static inline int __attribute__((returns_twice)) setjmp(jmp_buf env)
 {
@@ -53,10 +54,8 @@ static inline int __attribute__((returns_twice)) setjmp(jmp_buf env)
 
 static inline void longjmp(jmp_buf env, int val)
 {
-  NOPH_SetjmpException_t e = NOPH_SetjmpException_new(env[0], val);
-
   /* Raise the exception */
-  NOPH_throw(e);
+  __NOPH_longjmp(env[0], val);
 }
 
 #if defined(__cplusplus)
@@ -19,10 +19,9 @@ extern "C" {
 #include <stddef.h>
 #include <stdarg.h>
 
+/* Unbuffered console output, puts and putchar go through stdout */
 int __puts(const char* string); /* Not generated */
-#define puts __puts
 int __putchar(int c); /* Not generated */
-#define putchar __putchar
 
 /* File handling */
 #define SEEK_SET        0       /* Seek from beginning of file.  */
@@ -33,9 +32,16 @@ int __putchar(int c); /* Not generated */
 # define EOF (-1)
 #endif
 
+/* Buffering modes for setvbuf */
+#define _IOFBF          0       /* Fully buffered */
+#define _IOLBF          1       /* Line buffered */
+#define _IONBF          2       /* Unbuffered */
+
+#define BUFSIZ          1024
+
 struct s_cibyl_fops;
 
-typedef struct
+typedef struct s_FILE
 {
   struct s_cibyl_fops *ops;
   short   eof;   /* eof status */
@@ -44,6 +50,15 @@ typedef struct
   long    vfptr; /* Virtual file pointer */
   size_t  file_size;
   void   *priv;  /* Filesystem private stuff */
+
+  /* Buffering, see fileops.c */
+  unsigned char *buf;
+  size_t  buf_size;
+  size_t  buf_pos;   /* Next byte to read from buf */
+  size_t  buf_len;   /* Bytes read into buf or pending write */
+  short   buf_mode;  /* _IOFBF, _IOLBF or _IONBF */
+  short   buf_flags;
+  struct s_FILE *next; /* List of open files */
 } FILE;
 
 #define EOF (-1)
@@ -64,10 +79,14 @@ extern void rewind(FILE *stream);
 extern int fseek(FILE* stream, long offset, int whence); /* Not generated */
 extern long ftell(FILE *stream);
 extern int fflush(FILE* stream); /* Not generated */
+extern int setvbuf(FILE *stream, char *buf, int mode, size_t size); /* Not generated */
+#define setbuf(stream, buf) setvbuf(stream, buf, (buf) ? _IOFBF : _IONBF, BUFSIZ)
 
 extern int fgetc(FILE* stream); /* Not generated */
 extern char* fgets(char* s, int size, FILE* stream); /* Not generated */
 extern int fputc(int c, FILE* stream); /* Not generated */
+extern int putchar(int c);
+extern int puts(const char* string);
 #define fputs __fputs
 extern int __fputs(const char* ptr, FILE* stream); /* Not generated */
 
@@ -89,9 +108,6 @@ extern int sscanf(const char *str, const char *format, ...); /* TMP! */
 
 void __setup_io(void* addr_stdout, void* addr_stderr); /* Not generated */
 
-/* Does not apply for us yet */
-#define setbuf(stream, buf)
-
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,6 @@
+public static final void NOPH_OutputStream_write_from(int obj, int ptr, int size) throws Exception
+{
+  OutputStream os = (OutputStream)CRunTime.getRegisteredObject(obj);
+
+  CRunTime.writeFrom(os, ptr, size);
+}
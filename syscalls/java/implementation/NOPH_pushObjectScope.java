@@ -0,0 +1,3 @@
+	public static final void NOPH_pushObjectScope() {
+		CRunTime.pushObjectScope();
+	}
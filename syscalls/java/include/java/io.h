@@ -41,6 +41,7 @@ int NOPH_InputStream_skip(NOPH_InputStream_t is, int n); /* Throws */
 
 /* Output stream stuff */
 void NOPH_OutputStream_write(NOPH_OutputStream_t os, int b); /* Throws */
+void NOPH_OutputStream_write_from(NOPH_OutputStream_t os, const char* vec, int size); /* Not generated */
 void NOPH_OutputStream_flush(NOPH_OutputStream_t os); /* Throws */
 void NOPH_OutputStream_close(NOPH_OutputStream_t os); /* Throws */
 
@@ -27,6 +27,19 @@ typedef int NOPH_Throwable_t;
 
 void NOPH_delete(NOPH_Object_t obj); /* Not generated */
 
+/**
+ * Start a new object scope. Objects returned from system calls after
+ * this are released together by the matching NOPH_popObjectScope().
+ * Scopes can be nested.
+ */
+void NOPH_pushObjectScope(void); /* Not generated */
+
+/**
+ * Release all objects still registered in the current object
+ * scope. Handles to these objects are invalid afterwards.
+ */
+void NOPH_popObjectScope(void); /* Not generated */
+
 /**
  * Write a Java String object to a char pointer.
  *
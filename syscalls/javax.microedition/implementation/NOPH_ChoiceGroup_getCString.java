@@ -1,6 +1,6 @@
 	public static final void NOPH_ChoiceGroup_getCString(int __tf, int elementNum, int buffer, int size)
         {
-		ChoiceGroup choice = (ChoiceGroup)CRunTime.objectRepository[__tf];
+		ChoiceGroup choice = (ChoiceGroup)CRunTime.getRegisteredObject(__tf);
 		String text = choice.getString(elementNum);
 
 		try {
@@ -1,7 +1,18 @@
 	public static final void NOPH_Graphics_drawRGB(int __graphics, int rgbData, int offset, int scanlength,
 						       int x, int y, int width, int height, int processAlpha)
         {
-		Graphics graphics = (Graphics)CRunTime.objectRepository[__graphics];
+		Graphics graphics = (Graphics)CRunTime.getRegisteredObject(__graphics);
 
+		if (CibylCallTable.byteMemory)
+		{
+			/* drawRGB needs an int[], copy the rectangle */
+			int[] rgb = new int[width * height];
+
+			for (int i = 0; i < height; i++)
+				for (int j = 0; j < width; j++)
+					rgb[i * width + j] = CRunTime.memoryReadWord(rgbData + offset + (i * scanlength + j) * 4);
+			graphics.drawRGB(rgb, 0, width, x, y, width, height, processAlpha != 0);
+			return;
+		}
 		graphics.drawRGB(CRunTime.memory, (rgbData + offset) >> 2, scanlength, x, y, width, height, processAlpha != 0);
 	}
@@ -2,8 +2,11 @@
         {
 	  RecordStore rs = (RecordStore)CRunTime.getRegisteredObject( _rs );
 
-          byte tmp[] = rs.getRecord(recordId);
-          for (int i = 0; i < tmp.length; i++)
-              CRunTime.memoryWriteByte(_buffer + offset + i, tmp[i]);
-          return tmp.length;
+	  synchronized (CRunTime.transferLock) {
+	    byte tmp[] = CRunTime.getTransferBuffer(rs.getRecordSize(recordId));
+	    int n = rs.getRecord(recordId, tmp, 0);
+
+	    CRunTime.memcpy(_buffer + offset, tmp, 0, n);
+	    return n;
+	  }
 	}
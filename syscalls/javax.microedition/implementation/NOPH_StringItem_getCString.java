@@ -1,6 +1,6 @@
 	public static final void NOPH_StringItem_getCString(int __si, int buffer, int size)
         {
-		StringItem stringField = (StringItem)CRunTime.objectRepository[__si];
+		StringItem stringField = (StringItem)CRunTime.getRegisteredObject(__si);
 		String text = stringField.getText();
 
 		try {
@@ -1,6 +1,6 @@
 	public static final void NOPH_TextField_getCString(int __tf, int buffer, int size)
         {
-		TextField textField = (TextField)CRunTime.objectRepository[__tf];
+		TextField textField = (TextField)CRunTime.getRegisteredObject(__tf);
 		String text = textField.getString();
 
 		try {
@@ -15,15 +15,13 @@ public class PolygonGraphics {
                                    int count) {
         if ((xPointsAddr % 4) != 0) System.out.println("Unaligned X addr:" + xPointsAddr);
         if ((yPointsAddr % 4) != 0) System.out.println("Unaligned Y addr:" + yPointsAddr);
-        xPointsAddr /= 4;
-        yPointsAddr /= 4;
         int[] xPoints = new int[count];
         int[] yPoints = new int[count];
 
         for (int i = 0; i < count; i++)
         {
-            xPoints[i] = CRunTime.memory[xPointsAddr + i];
-            yPoints[i] = CRunTime.memory[yPointsAddr + i];
+            xPoints[i] = CRunTime.memoryReadWord(xPointsAddr + i * 4);
+            yPoints[i] = CRunTime.memoryReadWord(yPointsAddr + i * 4);
         }
 
         drawPolygon(g, xPoints, yPoints);
@@ -36,13 +34,11 @@ public class PolygonGraphics {
 
         if ((xPointsAddr % 4) != 0) System.out.println("Unaligned X addr:" + xPointsAddr);
         if ((yPointsAddr % 4) != 0) System.out.println("Unaligned Y addr:" + yPointsAddr);
-        xPointsAddr /= 4;
-        yPointsAddr /= 4;
 
         for (int i = 0; i < count; i++)
         {
-            xPoints[i] = CRunTime.memory[xPointsAddr + i];
-            yPoints[i] = CRunTime.memory[yPointsAddr + i];
+            xPoints[i] = CRunTime.memoryReadWord(xPointsAddr + i * 4);
+            yPoints[i] = CRunTime.memoryReadWord(yPointsAddr + i * 4);
         }
 
         fillPolygon(g, xPoints, yPoints);
@@ -51,6 +51,7 @@ extern void function_run(void);
 extern void tail_call_run(void);
 extern void store_s_regs_run(void);
 extern void structs_by_value_run(void);
+extern void threads_run(void);
 
 test_run_t all_tests[] =
 {
@@ -75,6 +76,7 @@ test_run_t all_tests[] =
   TEST(tail_call_run),
   TEST(store_s_regs_run),
   TEST(structs_by_value_run),
+  TEST(threads_run),
 };
 
 
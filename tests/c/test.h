@@ -87,6 +87,7 @@ typedef struct                                   \
 #define binary_arithmetic_test_unsigned_short_constant(name, constant, op) __binary_arithmetic_test(name, unsigned short, constant, unsigned short, op)
 #define binary_arithmetic_test_unsigned_int(name, op) __binary_arithmetic_test(name, unsigned int, unsigned int, unsigned int, op)
 #define binary_arithmetic_test_unsigned_int_constant(name, constant, op) __binary_arithmehic_test(name, unsigned int, constant, unsigned int, op)
+#define binary_arithmetic_test_unsigned_longlong(name, op) __binary_arithmetic_test(name, unsigned long long, unsigned long long, unsigned long long, op)
 
 #define binary_arithmetic_test_float(name, op) __binary_arithmetic_test(name, float, float, float, op)
 #define binary_arithmetic_test_float_constant(name, constant, op) __binary_arithmetic_test(name, float, constant, float, op)
@@ -107,6 +108,7 @@ bin_test_struct(unsigned_short_test_t, unsigned short);
 bin_test_struct(int_test_t, int);
 bin_test_struct(longlong_test_t, long long);
 bin_test_struct(unsigned_int_test_t, unsigned int);
+bin_test_struct(unsigned_longlong_test_t, unsigned long long);
 
 bin_test_struct(float_test_t, float);
 bin_test_struct(double_test_t, double);
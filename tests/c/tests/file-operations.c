@@ -119,6 +119,24 @@ int test_seek_end_read_end(FILE *fp)
   return n;
 }
 
+/* Unaligned start and end, the bytes around should be left alone */
+int test_unaligned_read(FILE *fp)
+{
+  char buf[12];
+  int n;
+
+  memset(buf, 'x', sizeof(buf));
+  fseek(fp, 1, SEEK_SET);
+  n = fread((void*)(buf + 1), sizeof(char), 9, fp);
+  if (n != 9)
+    return n;
+  else if (buf[0] != 'x' || buf[10] != 'x' ||
+           memcmp(buf + 1, test_str + 1, 9) != 0)
+    return -1;
+
+  return n;
+}
+
 static void parse_return_val(const char *op, const char *path, int ret, int xret)
 {
   if (ret < 0)
@@ -151,6 +169,9 @@ void fs_read_test(FILE *fp, const char *op, const char *path)
   /* Test seek from the end and read less than what is left  */
   parse_return_val(buf, path,
                    test_seek_end_read_end(fp), 3);
+  /* Test a read to an unaligned buffer */
+  parse_return_val(buf, path,
+                   test_unaligned_read(fp), 9);
 }
 
 
@@ -215,6 +236,31 @@ static void one_test_write(FILE *fp, const char *path, const char *name)
     FAIL("%s open write %s\n", name, path);
 }
 
+/* GCC turns printf("...\n") into puts and printf("\n") into putchar,
+ * these should all end up in order in the stdout buffer */
+static void stdout_order_test(void)
+{
+  static char outbuf[64];
+  int ok;
+
+  fflush(stdout);
+  memset(outbuf, 0, sizeof(outbuf));
+  setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+
+  printf("a%d", 1);
+  puts("b");
+  putchar('c');
+  printf("\n");
+  ok = memcmp(outbuf, "a1b\nc\n", 6) == 0;
+
+  /* Back to the default (which writes the above) */
+  setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+  if (ok)
+    PASS("stdout order %s", "printf/puts/putchar");
+  else
+    FAIL("stdout order %s", "printf/puts/putchar");
+}
+
 extern char *fs_root;
 
 void file_operations_run(void)
@@ -227,6 +273,8 @@ void file_operations_run(void)
   FILE *fp;
   int r;
 
+  stdout_order_test();
+
   snprintf(buf, 128, "file:///%s/cibyl_a", fs_root);
   path = buf;
 
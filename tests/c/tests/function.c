@@ -11,9 +11,74 @@
  ********************************************************************/
 #include <test.h>
 
+/* In tail_call.S, deep enough to overflow the Java stack without tail calls */
+extern int tail_count_asm(int n, int acc);
+
+/* a0 is never read and only part of the 64-bit result is used */
+static long long __attribute__((noinline)) skip_first(int unused, int a, int b)
+{
+  return ((long long)a << 32) | (unsigned)b;
+}
+
+/* The address of y is passed on, so this can't become a jump to
+ * pass_through_inner. The return value just passes through v0 */
+static int __attribute__((noinline)) pass_through_inner(int *p)
+{
+  return *p * 3;
+}
+
+static int __attribute__((noinline)) pass_through(int x)
+{
+  int y = x + 1;
+
+  return pass_through_inner(&y);
+}
+
+/* Mutual recursion, where only some of the calls use the result */
+static int __attribute__((noinline)) is_odd(int n);
+
+static int __attribute__((noinline)) is_even(int n)
+{
+  if (n == 0)
+    return 1;
+  return is_odd(n - 1);
+}
+
+static int __attribute__((noinline)) is_odd(int n)
+{
+  if (n == 0)
+    return 0;
+  return is_even(n - 1);
+}
+
 /* The run-the-tests function */
 void function_run(void)
 {
+  int v = tail_count_asm(200000, 0);
+
+  if (v != 300000)
+    FAIL("tail_count: %d != 300000\n", v);
+  else
+    PASS("tail_count: %d\n", v);
+
+  v = (int)skip_first(9, 1, 2);
+  if (v != 2)
+    FAIL("skip_first: %d != 2\n", v);
+  else
+    PASS("skip_first: %d\n", v);
+
+  v = pass_through(4);
+  if (v != 15)
+    FAIL("pass_through: %d != 15\n", v);
+  else
+    PASS("pass_through: %d\n", v);
+
+  is_even(4);
+  if (!is_even(10) || is_odd(10))
+    FAIL("is_even/is_odd: %d %d\n", is_even(10), is_odd(10));
+  else
+    PASS("is_even/is_odd: %d\n", is_even(10));
+
 #if 0
   implicit_declaration(1, 2, "tre", "fyra", "fem",
                        "sex", 7, 8, 9, "tio", "elva");
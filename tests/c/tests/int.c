@@ -141,6 +141,67 @@ int int_nor(int a, int b)
        PASS("nor %x, %x: %x != %x", a, b, res, ~((a) | (b)));    \
    }
 
+/* Multiplications and divisions by constants */
+#define const_op(name, type, op, c)                             \
+  type name(type a) { return a op (c); }
+
+const_op(int_mul_10, int, *, 10)
+const_op(int_mul_m8, int, *, -8)
+const_op(int_mulu_7, unsigned int, *, 7)
+const_op(int_div_8, int, /, 8)
+const_op(int_div_7, int, /, 7)
+const_op(int_div_m100, int, /, -100)
+const_op(int_mod_7, int, %, 7)
+const_op(int_mod_16, int, %, 16)
+const_op(int_divu_16, unsigned int, /, 16)
+const_op(int_modu_16, unsigned int, %, 16)
+
+#define run_const_op(name, type, op, c, a)                      \
+   {                                                            \
+     volatile type vc = (c);                                    \
+     type res = name(a);                                        \
+     if (res != (type)((a) op vc))                              \
+       FAIL(#name " %d: %d != %d", a, res, (a) op vc);          \
+     else                                                       \
+       PASS(#name " %d: %d", a, res);                           \
+   }
+
+static void int_const_run(int a)
+{
+  run_const_op(int_mul_10, int, *, 10, a);
+  run_const_op(int_mul_m8, int, *, -8, a);
+  run_const_op(int_mulu_7, unsigned int, *, 7, (unsigned int)a);
+  run_const_op(int_div_8, int, /, 8, a);
+  run_const_op(int_div_7, int, /, 7, a);
+  run_const_op(int_div_m100, int, /, -100, a);
+  run_const_op(int_mod_7, int, %, 7, a);
+  run_const_op(int_mod_16, int, %, 16, a);
+  run_const_op(int_divu_16, unsigned int, /, 16, (unsigned int)a);
+  run_const_op(int_modu_16, unsigned int, %, 16, (unsigned int)a);
+}
+
+/* The multiplier is a different constant on the two paths */
+int __attribute__((noinline)) int_mul_select(int a, int b)
+{
+  int c = 12345;
+
+  if (b)
+    c = 54321;
+
+  return a * c;
+}
+
+static void int_mul_select_run(int a, int b)
+{
+  int res = int_mul_select(a, b);
+  int correct = a * (b ? 54321 : 12345);
+
+  if (res != correct)
+    FAIL("int_mul_select %d, %d: %d != %d", a, b, res, correct);
+  else
+    PASS("int_mul_select %d, %d: %d", a, b, res);
+}
+
 /* The run-the-tests function */
 void int_run(void)
 {
@@ -153,4 +214,13 @@ void int_run(void)
   run_nor(0x0, 0xfff00fff);
   run_nor(0x0fffffff, 0xf0000000);
   run_nor(0xf0000000, 0x10000000);
+
+  int_const_run(0);
+  int_const_run(13);
+  int_const_run(-13);
+  int_const_run(0x7fffffff);
+  int_const_run(0x80000000);
+
+  int_mul_select_run(7, 0);
+  int_mul_select_run(7, 1);
 }
@@ -14,6 +14,7 @@ void j2me_run(void)
 {
 }
 #else
+#include <string.h>
 #include <java/lang.h>
 #include <test.h>
 
@@ -27,10 +28,59 @@ static void System_currentTimeMillis(void)
     FAIL("System.currentTimeMillis < 0: %lld\n", time);
 }
 
+static void object_scopes(void)
+{
+  NOPH_Exception_t a, b, c;
+  int i;
+
+  NOPH_pushObjectScope();
+  a = NOPH_Exception_new();
+  b = NOPH_Exception_new();
+
+  NOPH_pushObjectScope();
+  for (i = 0; i < 1000; i++)
+    NOPH_Exception_new();
+  NOPH_popObjectScope();
+
+  c = NOPH_Exception_new();
+  NOPH_delete(b);
+  NOPH_popObjectScope();
+
+  if (a != 0 && b != 0 && c != 0 && a != b && b != c && a != c)
+    PASS("Object scopes: %x %x %x\n", a, b, c);
+  else
+    FAIL("Object scopes: %x %x %x\n", a, b, c);
+}
+
+static void string_marshaling(void)
+{
+  char src[] = "xyzA string which spans a few words";
+  char buf[64];
+  NOPH_String_t str;
+  int n;
+
+  /* Start at an unaligned address */
+  str = NOPH_Throwable_getMessage(NOPH_Exception_new_string(src + 3));
+  n = NOPH_String_toCharPtr(str, buf + 1, sizeof(buf) - 1);
+  if (n == strlen(src + 3) && strcmp(buf + 1, src + 3) == 0)
+    PASS("String to char*: %s\n", buf + 1);
+  else
+    FAIL("String to char*: %d %s\n", n, buf + 1);
+
+  /* Truncated */
+  n = NOPH_String_toCharPtr(str, buf, 6);
+  if (n == 5 && strcmp(buf, "A str") == 0)
+    PASS("Truncated String to char*: %s\n", buf);
+  else
+    FAIL("Truncated String to char*: %d %s\n", n, buf);
+}
+
 /* The run-the-tests function */
 void j2me_run(void)
 {
   System_currentTimeMillis();
+  object_scopes();
+  string_marshaling();
 }
 
 #endif
@@ -210,6 +210,39 @@ void exception_test_setjmp(void)
   exception_test_longjmp_1();
 }
 
+/* Several setjmp points in one function, longjmp many times */
+jmp_buf jb_a;
+jmp_buf jb_b;
+
+void __attribute__((noinline)) exception_test_longjmp_to(jmp_buf env, int v)
+{
+  longjmp(env, v);
+}
+
+void exception_test_setjmp_multiple(void)
+{
+  volatile int n_a = 0;
+  volatile int n_b = 0;
+  int v;
+
+  v = setjmp(jb_a);
+  if (v != 0)
+    n_a += v;
+  if (n_a < 100)
+    exception_test_longjmp_to(jb_a, 1);
+
+  v = setjmp(jb_b);
+  if (v != 0)
+    n_b += v;
+  if (n_b < 20)
+    exception_test_longjmp_to(jb_b, 2);
+
+  if (n_a != 100 || n_b != 20)
+    FAIL("multiple setjmp: %d %d", n_a, n_b);
+  else
+    PASS("multiple setjmp: %d %d", n_a, n_b);
+}
+
 extern void assign_to_ra(void);
 
 /* The run-the-tests function */
@@ -227,6 +260,7 @@ void exceptions_run(void)
   exception_test_multiple();
   exception_test_stacked();
   exception_test_setjmp();
+  exception_test_setjmp_multiple();
 
   NOPH_try(handler_file_io, (void*)&threw_exception) {
     NOPH_Connector_openDataInputStream(s);
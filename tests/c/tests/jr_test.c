@@ -15,10 +15,49 @@ extern int jr_test_asm(void);
 
 extern long long return_in_v1_asm(void);
 
+/* Large enough for GCC to generate a jump table. tools/translator/tests/run.sh
+ * checks that this becomes a tableswitch */
+static int __attribute__((noinline)) jr_switch(int v)
+{
+  switch(v)
+    {
+    case 0: return 7;
+    case 1: return 19;
+    case 2: return -4;
+    case 3: return 1000;
+    case 5: return 8;
+    case 6: return v * 3;
+    case 7: return 99;
+    case 8: return -71;
+    default:
+      break;
+    }
+  return 42;
+}
+
+/* Biased, GCC subtracts the minimum and scales the index in place */
+static int jr_switch_biased(char c)
+{
+  switch(c - 'a')
+    {
+    case 0: return 3;
+    case 1: return 11;
+    case 2: return -9;
+    case 3: return 400;
+    case 4: return 27;
+    case 6: return c;
+    case 7: return 5;
+    default:
+      break;
+    }
+  return 42;
+}
+
 /* The run-the-tests function */
 void jr_run(void)
 {
-  int v;
+  int expected[] = {42, 7, 19, -4, 1000, 42, 8, 18, 99, -71, 42, 42};
+  int i, v;
   long long v2;
 
   v = jr_test_asm();
@@ -32,4 +71,32 @@ void jr_run(void)
     PASS("return_in_v1: %x:%08x\n", (unsigned int)(v2 >> 32), (unsigned int)(v2 & 0xffffffff) );
   else
     FAIL("return_in_v1: %x:%08x != 0x1:Random\n", (unsigned int)(v2 >> 32), (unsigned int)(v2 & 0xffffffff) );
+
+  /* Both in and out of the table range */
+  for (i = 0; i < sizeof(expected) / sizeof(int); i++)
+    {
+      v = jr_switch(i - 1);
+      if (v != expected[i])
+        {
+          FAIL("jr_switch(%d): %d != %d\n", i - 1, v, expected[i]);
+          return;
+        }
+    }
+  PASS("jr_switch: %d cases\n", i);
+
+  {
+    const char *in = "`abcdefghi";
+    int expected_biased[] = {42, 3, 11, -9, 400, 27, 42, 'g', 5, 42};
+
+    for (i = 0; in[i]; i++)
+      {
+        v = jr_switch_biased(in[i]);
+        if (v != expected_biased[i])
+          {
+            FAIL("jr_switch_biased('%c'): %d != %d\n", in[i], v, expected_biased[i]);
+            return;
+          }
+      }
+    PASS("jr_switch_biased: %d cases\n", i);
+  }
 }
@@ -30,6 +30,13 @@ binary_arithmetic_test_longlong(longlong_gt, >);
 binary_arithmetic_test_longlong(longlong_eq, ==);
 binary_arithmetic_test_longlong(longlong_ne, !=);
 
+binary_arithmetic_test_unsigned_longlong(ulonglong_mul, *);
+binary_arithmetic_test_unsigned_longlong(ulonglong_div, /);
+binary_arithmetic_test_unsigned_longlong(ulonglong_mod, %);
+binary_arithmetic_test_unsigned_longlong(ulonglong_shr, >>);
+binary_arithmetic_test_unsigned_longlong(ulonglong_lt, <);
+binary_arithmetic_test_unsigned_longlong(ulonglong_ge, >=);
+
 /* The actual tests (add more here, especially regressions) */
 static longlong_test_t longlong_tests[] =
 {
@@ -126,10 +133,45 @@ static longlong_test_t longlong_tests[] =
 
   BIN_OP(longlong_ne, !=, 1, -1),
   BIN_OP(longlong_ne, !=, 0, 0),
+
+  /* Low words with the top bit set */
+  BIN_OP(longlong_div, /,  0x1ffffffffll, 3ll),
+  BIN_OP(longlong_mod, %,  0x1ffffffffll, 7ll),
+  BIN_OP(longlong_mul, *,  0x80000000ll, 0x80000001ll),
+  BIN_OP(longlong_lt, <,   0x80000000ll, 0x7fffffffll),
+};
+
+static unsigned_longlong_test_t ulonglong_tests[] =
+{
+  BIN_OP(ulonglong_mul, *,  0xffffffffull, 0xffffffffull),
+  BIN_OP(ulonglong_mul, *,  0xffffffffffffffffull, 2ull),
+
+  BIN_OP(ulonglong_div, /,  155525ull, 536ull),
+  BIN_OP(ulonglong_div, /,  0x1ffffffffull, 3ull),
+  BIN_OP(ulonglong_div, /,  0xffffffffffffffffull, 10ull),
+  BIN_OP(ulonglong_div, /,  0xffffffffffffffffull, 0x8000000000000000ull),
+  BIN_OP(ulonglong_div, /,  0x7fffffffffffffffull, 0x8000000000000000ull),
+  BIN_OP(ulonglong_div, /,  0x8000000000000001ull, 0xffffffffull),
+
+  BIN_OP(ulonglong_mod, %,  155525ull, 536ull),
+  BIN_OP(ulonglong_mod, %,  0xffffffffffffffffull, 10ull),
+  BIN_OP(ulonglong_mod, %,  0xffffffffffffffffull, 0x8000000000000000ull),
+  BIN_OP(ulonglong_mod, %,  0x8000000000000001ull, 0xffffffffull),
+
+  BIN_OP(ulonglong_shr, >>, 0x8000000000000000ull, 1),
+  BIN_OP(ulonglong_shr, >>, 0xffffffffffffffffull, 33),
+  BIN_OP(ulonglong_shr, >>, 0x10ull, 1),
+
+  BIN_OP(ulonglong_lt, <,   1ull, 0xffffffffffffffffull),
+  BIN_OP(ulonglong_lt, <,   0xffffffffffffffffull, 1ull),
+  BIN_OP(ulonglong_lt, <,   0x80000000ull, 0x7fffffffull),
+  BIN_OP(ulonglong_ge, >=,  0x8000000000000000ull, 0x7fffffffffffffffull),
+  BIN_OP(ulonglong_ge, >=,  5ull, 5ull),
 };
 
 /* The run-the-tests function */
 void longlong_run(void)
 {
   run_test_bin_vector(long long, longlong_test_t, longlong_tests, "%Ld");
+  run_test_bin_vector(unsigned long long, unsigned_longlong_test_t, ulonglong_tests, "%Lu");
 }
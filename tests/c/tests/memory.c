@@ -170,6 +170,242 @@ void memory_test_swl(struct tjoho *src, int val,
     PASS("swl: 0x%x != 0x%02x%02x%02x%02x, %2x\n", val, p[0], p[1], p[2], p[3], src->a);
 }
 
+/* Without its partner, lwl/lwr/swl/swr only touch part of the word */
+uint32_t memory_partial_words[2] = {0x11223344, 0x55667788};
+
+unsigned int memory_lwl_unpaired(void *p, unsigned int rt)
+{
+  asm volatile("lwl %[rt], 0(%[p]) \n"
+               : [rt]"+r"(rt)
+               : [p]"r"(p));
+  return rt;
+}
+
+unsigned int memory_lwr_unpaired(void *p, unsigned int rt)
+{
+  asm volatile("lwr %[rt], 0(%[p]) \n"
+               : [rt]"+r"(rt)
+               : [p]"r"(p));
+  return rt;
+}
+
+void memory_swr_unpaired(void *p, unsigned int rt)
+{
+  asm volatile("swr %[rt], 0(%[p]) \n"
+               :
+               : [rt]"r"(rt), [p]"r"(p)
+               : "memory");
+}
+
+void memory_test_unpaired(void)
+{
+  uint8_t *p = (uint8_t*)memory_partial_words;
+  unsigned int res;
+
+  res = memory_lwl_unpaired(p + 1, 0xaabbccdd);
+  if (res != 0x223344dd)
+    FAIL("unpaired lwl: 0x%x != 0x223344dd", res);
+  else
+    PASS("unpaired lwl: 0x%x", res);
+
+  res = memory_lwr_unpaired(p + 1, 0xaabbccdd);
+  if (res != 0xaabb1122)
+    FAIL("unpaired lwr: 0x%x != 0xaabb1122", res);
+  else
+    PASS("unpaired lwr: 0x%x", res);
+
+  memory_swr_unpaired(p + 6, 0xaabbccdd);
+  if (memory_partial_words[1] != 0xbbccdd88)
+    FAIL("unpaired swr: 0x%x != 0xbbccdd88", memory_partial_words[1]);
+  else
+    PASS("unpaired swr: 0x%x", memory_partial_words[1]);
+}
+
+/* Runs of lw/sw off the same base share the word index */
+struct memory_fields
+{
+  int a, b, c, d;
+  struct memory_fields *next;
+  int e, f;
+};
+
+int __attribute__((noinline)) memory_swap_fields(struct memory_fields *p)
+{
+  int a = p->a;
+  int b = p->b;
+
+  p->a = p->d;
+  p->b = p->c;
+  p->c = b;
+  p->d = a;
+
+  /* The base changes here */
+  p = p->next;
+  p->e = p->f + a;
+
+  return p->a + p->b + p->e;
+}
+
+void memory_test_shared_base(void)
+{
+  struct memory_fields second = {10, 20, 30, 40, NULL, 50, 60};
+  struct memory_fields first = {1, 2, 3, 4, &second, 5, 6};
+  int res;
+
+  res = memory_swap_fields(&first);
+  if (first.a != 4 || first.b != 3 || first.c != 2 || first.d != 1 ||
+      second.e != 61 || res != 91)
+    FAIL("shared base: %d %d %d %d %d %d", first.a, first.b, first.c, first.d,
+         second.e, res);
+  else
+    PASS("shared base: %d %d %d %d %d %d", first.a, first.b, first.c, first.d,
+         second.e, res);
+}
+
+/* Two bases with the accesses interleaved, the groups overlap */
+int __attribute__((noinline)) memory_interleaved_fields(struct memory_fields *p,
+                                                        struct memory_fields *q)
+{
+  return (p->a - q->a) + (p->b - q->b) * 3 + (p->c - q->c) * 7;
+}
+
+void memory_test_interleaved_base(void)
+{
+  struct memory_fields p = {10, 20, 30, 40, NULL, 50, 60};
+  struct memory_fields q = {1, 2, 3, 4, NULL, 5, 6};
+  int res;
+
+  res = memory_interleaved_fields(&p, &q);
+  if (res != 9 + 18 * 3 + 27 * 7)
+    FAIL("interleaved base: %d != %d", res, 9 + 18 * 3 + 27 * 7);
+  else
+    PASS("interleaved base: %d", res);
+}
+
+/* The last fields are read on both paths, the first only on one */
+int __attribute__((noinline)) memory_skip_fields(struct memory_fields *p, int skip)
+{
+  int out = 0;
+
+  if (!skip)
+    out = p->a * 3 + p->b;
+
+  return out + p->c * 5 + p->d + p->e;
+}
+
+void memory_test_skipped_base(void)
+{
+  struct memory_fields p = {1, 2, 3, 4, NULL, 5, 6};
+  int res;
+
+  res = memory_skip_fields(&p, 1);
+  if (res != 24)
+    FAIL("skipped base: %d != 24", res);
+  else
+    PASS("skipped base: %d", res);
+
+  res = memory_skip_fields(&p, 0);
+  if (res != 29)
+    FAIL("not skipped base: %d != 29", res);
+  else
+    PASS("not skipped base: %d", res);
+}
+
+/* Loads of words just stored or loaded are taken from the register */
+volatile int memory_forward_global;
+
+int __attribute__((noinline)) memory_forward(int *p, int v)
+{
+  int a, b, c;
+
+  memory_forward_global = v;
+  a = memory_forward_global;
+  b = memory_forward_global;
+
+  /* p might point to the global */
+  *p = a + b;
+  c = memory_forward_global;
+
+  return a + b + c;
+}
+
+void memory_test_forwarding(void)
+{
+  int other;
+  int res;
+
+  res = memory_forward(&other, 3);
+  if (res != 9 || other != 6 || memory_forward_global != 3)
+    FAIL("forwarding: %d %d %d", res, other, memory_forward_global);
+  else
+    PASS("forwarding: %d %d %d", res, other, memory_forward_global);
+
+  res = memory_forward((int*)&memory_forward_global, 3);
+  if (res != 12 || memory_forward_global != 6)
+    FAIL("forwarding aliased: %d %d", res, memory_forward_global);
+  else
+    PASS("forwarding aliased: %d %d", res, memory_forward_global);
+}
+
+/* The first *p and the one in the loop are in the same basic block,
+ * but the loop label is in between so the loop has to reload it */
+int __attribute__((noinline)) memory_forward_loop(int *p, int *end)
+{
+  int first = *p;
+  int sum = 0;
+
+  do
+    {
+      sum += *p;
+      p++;
+    } while (p != end);
+
+  return first * 100 + sum;
+}
+
+void memory_test_forwarding_loop(void)
+{
+  int vals[4] = {1, 2, 3, 4};
+  int res;
+
+  res = memory_forward_loop(vals, &vals[4]);
+  if (res != 110)
+    FAIL("forwarding loop: %d != 110", res);
+  else
+    PASS("forwarding loop: %d", res);
+}
+
+/* Stack-relative byte and halfword accesses have a known alignment */
+void memory_test_stack_partial(void)
+{
+  volatile union
+  {
+    uint32_t w[2];
+    uint16_t h[4];
+    uint8_t b[8];
+    int8_t sb[8];
+    int16_t sh[4];
+  } u;
+
+  u.w[0] = 0x11223344;
+  u.w[1] = 0x55667788;
+  u.b[1] = 0xaa;
+  u.b[6] = 0xbb;
+  u.h[0] = (u.h[0] & 0xff) | 0xcc00;
+  u.h[3] = 0xfedc;
+
+  if (u.w[0] != 0xccaa3344 || u.w[1] != 0x5566fedc)
+    FAIL("stack sb/sh: 0x%08x 0x%08x", u.w[0], u.w[1]);
+  else
+    PASS("stack sb/sh: 0x%08x 0x%08x", u.w[0], u.w[1]);
+
+  if (u.b[0] != 0xcc || u.b[3] != 0x44 || u.sb[1] != (int8_t)0xaa ||
+      u.h[1] != 0x3344 || u.sh[3] != (int16_t)0xfedc)
+    FAIL("stack lb/lh: %x %x %x %x %x", u.b[0], u.b[3], u.sb[1], u.h[1], u.sh[3]);
+  else
+    PASS("stack lb/lh: %x %x %x %x %x", u.b[0], u.b[3], u.sb[1], u.h[1], u.sh[3]);
+}
+
 /* The run-the-tests function */
 void memory_run(void)
 {
@@ -242,4 +478,12 @@ void memory_run(void)
   memory_test_swl(&tmp, 0xff001234,
                   0xff,
                   0xff, 0x00, 0x12, 0x34);
+
+  memory_test_stack_partial();
+  memory_test_unpaired();
+  memory_test_shared_base();
+  memory_test_interleaved_base();
+  memory_test_skipped_base();
+  memory_test_forwarding();
+  memory_test_forwarding_loop();
 }
@@ -0,0 +1,147 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      threads.c
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   pthread tests
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <test.h>
+
+#define N_THREADS    4
+#define N_ITERATIONS 500
+#define N_WRITES     10
+
+static pthread_mutex_t counter_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static int counter;
+static int n_done;
+
+static void *threads_worker(void *arg)
+{
+  int i;
+
+  for (i = 0; i < N_ITERATIONS; i++)
+    {
+      void *p;
+
+      pthread_mutex_lock(&counter_mutex);
+      counter++;
+      pthread_mutex_unlock(&counter_mutex);
+
+      /* malloc is shared by all threads */
+      p = malloc(16 + (i & 63));
+      free(p);
+    }
+
+  pthread_mutex_lock(&counter_mutex);
+  n_done++;
+  pthread_cond_signal(&done_cond);
+  pthread_mutex_unlock(&counter_mutex);
+
+  return (void*)((long)arg * 2);
+}
+
+void threads_test_counter(void)
+{
+  pthread_t threads[N_THREADS];
+  int ret = 0;
+  int n;
+  int i;
+
+  counter = 0;
+  n_done = 0;
+  for (n = 0; n < N_THREADS; n++)
+    {
+      ret = pthread_create(&threads[n], NULL, threads_worker, (void*)(long)(n + 1));
+      if (ret != 0)
+        break;
+    }
+  if (n == 0)
+    {
+      PASS("Threads not supported (thread_safe=0?): %d\n", ret);
+      return;
+    }
+
+  pthread_mutex_lock(&counter_mutex);
+  while (n_done < n)
+    pthread_cond_wait(&done_cond, &counter_mutex);
+  pthread_mutex_unlock(&counter_mutex);
+
+  for (i = 0; i < n; i++)
+    {
+      void *val;
+
+      pthread_join(threads[i], &val);
+      if ((long)val != (i + 1) * 2)
+        FAIL("pthread_join value of thread %d: %ld, not %d\n", i, (long)val, (i + 1) * 2);
+      else
+        PASS("pthread_join value of thread %d: %ld\n", i, (long)val);
+    }
+
+  if (counter != n * N_ITERATIONS)
+    FAIL("Threads counted to %d, not %d\n", counter, n * N_ITERATIONS);
+  else
+    PASS("Threads counted to %d\n", counter);
+}
+
+/* stdout is shared, the writes must not mix in the buffer */
+static void *threads_stdio_worker(void *arg)
+{
+  int i;
+
+  for (i = 0; i < N_WRITES; i++)
+    fputs("0123456789", stdout);
+
+  return NULL;
+}
+
+void threads_test_stdio(void)
+{
+  static char buf[N_THREADS * N_WRITES * 10 * 2];
+  pthread_t threads[N_THREADS];
+  int len;
+  int n;
+  int i;
+
+  memset(buf, 0, sizeof(buf));
+  fflush(stdout);
+  setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+  for (n = 0; n < N_THREADS; n++)
+    {
+      if (pthread_create(&threads[n], NULL, threads_stdio_worker, NULL) != 0)
+        break;
+    }
+  for (i = 0; i < n; i++)
+    pthread_join(threads[i], NULL);
+
+  /* Before the buffer is flushed. The host libc might write some
+   * directly, but never parts of a write */
+  len = strlen(buf);
+  for (i = 0; i < len / 10; i++)
+    {
+      if (memcmp(buf + i * 10, "0123456789", 10) != 0)
+        break;
+    }
+  setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+  if (n == 0)
+    return;
+  putchar('\n');
+
+  if (len == 0 || len % 10 != 0 || i != len / 10)
+    FAIL("stdio from threads: %d bytes, write %d mixed up\n", len, i);
+  else
+    PASS("stdio from threads: %d writes buffered\n", i);
+}
+
+void threads_run(void)
+{
+  threads_test_counter();
+  threads_test_stdio();
+}
@@ -4,7 +4,7 @@
 ##
 ## Filename:	  profile.py
 ## Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
-## Description:   Parsing of a J2ME .prf file
+## Description:   Parsing of a J2ME .prf file or a Cibyl profile
 ##
 ## $Id:$
 ##
@@ -31,11 +31,14 @@ class Profile:
 		self.sortByCount = []
 		self.sortByCycles = []
 
-		for line in data.splitlines():
-			if not findRegexp.match(line):
-				continue
-			# Found a Cibyl method
-			self.addEntry(line)
+		if data.startswith("# cibyl-profile"):
+			self.parseCibylProfile(data)
+		else:
+			for line in data.splitlines():
+				if not findRegexp.match(line):
+					continue
+				# Found a Cibyl method
+				self.addEntry(line)
 		if self.entries == {}:
 			raise Exception("No Cibyl profile found")
 		self.sortByCount.sort()
@@ -43,7 +46,34 @@ class Profile:
 		self.sortByCycles.sort()
 		self.sortByCycles.reverse()
 
+	def parseCibylProfile(self, data):
+		"From config:profile=1, 'function NAME CALLS SAMPLES' per function"
+		functions = []
+		sampled = False
+		for line in data.splitlines():
+			entries = line.split()
+			if len(entries) != 4 or entries[0] != "function":
+				continue
+			functions.append(entries)
+			if int(entries[3]) > 0:
+				sampled = True
+		index = 0
+		for entries in functions:
+			# Samples take the place of cycles. Without profile_time
+			# they are all 0, so use the call counts then
+			if sampled:
+				cycles = entries[3]
+			else:
+				cycles = entries[2]
+			self.addEntries([index, -1, 0, entries[1], entries[2], cycles, 0])
+			index = index + 1
+
 	def addEntry(self, line):
+		entries = line.split()
+		entries[3] = functionNameRegexp.match(entries[3]).group(1)
+		self.addEntries(entries)
+
+	def addEntries(self, entries):
 		class SortByCount(Entry):
 			def __cmp__(self, other):
 				return cmp(self.count, other.count)
@@ -51,8 +81,6 @@ class Profile:
 			def __cmp__(self, other):
 				return cmp(self.cycles, other.cycles)
 
-		entries = line.split()
-		entries[3] = functionNameRegexp.match(entries[3]).group(1)
 		p = Entry(entries)
 		self.entries[p.name] = p
 		self.sortByCount.append(SortByCount(entries))
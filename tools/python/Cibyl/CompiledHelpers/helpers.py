@@ -11,6 +11,7 @@
 ######################################################################
 import os, sys, shutil
 import Cibyl.PeepholeOptimizer.parse
+import Cibyl.BinaryTranslation.profile
 
 from Cibyl import config
 
@@ -37,6 +38,23 @@ def doCopyJavaFiles():
     for f in files:
         shutil.copyfile(base_path + f, config.outDirectory + "/" + f)
 
+def doConvertProfile(filename):
+    "The translator reads Cibyl profiles, J2ME .prf files are converted"
+    f = open(filename)
+    data = f.read()
+    f.close()
+    if data.startswith("# cibyl-profile"):
+        return filename
+
+    profile = Cibyl.BinaryTranslation.profile.Profile(data)
+    out = config.outDirectory + "/cibyl-profile-prf.txt"
+    f = open(out, "w")
+    f.write("# cibyl-profile 1\n")
+    for e in profile.getEntriesSortedByCallCount():
+        f.write("function %s %d %d\n" % (e.name, e.count, e.cycles))
+    f.close()
+    return out
+
 def doTranslation(filename, syscallDirectories):
     dbs = ""
     defines = " "
@@ -48,6 +66,10 @@ def doTranslation(filename, syscallDirectories):
         conf = conf + "trace_end=0x%x," % (config.traceEnd)
     if config.memoryDebug:
         conf = conf + "trace_stores=1,"
+    if config.checkObjectHandles:
+        conf = conf + "check_object_handles=1,"
+    if config.cacheRodataStrings:
+        conf = conf + "cache_rodata_strings=1,"
     if config.doOptimizeIndirectCalls:
         conf = conf + "prune_call_table=1,"
     if config.doOptimizePruneStackStores:
@@ -67,9 +89,31 @@ def doTranslation(filename, syscallDirectories):
         conf = conf + "prune_unused_functions=1,"
     else:
         conf = conf + "prune_unused_functions=0,"
+    if not config.inlineSyscalls:
+        conf = conf + "inline_syscalls=0,"
+    if not config.callLiveness:
+        conf = conf + "optimize_call_liveness=0,"
+    if not config.constantMulDiv:
+        conf = conf + "optimize_constant_muldiv=0,"
+    if not config.baseIndex:
+        conf = conf + "optimize_base_index=0,"
+    if not config.loadForwarding:
+        conf = conf + "optimize_load_forwarding=0,"
+    if config.profile:
+        conf = conf + "profile=1,"
+    if config.profileLoops:
+        conf = conf + "profile_loops=1,"
+    if config.profileTime:
+        conf = conf + "profile_time=" + str(config.profileTime) + ","
+    if config.statsFile:
+        conf = conf + "stats=" + config.statsFile + ","
+    if config.profileFile:
+        conf = conf + "use_profile=" + doConvertProfile(config.profileFile) + ","
     conf = conf + "class_size_limit=" + str(config.classSizeLimit) + ","
     conf = conf + "call_table_hierarchy=" + str(config.callTableHierarchy) + ","
     conf = conf + "call_table_classes=" + str(config.callTableClasses) + ","
+    conf = conf + "java_profile=" + config.javaProfile + ","
+    conf = conf + "memory_model=" + config.memoryModel + ","
     if config.packageName != "":
         conf = conf + "package_name=" + config.packageName
 
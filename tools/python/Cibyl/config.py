@@ -16,6 +16,11 @@ import which
 verbose = False
 outDirectory = "."
 pruneUnusedFunctions = True
+inlineSyscalls = True
+callLiveness = True
+constantMulDiv = True
+baseIndex = True
+loadForwarding = True
 doConstantPropagation = False
 doMultOptimization = False
 doRegisterScheduling = False
@@ -42,6 +47,8 @@ onlyTranslate = False
 
 debug = False
 memoryDebug = False
+checkObjectHandles = False
+cacheRodataStrings = False
 tracing = False
 traceFunctions = None
 traceFunctionCalls = False
@@ -54,8 +61,14 @@ threadSafe = False
 
 infile = None
 profileFile = None
+profile = False
+profileLoops = False
+profileTime = 0
+statsFile = None
 
 packageName = ""
+javaProfile = "cldc1.0"
+memoryModel = "int"
 
 def getWtkPath():
     try:
@@ -13,6 +13,21 @@
 #include <basicblock.hh>
 #include <emit.hh>
 #include <config.hh>
+#include <profile.hh>
+
+/* Fewer lw/sw than this off the same base don't pay for the extra local */
+#define BASE_INDEX_MIN_ACCESSES 3
+
+/* Memory words with known contents, see forwardLoads() */
+#define MAX_KNOWN_WORDS 16
+
+struct known_word
+{
+  MIPS_register_t base;  /* R_ZERO for constant addresses */
+  Instruction *version;  /* The last write to base in the bb */
+  int32_t offset;        /* Or the address if it's constant */
+  MIPS_register_t value; /* The register holding the word */
+};
 
 BasicBlock::BasicBlock(Instruction **insns,
 		       bb_type_t type,
@@ -232,6 +247,277 @@ bool BasicBlock::pass1()
   return out;
 }
 
+void BasicBlock::optimizeMemoryAccesses()
+{
+  for (int i = 0; i < this->n_insns; i++)
+    this->instructions[i]->pairUnalignedAccess();
+
+  if (config->optimizeLoadForwarding)
+    this->forwardLoads();
+  if (config->optimizeBaseIndex)
+    this->shareBaseIndices();
+}
+
+/* Branch targets and jumptab labels can be reached from elsewhere */
+static bool hasLabel(Instruction *insn)
+{
+  return insn->isBranchTarget() || controller->hasJumptabLabel(insn->getAddress());
+}
+
+/*
+ * The address of a memory access as base register, the write which
+ * set it and offset. Bases set by lui are folded into the offset so
+ * that e.g. two accesses to the same global match.
+ */
+static void getMemoryKey(Instruction *insn, struct known_word *out)
+{
+  Instruction *w = insn->getPrevRegisterWrite(I_RS);
+
+  out->base = insn->getRs();
+  out->version = w;
+  out->offset = insn->getExtra();
+  out->value = R_ZERO;
+  if (out->base != R_ZERO && w && w->getOpcode() == OP_LUI)
+    {
+      out->base = R_ZERO;
+      out->offset = (int32_t)(((uint32_t)w->getExtra() << 16) + (uint32_t)insn->getExtra());
+    }
+  if (out->base == R_ZERO)
+    out->version = NULL;
+}
+
+static bool sameAddress(struct known_word *a, struct known_word *b)
+{
+  return a->base == b->base && a->version == b->version &&
+    a->offset == b->offset;
+}
+
+/*
+ * Remove the known words which a store of size bytes at key might
+ * overwrite. With the same base this is exact, otherwise anything
+ * might alias except stack slots and other memory in functions
+ * which don't let stack addresses escape.
+ */
+static int clobberKnownWords(struct known_word *known, int n,
+                             struct known_word *key, int size, bool separateStack)
+{
+  int out = 0;
+
+  for (int i = 0; i < n; i++)
+    {
+      struct known_word *k = &known[i];
+      bool alias = true;
+
+      if (k->base == key->base && k->version == key->version)
+        alias = key->offset < k->offset + 4 && k->offset < key->offset + size;
+      else if (separateStack && ((k->base == R_SP) != (key->base == R_SP)))
+        alias = false;
+
+      if (!alias)
+        known[out++] = *k;
+    }
+
+  return out;
+}
+
+/*
+ * Update the known memory words with what insn does, and forward
+ * them to a lw which reads one.
+ */
+int BasicBlock::updateKnownWords(Instruction *insn, struct known_word *known, int n,
+                                 bool separateStack)
+{
+  struct known_word key;
+  int dsts[N_REGS];
+  int out;
+
+  switch (insn->getOpcode())
+    {
+    case OP_LW:
+      getMemoryKey(insn, &key);
+      for (int i = 0; i < n && insn->getRt() != R_RA; i++)
+        {
+          if (sameAddress(&known[i], &key))
+            {
+              insn->setForwardedValue(known[i].value);
+              break;
+            }
+        }
+      break;
+    case OP_SW:
+      getMemoryKey(insn, &key);
+      n = clobberKnownWords(known, n, &key, 4, separateStack);
+      break;
+    case OP_SH:
+      getMemoryKey(insn, &key);
+      n = clobberKnownWords(known, n, &key, 2, separateStack);
+      break;
+    case OP_SB:
+      getMemoryKey(insn, &key);
+      n = clobberKnownWords(known, n, &key, 1, separateStack);
+      break;
+    case OP_SWL:
+    case OP_SWR:
+      /* Some of the bytes in the word around the address */
+      getMemoryKey(insn, &key);
+      key.offset -= 3;
+      n = clobberKnownWords(known, n, &key, 7, separateStack);
+      break;
+    default:
+      /* Calls, syscalls and other stores can write anything */
+      if (insn->isBranch() || insn->getOpcode() == OP_SWC1 ||
+          insn->getOpcode() == OP_SYSCALL || insn->getOpcode() == OP_BREAK ||
+          insn->getOpcode() >= CIBYL_SYSCALL)
+        n = 0;
+      break;
+    }
+
+  /* Forget words held in or addressed by registers written here */
+  memset(dsts, 0, sizeof(dsts));
+  insn->fillDestinations(dsts);
+  out = 0;
+  for (int i = 0; i < n; i++)
+    {
+      if (dsts[known[i].value] || (known[i].base != R_ZERO && dsts[known[i].base]))
+        continue;
+      known[out++] = known[i];
+    }
+  n = out;
+
+  /* ... and add the word accessed by this lw/sw. ra is not always kept */
+  if ( (insn->getOpcode() == OP_LW || insn->getOpcode() == OP_SW) &&
+       insn->getRt() != R_RA &&
+       !(insn->getOpcode() == OP_LW && key.base != R_ZERO && key.base == insn->getRt()) )
+    {
+      if (n == MAX_KNOWN_WORDS)
+        {
+          memmove(&known[0], &known[1], sizeof(struct known_word) * (n - 1));
+          n--;
+        }
+      key.value = insn->getRt();
+      known[n++] = key;
+    }
+
+  return n;
+}
+
+/*
+ * Store-to-load forwarding and redundant load elimination. Walks the
+ * basic block in execution order and replaces lw of words which are
+ * already in a register (stored or loaded before) with a move. Basic
+ * blocks are split before the branch targets are known, so these
+ * clear the known words.
+ */
+void BasicBlock::forwardLoads()
+{
+  JavaMethod *method = controller->getMethodByAddress(this->address);
+  Function *fn = method->getFunctionByAddress(this->address);
+  struct known_word known[MAX_KNOWN_WORDS];
+  bool separateStack;
+  int n = 0;
+
+  /* Pointers can only point to the stack frame if its address is taken */
+  separateStack = fn && !fn->takesStackAddress() && !fn->usesStackArguments();
+
+  for (int i = 0; i < this->n_insns; i++)
+    {
+      Instruction *insn = this->instructions[i];
+
+      /* Reachable from other places, so nothing is known */
+      if (insn->hasPrefix() || hasLabel(insn))
+        n = 0;
+      /* The delay slot is executed before the branch/call */
+      if (insn->hasDelayed())
+        n = this->updateKnownWords(insn->getDelayed(), known, n, separateStack);
+      n = this->updateKnownWords(insn, known, n, separateStack);
+    }
+}
+
+bool BasicBlock::isWordAccess(Instruction *insn)
+{
+  JavaMethod *method;
+
+  if (insn->getOpcode() != OP_LW && insn->getOpcode() != OP_SW)
+    return false;
+  if (insn->hasForwardedValue())
+    return false;
+
+  /* ra loads and stores are skipped in single-function methods */
+  method = controller->getMethodByAddress(insn->getAddress());
+  if (insn->getRt() == R_RA && !method->hasMultipleFunctions())
+    return false;
+
+  return true;
+}
+
+/* Same base register, not modified in between and the same alignment */
+bool BasicBlock::sharesBaseIndex(Instruction *leader, Instruction *insn)
+{
+  return this->isWordAccess(insn) &&
+    insn->getRs() == leader->getRs() &&
+    insn->getPrevRegisterWrite(I_RS) == leader->getPrevRegisterWrite(I_RS) &&
+    ((insn->getExtra() - leader->getExtra()) & 3) == 0;
+}
+
+/*
+ * Find lw/sw with the same base register, which is not modified
+ * between them. The first computes the word index and the rest add a
+ * constant to it. Word accesses are aligned, so this works whenever
+ * the offsets differ by a multiple of 4 (which they do for struct
+ * fields). Branch targets and jumptab labels can be reached without
+ * passing the first, so the search stops there. All groups share
+ * R_BIX, so a group can only start after the last access of the
+ * previous one.
+ */
+void BasicBlock::shareBaseIndices()
+{
+  bool *done = (bool*)xcalloc(this->n_insns, sizeof(bool));
+  int groupEnd = -1;
+
+  for (int i = 0; i < this->n_insns; i++)
+    {
+      Instruction *leader = this->instructions[i];
+      int last = i;
+      int n = 1;
+
+      if (done[i] || i < groupEnd || !this->isWordAccess(leader))
+        continue;
+
+      for (int j = i + 1; j < this->n_insns; j++)
+        {
+          Instruction *insn = this->instructions[j];
+
+          if (hasLabel(insn))
+            break;
+          if (!done[j] && this->sharesBaseIndex(leader, insn))
+            {
+              last = j;
+              n++;
+            }
+        }
+      if (n < BASE_INDEX_MIN_ACCESSES)
+        continue;
+      groupEnd = last;
+
+      /* Same search again, now setting up the group */
+      leader->setBaseIndexLeader(leader);
+      for (int j = i + 1; j < this->n_insns; j++)
+        {
+          Instruction *insn = this->instructions[j];
+
+          if (hasLabel(insn))
+            break;
+          if (!done[j] && this->sharesBaseIndex(leader, insn))
+            {
+              insn->setBaseIndexLeader(leader);
+              done[j] = true;
+            }
+        }
+    }
+
+  free(done);
+}
+
 static void pushRegister(MIPS_register_t reg)
 {
   if (reg != R_RA)
@@ -321,7 +607,14 @@ bool BasicBlock::pass2()
       /* FIXME: Emit .line info if debug is on */
       if ( (insn->isBranchTarget() || controller->hasJumptabLabel(insn->getAddress())) &&
            !insn->isDelaySlotNop() )
-	emit->bc_label( insn->getAddress() );
+        {
+          ProfileGenerator *profile = controller->getProfile();
+
+          emit->bc_label( insn->getAddress() );
+          /* Count the iterations of loops */
+          if (profile && profile->lookupLoop(insn->getAddress()) >= 0)
+            profile->emitLoopHeader(profile->lookupLoop(insn->getAddress()));
+        }
 
       if (!insn->isNop())
 	this->commentInstruction(insn);
@@ -15,6 +15,7 @@
 #include "builtins/exceptions.cc"
 #include "builtins/softfloat.cc"
 #include "builtins/64-bit-muldiv.cc"
+#include "builtins/libm.cc"
 
 Instruction *tryInstruction;
 
@@ -22,6 +23,37 @@ Builtin::~Builtin()
 {
 }
 
+void Builtin::push_64_bit_from_32_bit_regs(MIPS_register_t r1, MIPS_register_t r2,
+                                           bool flip_sign)
+{
+  emit->bc_pushregister(r1);
+  emit->bc_i2l();
+  emit->bc_pushconst_l(0xFFFFFFFF); /* Don't sign-extend the low word */
+  emit->bc_land();
+  emit->bc_pushregister(r2);
+  if (flip_sign)
+    {
+      emit->bc_pushconst((int32_t)0x80000000);
+      emit->bc_ixor();
+    }
+  emit->bc_i2l();
+  emit->bc_pushconst(32);
+  emit->bc_lshl();
+  emit->bc_lor();
+}
+
+void Builtin::pop_64_bit_to_32_bit_regs(MIPS_register_t r1, MIPS_register_t r2)
+{
+  emit->bc_dup2();
+  emit->bc_pushconst(32);
+  emit->bc_lushr();
+  emit->bc_l2i();
+  emit->bc_popregister(r2);
+
+  emit->bc_l2i();
+  emit->bc_popregister(r1);
+}
+
 BuiltinFactory::BuiltinFactory()
 {
 }
@@ -31,6 +63,66 @@ static bool cmp(const char *name, const char *key)
   return (strncmp(name, key, strlen(key)) == 0);
 }
 
+/* Match the entire C name, i.e., "sin" should match sin_80001234 but
+ * not sinf_80001234 */
+static bool cmp_function(const char *name, const char *key)
+{
+  size_t len = strlen(key);
+  char *endp;
+
+  if (strncmp(name, key, len) != 0 || name[len] != '_')
+    return false;
+  strtoul(name + len + 1, &endp, 16);
+
+  return endp != name + len + 1 && *endp == '\0';
+}
+
+/* libm functions which can be handled directly by Java */
+static struct
+{
+  const char *name;
+  const char *javaClass;
+  const char *javaMethod;
+  int n_args;
+  bool is_double;
+  java_profile_t profile; /* The lowest profile providing it */
+} math_builtins[] =
+{
+  { "sqrt",   "java/lang/Math", "sqrt",  1, true,  CLDC_1_1 },
+  { "sin",    "java/lang/Math", "sin",   1, true,  CLDC_1_1 },
+  { "cos",    "java/lang/Math", "cos",   1, true,  CLDC_1_1 },
+  { "tan",    "java/lang/Math", "tan",   1, true,  CLDC_1_1 },
+  { "floor",  "java/lang/Math", "floor", 1, true,  CLDC_1_1 },
+  { "ceil",   "java/lang/Math", "ceil",  1, true,  CLDC_1_1 },
+  { "fabs",   "java/lang/Math", "abs",   1, true,  CLDC_1_1 },
+  { "sqrtf",  "java/lang/Math", "sqrt",  1, false, CLDC_1_1 },
+  { "sinf",   "java/lang/Math", "sin",   1, false, CLDC_1_1 },
+  { "cosf",   "java/lang/Math", "cos",   1, false, CLDC_1_1 },
+  { "tanf",   "java/lang/Math", "tan",   1, false, CLDC_1_1 },
+  { "floorf", "java/lang/Math", "floor", 1, false, CLDC_1_1 },
+  { "ceilf",  "java/lang/Math", "ceil",  1, false, CLDC_1_1 },
+  { "fabsf",  "java/lang/Math", "abs",   1, false, CLDC_1_1 },
+
+  /* Not in CLDC 1.1, so these go to mMath (from the softfloat syscalls) */
+  { "atan",   "mMath",          "atan",  1, true,  CLDC_1_1 },
+  { "asin",   "mMath",          "asin",  1, true,  CLDC_1_1 },
+  { "acos",   "mMath",          "acos",  1, true,  CLDC_1_1 },
+  { "atan2",  "mMath",          "atan2", 2, true,  CLDC_1_1 },
+  { "atanf",  "mMath",          "atan",  1, false, CLDC_1_1 },
+  { "asinf",  "mMath",          "asin",  1, false, CLDC_1_1 },
+  { "acosf",  "mMath",          "acos",  1, false, CLDC_1_1 },
+  { "atan2f", "mMath",          "atan2", 2, false, CLDC_1_1 },
+
+  { "log",    "java/lang/Math", "log",   1, true,  J2SE },
+  { "log10",  "java/lang/Math", "log10", 1, true,  J2SE },
+  { "exp",    "java/lang/Math", "exp",   1, true,  J2SE },
+  { "pow",    "java/lang/Math", "pow",   2, true,  J2SE },
+  { "logf",   "java/lang/Math", "log",   1, false, J2SE },
+  { "log10f", "java/lang/Math", "log10", 1, false, J2SE },
+  { "expf",   "java/lang/Math", "exp",   1, false, J2SE },
+  { "powf",   "java/lang/Math", "pow",   2, false, J2SE },
+};
+
 Builtin* BuiltinFactory::match(Instruction *insn, const char *name)
 {
   /* Only look at the first part of the name */
@@ -40,6 +132,8 @@ Builtin* BuiltinFactory::match(Instruction *insn, const char *name)
     return new ThrowBuiltin();
   else if (cmp(name, "__NOPH_setjmp"))
     return new SetjmpBuiltin(name);
+  else if (cmp(name, "__NOPH_longjmp"))
+    return new LongjmpBuiltin();
 
   /* Soft float optimization, the conversion can always be done */
   else if (cmp(name, "__floatsisf"))
@@ -49,16 +143,41 @@ Builtin* BuiltinFactory::match(Instruction *insn, const char *name)
   else if (cmp(name, "__fixsfdi"))
     return new FloatToInt(name);
 
-  /* 64-bit division */
+  /* 64-bit arithmetic */
   else if (cmp(name, "__divdi3"))
     return new DivBuiltin(name);
   else if (cmp(name, "__moddi3"))
     return new ModBuiltin(name);
+  else if (cmp(name, "__udivdi3"))
+    return new UdivBuiltin(name);
+  else if (cmp(name, "__umoddi3"))
+    return new UmodBuiltin(name);
+  else if (cmp(name, "__muldi3"))
+    return new MulBuiltin(name);
+  else if (cmp(name, "__negdi2"))
+    return new NegBuiltin(name);
+  else if (cmp(name, "__cmpdi2"))
+    return new CmpBuiltin(name, false);
+  else if (cmp(name, "__ucmpdi2"))
+    return new CmpBuiltin(name, true);
   else if (cmp(name, "__ashrdi3"))
     return new ShrBuiltin(name);
+  else if (cmp(name, "__lshrdi3"))
+    return new LshrBuiltin(name);
   else if (cmp(name, "__ashldi3"))
     return new ShlBuiltin(name);
 
+  /* libm, the C implementation is kept for CLDC 1.0 */
+  for (unsigned int i = 0; i < sizeof(math_builtins) / sizeof(math_builtins[0]); i++)
+    {
+      if (config->javaProfile >= math_builtins[i].profile &&
+          cmp_function(name, math_builtins[i].name))
+        return new MathBuiltin(name, math_builtins[i].javaClass,
+                               math_builtins[i].javaMethod,
+                               math_builtins[i].n_args,
+                               math_builtins[i].is_double);
+    }
+
   if (config->optimizeInlines)
     {
       JavaMethod *mt = controller->getMethodByAddress(insn->getAddress());
@@ -50,30 +50,12 @@ public:
     emit->bc_generic_insn(this->bc);
 
     /* Split the result to V0/V1 */
-    emit->bc_dup2();
-    emit->bc_pushconst(32);
-    emit->bc_lushr();
-    emit->bc_l2i();
-    emit->bc_popregister(R_V0);
+    this->pop_64_bit_to_32_bit_regs(R_V1, R_V0);
 
-    emit->bc_l2i();
-    emit->bc_popregister(R_V1);
-    
     return true;
   }
   
 protected:
-  void push_64_bit_from_32_bit_regs(MIPS_register_t r1, MIPS_register_t r2)
-  {
-    emit->bc_pushregister(r1);
-    emit->bc_i2l();
-    emit->bc_pushregister(r2);
-    emit->bc_i2l();
-    emit->bc_pushconst(32);
-    emit->bc_lshl();
-    emit->bc_lor();
-  }
-  
   const char *bc;
 };
 
@@ -93,6 +75,128 @@ public:
   }  
 };
 
+class MulBuiltin : public MulDivBuiltinBase
+{
+public:
+  MulBuiltin(const char *name) : MulDivBuiltinBase(name, "lmul")
+  {
+  }
+};
+
+/* Unsigned division and modulo. Java has no unsigned long division,
+ * but when both operands have the top bit clear the signed ldiv/lrem
+ * gives the same result. Only fall back to the (slower) fixup in
+ * CRunTime when one of the operands is "negative" */
+class UnsignedDivBuiltinBase : public MulDivBuiltinBase
+{
+public:
+  UnsignedDivBuiltinBase(const char *name, const char *bc, const char *fixup) : MulDivBuiltinBase(name, bc)
+  {
+    this->fixup = fixup;
+  }
+
+  bool pass2(Instruction *insn)
+  {
+    uint32_t addr = insn->getAddress();
+
+    /* Both high words positive? */
+    emit->bc_pushregister(R_A0);
+    emit->bc_pushregister(R_A2);
+    emit->bc_ior();
+    emit->bc_condbranch("iflt L_%x_%s_fixup", addr, this->fixup);
+
+    this->push_64_bit_from_32_bit_regs(R_A1, R_A0);
+    this->push_64_bit_from_32_bit_regs(R_A3, R_A2);
+    emit->bc_generic_insn(this->bc);
+    emit->bc_goto("L_%x_%s_done", addr, this->fixup);
+
+    /* Top bit set in either of the operands */
+    emit->bc_label("L_%x_%s_fixup", addr, this->fixup);
+    this->push_64_bit_from_32_bit_regs(R_A1, R_A0);
+    this->push_64_bit_from_32_bit_regs(R_A3, R_A2);
+    emit->bc_invokestatic("%sCRunTime/%s(JJ)J",
+        controller->getJasminPackagePath(), this->fixup);
+
+    emit->bc_label("L_%x_%s_done", addr, this->fixup);
+    this->pop_64_bit_to_32_bit_regs(R_V1, R_V0);
+
+    return true;
+  }
+
+protected:
+  const char *fixup;
+};
+
+class UdivBuiltin : public UnsignedDivBuiltinBase
+{
+public:
+  UdivBuiltin(const char *name) : UnsignedDivBuiltinBase(name, "ldiv", "udivdi3")
+  {
+  }
+};
+
+class UmodBuiltin : public UnsignedDivBuiltinBase
+{
+public:
+  UmodBuiltin(const char *name) : UnsignedDivBuiltinBase(name, "lrem", "umoddi3")
+  {
+  }
+};
+
+/* __cmpdi2 and __ucmpdi2 return 0, 1 or 2 for less, equal and greater */
+class CmpBuiltin : public MulDivBuiltinBase
+{
+public:
+  CmpBuiltin(const char *name, bool is_unsigned) : MulDivBuiltinBase(name, "lcmp")
+  {
+    this->is_unsigned = is_unsigned;
+  }
+
+  int fillDestinations(int *p)
+  {
+    return this->addToRegisterUsage(R_V0, p);
+  };
+
+  bool pass2(Instruction *insn)
+  {
+    /* Unsigned comparison is signed comparison with the top bit inverted */
+    this->push_64_bit_from_32_bit_regs(R_A1, R_A0, this->is_unsigned);
+    this->push_64_bit_from_32_bit_regs(R_A3, R_A2, this->is_unsigned);
+
+    emit->bc_lcmp(); /* -1, 0 or 1 */
+    emit->bc_pushconst(1);
+    emit->bc_iadd();
+    emit->bc_popregister(R_V0);
+
+    return true;
+  }
+
+private:
+  bool is_unsigned;
+};
+
+class NegBuiltin : public MulDivBuiltinBase
+{
+public:
+  NegBuiltin(const char *name) : MulDivBuiltinBase(name, "lneg")
+  {
+  }
+
+  int fillSources(int *p)
+  {
+    return this->addToRegisterUsage(R_A0, p) + this->addToRegisterUsage(R_A1, p);
+  };
+
+  bool pass2(Instruction *insn)
+  {
+    this->push_64_bit_from_32_bit_regs(R_A1, R_A0);
+    emit->bc_generic_insn(this->bc);
+    this->pop_64_bit_to_32_bit_regs(R_V1, R_V0);
+
+    return true;
+  }
+};
+
 class ShiftBuiltinBase : public MulDivBuiltinBase
 {
 public:
@@ -100,6 +204,12 @@ public:
   {
   }  
 
+  int fillSources(int *p)
+  {
+    return this->addToRegisterUsage(R_A0, p) + this->addToRegisterUsage(R_A1, p) +
+      this->addToRegisterUsage(R_A2, p);
+  };
+
   bool pass2(Instruction *insn)
   {
     /* Concatenate the first and second parameters */
@@ -110,15 +220,8 @@ public:
     emit->bc_generic_insn(this->bc);
 
     /* Split the result to V0/V1 */
-    emit->bc_dup2();
-    emit->bc_pushconst(32);
-    emit->bc_lushr();
-    emit->bc_l2i();
-    emit->bc_popregister(R_V0);
+    this->pop_64_bit_to_32_bit_regs(R_V1, R_V0);
 
-    emit->bc_l2i();
-    emit->bc_popregister(R_V1);
-    
     return true;
   }
 };
@@ -131,6 +234,14 @@ public:
   }  
 };
 
+class LshrBuiltin : public ShiftBuiltinBase
+{
+public:
+  LshrBuiltin(const char *name) : ShiftBuiltinBase(name, "lushr")
+  {
+  }
+};
+
 class ShlBuiltin : public ShiftBuiltinBase
 {
 public:
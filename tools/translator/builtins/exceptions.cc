@@ -14,6 +14,9 @@
 #include <builtins.hh>
 #include <emit.hh>
 #include <controller.hh>
+#include <map>
+
+using namespace std;
 
 class ExceptionBuiltinBase : public Builtin
 {
@@ -64,53 +67,108 @@ public:
   }
 };
 
+static int uint32_cmp(const void *_a, const void *_b)
+{
+  uint32_t a = *(uint32_t*)_a;
+  uint32_t b = *(uint32_t*)_b;
+
+  if (a < b)
+    return -1;
+  return a > b;
+}
+
+/*
+ * One handler per method for all its setjmp points. The cookie points
+ * to the address of the setjmp, which selects where to continue.
+ */
 class SetjmpExceptionHandler : public ExceptionHandler
 {
 public:
-  SetjmpExceptionHandler(JavaMethod *mt, uint32_t target) : 
+  SetjmpExceptionHandler(JavaMethod *mt) :
     ExceptionHandler(mt->getAddress(), mt->getAddress() + mt->getSize())
   {
     this->mt = mt;
-    this->target = target;
+    this->n_targets = 0;
+    this->targets = NULL;
+    this->rangeStart = mt->getAddress() + mt->getSize();
+    this->added = false;
+  }
+
+  void addTarget(uint32_t target, uint32_t start)
+  {
+    this->n_targets++;
+    this->targets = (uint32_t*)xrealloc(this->targets,
+                                        this->n_targets * sizeof(uint32_t));
+    this->targets[this->n_targets - 1] = target;
+    if (start < this->rangeStart)
+      this->rangeStart = start;
+  }
+
+  /* Catch the SetjmpException from the first code which can execute after the setjmp */
+  void emitCatch()
+  {
+    if (this->added)
+      return;
+    this->added = true;
+
+    this->mt->addExceptionHandler(this);
+    if (this->rangeStart == this->mt->getAddress())
+      emit->generic(".catch %sSetjmpException from __CIBYL_javamethod_begin to __CIBYL_exception_handlers using %s\n",
+                    controller->getJasminPackagePath(), this->name);
+    else
+      emit->generic(".catch %sSetjmpException from L_%x to __CIBYL_exception_handlers using %s\n",
+                    controller->getJasminPackagePath(), this->rangeStart, this->name);
   }
 
   bool pass2()
   {
     emit->bc_label("%s", this->name);
 
-    /* Copy the exception object ref to get the cookie and value (
-     * and prepare for throwing) */
+    /* Put value in V0, keep the exception for throwing it again */
     emit->bc_dup();
-
-    /* Push the cookie and the argument (passed to the __NOPH_setjmp
-     * function) - if these are equal, this was for us - otherwise
-     * just rethrow it */
-    emit->bc_invokevirtual("%sSetjmpException/getCookie()I",
-        controller->getJasminPackagePath());
-    emit->bc_pushconst(2);
-    emit->bc_ishr();
-    emit->bc_pushregister(R_MEM);
-    emit->bc_swap();
-    emit->bc_iaload(); /* load *cookie */
-    emit->bc_pushconst( this->target );
-    emit->bc_if_icmpne("L_setjmp_handler_%s_not_this", this->name);
-
-    /* Put value in V0 */
     emit->bc_invokevirtual("%sSetjmpException/getValue()I",
         controller->getJasminPackagePath());
     emit->bc_popregister(R_V0);
-    
-    emit->bc_goto( this->target );
+
+    /* Load *cookie, i.e., the address of the setjmp */
+    emit->bc_dup();
+    emit->bc_invokevirtual("%sSetjmpException/getCookie()I",
+        controller->getJasminPackagePath());
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      emit->bc_invokestatic("%sCRunTime/memoryReadWord(I)I",
+          controller->getJasminPackagePath());
+    else
+      {
+        emit->bc_pushconst(2);
+        emit->bc_ishr();
+        emit->bc_pushregister(R_MEM);
+        emit->bc_swap();
+        emit->bc_iaload(); /* load *cookie */
+      }
+
+    /* The exception is still on the stack, drop it before the jump */
+    qsort(this->targets, this->n_targets, sizeof(uint32_t), uint32_cmp);
+    emit->bc_lookupswitch(this->n_targets, this->targets,
+                          "L_setjmp_handler_not_this", "L_setjmp_handler_");
+    for (int i = 0; i < this->n_targets; i++)
+      {
+        emit->bc_label("L_setjmp_handler_%x", this->targets[i]);
+        emit->bc_pop();
+        emit->bc_goto(this->targets[i]);
+      }
 
     /* Wrong one - throw it */
-    emit->bc_label("L_setjmp_handler_%s_not_this", this->name);
+    emit->bc_label("L_setjmp_handler_not_this");
     emit->bc_athrow(); /* And throw the other again */
 
     return true;
   }
 protected:
   JavaMethod *mt;
-  uint32_t target;
+  int n_targets;
+  uint32_t *targets;
+  uint32_t rangeStart;
+  bool added;
 };
 
 class SetjmpBuiltin : public Builtin
@@ -120,29 +178,124 @@ public:
   {
   }
 
+  /* Register the setjmp point with the handler of the method */
   bool pass1(Instruction *insn)
   {
+    uint32_t target = insn->getAddress();
+    JavaMethod *mt = controller->getMethodByAddress( target );
+    SetjmpExceptionHandler *handler;
+    SetjmpHandlerTable_t::iterator it = handlers.find(mt);
+
+    if (it == handlers.end())
+      {
+        handler = new SetjmpExceptionHandler(mt);
+        handlers[mt] = handler;
+      }
+    else
+      handler = it->second;
+
+    handler->addTarget(target, this->lookupRangeStart(mt, target));
+
     return true;
   }
 
-  /* Register this function as a setjmp one */
   /* In this class: Add a label */
   bool pass2(Instruction *insn)
   {
     uint32_t target = insn->getAddress();
-
     JavaMethod *mt = controller->getMethodByAddress( target );
-    const char *handler = mt->addExceptionHandler(new SetjmpExceptionHandler(mt,
-        target) );
-    
-    /* Catch the SetjmpException in the entire method */
-    emit->generic(".catch %sSetjmpException from __CIBYL_javamethod_begin to __CIBYL_exception_handlers using %s\n",
-        controller->getJasminPackagePath(),
-        handler);
+
+    handlers[mt]->emitCatch();
     emit->bc_pushconst(0);
     emit->bc_popregister(R_V0);
     emit->bc_label( target );
-    
+
+    return true;
+  }
+
+private:
+  /*
+   * Return the lowest address which can execute after the setjmp,
+   * i.e., the setjmp itself unless a backward branch goes before it.
+   * Local calls in multi-function methods can come from anywhere.
+   */
+  uint32_t lookupRangeStart(JavaMethod *mt, uint32_t target)
+  {
+    Function *fn = mt->getFunctionByAddress(target);
+    uint32_t out = target;
+    bool changed;
+
+    if (mt->hasMultipleFunctions() || !fn || fn->hasRegisterIndirectJumps())
+      return mt->getAddress();
+
+    do
+      {
+        changed = false;
+        for (uint32_t addr = out; addr < fn->getAddress() + fn->getSize(); addr += 4)
+          {
+            Instruction *insn = controller->getInstructionByAddress(addr);
+            uint32_t dst;
+
+            if (!insn || !insn->isBranch())
+              continue;
+            switch (insn->getOpcode())
+              {
+              case OP_BEQ:
+              case OP_BNE:
+              case OP_BLEZ:
+              case OP_BGTZ:
+              case OP_BLTZ:
+              case OP_BGEZ:
+                dst = addr + 4 + (insn->getExtra() << 2);
+                break;
+              case OP_J:
+                dst = insn->getExtra() << 2;
+                break;
+              default:
+                continue;
+              }
+            if (dst < out && dst >= fn->getAddress())
+              {
+                out = dst;
+                changed = true;
+              }
+          }
+      } while (changed);
+
+    return out;
+  }
+
+  typedef map<JavaMethod*, SetjmpExceptionHandler*> SetjmpHandlerTable_t;
+  static SetjmpHandlerTable_t handlers;
+};
+
+SetjmpBuiltin::SetjmpHandlerTable_t SetjmpBuiltin::handlers;
+
+/* longjmp: Throw the (preallocated) SetjmpException */
+class LongjmpBuiltin : public Builtin
+{
+public:
+  LongjmpBuiltin() : Builtin("__NOPH_longjmp")
+  {
+  }
+
+  int fillSources(int *p)
+  {
+    return this->addToRegisterUsage(R_A0, p) + this->addToRegisterUsage(R_A1, p);
+  };
+
+  bool pass1(Instruction *insn)
+  {
+    return true;
+  }
+
+  bool pass2(Instruction *insn)
+  {
+    emit->bc_pushregister(R_A0);
+    emit->bc_pushregister(R_A1);
+    emit->bc_invokestatic("%sSetjmpException/get(II)L%sSetjmpException;",
+        controller->getJasminPackagePath(), controller->getJasminPackagePath());
+    emit->bc_athrow();
     return true;
   }
 };
@@ -161,10 +314,19 @@ public:
 
   bool pass2(Instruction *insn)
   {
-    emit->bc_getstatic("%sCRunTime/objectRepository [Ljava/lang/Object;",
-        controller->getJasminPackagePath());
-    emit->bc_pushregister(R_A0);
-    emit->bc_aaload();
+    if (config->checkObjectHandles)
+      {
+        emit->bc_pushregister(R_A0);
+        emit->bc_invokestatic("%sCRunTime/getRegisteredObject(I)Ljava/lang/Object;",
+            controller->getJasminPackagePath());
+      }
+    else
+      {
+        emit->bc_getstatic("%sCRunTime/objectRepository [Ljava/lang/Object;",
+            controller->getJasminPackagePath());
+        emit->bc_pushregister(R_A0);
+        emit->bc_aaload();
+      }
     emit->bc_checkcast("java/lang/Throwable");
     emit->bc_athrow(); /* Throw! */
     return true;
@@ -0,0 +1,116 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      libm.cc
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   libm builtins (calls to java.lang.Math)
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#include <javamethod.hh>
+#include <controller.hh>
+#include <builtins.hh>
+#include <emit.hh>
+
+/*
+ * Replaces calls to sin, sqrt, atan2 etc with a direct call to the
+ * Java method. Floats are passed in a0/a1 and returned in v0, doubles
+ * are passed in a0:a1/a2:a3 and returned in v0:v1 (high word first)
+ */
+class MathBuiltin : public Builtin
+{
+public:
+  MathBuiltin(const char *name, const char *javaClass, const char *javaMethod,
+              int n_args, bool is_double) : Builtin(name)
+  {
+    this->javaClass = javaClass;
+    this->javaMethod = javaMethod;
+    this->n_args = n_args;
+    this->is_double = is_double;
+  }
+
+  bool pass1(Instruction *insn)
+  {
+    return true;
+  }
+
+  bool pass2(Instruction *insn)
+  {
+    if (this->is_double)
+      {
+        this->push_64_bit_from_32_bit_regs(R_A1, R_A0);
+        emit->bc_invokestatic("java/lang/Double/longBitsToDouble(J)D");
+        if (this->n_args == 2)
+          {
+            this->push_64_bit_from_32_bit_regs(R_A3, R_A2);
+            emit->bc_invokestatic("java/lang/Double/longBitsToDouble(J)D");
+          }
+      }
+    else
+      {
+        emit->bc_pushregister(R_A0);
+        emit->bc_invokestatic("java/lang/Float/intBitsToFloat(I)F");
+        emit->bc_generic_insn("f2d");
+        if (this->n_args == 2)
+          {
+            emit->bc_pushregister(R_A1);
+            emit->bc_invokestatic("java/lang/Float/intBitsToFloat(I)F");
+            emit->bc_generic_insn("f2d");
+          }
+      }
+
+    /* The actual operation. mMath is generated into our own package */
+    emit->bc_invokestatic("%s%s/%s(%s)D",
+                          strcmp(this->javaClass, "mMath") == 0 ?
+                          controller->getJasminPackagePath() : "",
+                          this->javaClass, this->javaMethod,
+                          this->n_args == 2 ? "DD" : "D");
+
+    /* Pop the result to v0 (and v1) */
+    if (this->is_double)
+      {
+        emit->bc_invokestatic("java/lang/Double/doubleToLongBits(D)J");
+        this->pop_64_bit_to_32_bit_regs(R_V1, R_V0);
+      }
+    else
+      {
+        emit->bc_generic_insn("d2f");
+        emit->bc_invokestatic("java/lang/Float/floatToIntBits(F)I");
+        emit->bc_popregister(R_V0);
+      }
+
+    return true;
+  }
+
+  int fillSources(int *p)
+  {
+    int out = this->addToRegisterUsage(R_A0, p);
+
+    if (this->is_double)
+      out += this->addToRegisterUsage(R_A1, p);
+    if (this->n_args == 2 && this->is_double)
+      out += this->addToRegisterUsage(R_A2, p) + this->addToRegisterUsage(R_A3, p);
+    else if (this->n_args == 2)
+      out += this->addToRegisterUsage(R_A1, p);
+
+    return out;
+  };
+
+  int fillDestinations(int *p)
+  {
+    int out = this->addToRegisterUsage(R_V0, p);
+
+    if (this->is_double)
+      out += this->addToRegisterUsage(R_V1, p);
+
+    return out;
+  };
+
+private:
+  const char *javaClass;
+  const char *javaMethod;
+  int n_args;
+  bool is_double;
+};
@@ -25,6 +25,9 @@ CallTableMethod::CallTableMethod(int maxFunctions, cibyl_exported_symbol_t *exp_
   this->exp_syms = exp_syms;
   this->n_exp_syms = n_exp_syms;
 
+  this->n_callbacks = 0;
+  this->callbacks = NULL;
+
   memset(this->registerUsage, 0, sizeof(this->registerUsage));
 }
 
@@ -57,6 +60,20 @@ void CallTableMethod::addFunction(Function *fn)
   this->n_functions++;
 }
 
+void CallTableMethod::addCallback(uint32_t addr)
+{
+  for (int i = 0; i < this->n_callbacks; i++)
+    {
+      if (this->callbacks[i] == addr)
+        return;
+    }
+
+  this->n_callbacks++;
+  this->callbacks = (uint32_t*)xrealloc(this->callbacks,
+                                        this->n_callbacks * sizeof(uint32_t));
+  this->callbacks[this->n_callbacks - 1] = addr;
+}
+
 bool CallTableMethod::pass1()
 {
   this->registerUsage[ R_SP ] = 1;
@@ -73,6 +90,59 @@ bool CallTableMethod::pass1()
   return true;
 }
 
+void CallTableMethod::generateCall(Function *fn)
+{
+  JavaMethod *mt = controller->getMethodByAddress(fn->getAddress());
+  JavaClass *cl;
+  const char *comma = "";
+
+  panic_if(!mt, "No method for function %s!\n", fn->getName());
+  cl = controller->getClassByMethodName(mt->getName());
+
+  panic_if(!cl, "Method %s has no class mapping!\n",
+           mt->getName());
+
+  if (config->threadSafe)
+    {
+      if (mt->returnSize() == 2)
+        emit->generic("ret = ");
+      else if (mt->returnSize() == 1) /* Only one */
+        emit->generic("ret = (int)");
+      /* else nothing */
+    }
+  else if (mt->returnSize() >= 1)
+    emit->generic("ret = ");
+  emit->generic("%s.%s(", cl->getName(), mt->getName());
+
+  /* Pass registers */
+  void *it;
+  for (MIPS_register_t reg = mt->getFirstRegisterToPass(&it);
+      reg != R_ZERO;
+      reg = mt->getNextRegisterToPass(&it))
+    {
+      if (reg == R_SP)
+        { emit->generic("sp"); comma = ","; }
+      if (reg == R_FNA)
+        {
+          int idx = mt->getFunctionIndexByAddress(fn->getAddress());
+
+          panic_if(idx < 0, "Could not find function index for function %s in method %s",
+              fn->getName(), mt->getName());
+          emit->generic("%s %d", comma, idx);
+          comma = ",";
+        }
+      if (reg == R_A0)
+        { emit->generic("%s a0", comma); comma = ","; }
+      if (reg == R_A1)
+        { emit->generic("%s a1", comma); comma = ","; }
+      if (reg == R_A2)
+        { emit->generic("%s a2", comma); comma = ","; }
+      if (reg == R_A3)
+        { emit->generic("%s a3", comma); comma = ","; }
+    }
+  emit->generic("); break;\n");
+}
+
 void CallTableMethod::generateMethod(const char *name,
                                      int start, int end)
 {
@@ -86,56 +156,8 @@ void CallTableMethod::generateMethod(const char *name,
   /* For each method, output a call to it */
   for (int i = start; i < end; i++)
     {
-      Function *fn = this->functions[i];
-      JavaMethod *mt = controller->getMethodByAddress(fn->getAddress());
-      JavaClass *cl;
-      const char *comma = "";
-
-      panic_if(!mt, "this->methods[%d] is NULL!\n", i);
-      cl = controller->getClassByMethodName(mt->getName());
-
-      panic_if(!cl, "Method %s has no class mapping!\n",
-               mt->getName());
-
-      emit->generic("      case 0x%x:  ", fn->getAddress());
-      if (config->threadSafe)
-        {
-          if (mt->returnSize() == 2)
-            emit->generic("ret = ");
-          else if (mt->returnSize() == 1) /* Only one */
-            emit->generic("ret = (int)");
-          /* else nothing */
-        }
-      else if (mt->returnSize() >= 1)
-        emit->generic("ret = ");
-      emit->generic("%s.%s(", cl->getName(), mt->getName());
-
-      /* Pass registers */
-      void *it;
-      for (MIPS_register_t reg = mt->getFirstRegisterToPass(&it);
-          reg != R_ZERO;
-          reg = mt->getNextRegisterToPass(&it))
-        {
-          if (reg == R_SP)
-            { emit->generic("sp"); comma = ","; }
-          if (reg == R_FNA)
-            {
-              int idx = mt->getFunctionIndexByAddress(fn->getAddress());
-
-              panic_if(idx < 0, "Could not find function index for function %s in method %s",
-                  fn->getName(), mt->getName());
-              emit->generic("%s %d", comma, idx);
-            }
-          if (reg == R_A0)
-            { emit->generic("%s a0", comma); comma = ","; }
-          if (reg == R_A1)
-            { emit->generic("%s a1", comma); comma = ","; }
-          if (reg == R_A2)
-            { emit->generic("%s a2", comma); comma = ","; }
-          if (reg == R_A3)
-            { emit->generic("%s a3", comma); comma = ","; }
-        }
-      emit->generic("); break;\n");
+      emit->generic("      case 0x%x:  ", this->functions[i]->getAddress());
+      this->generateCall(this->functions[i]);
     }
 
   emit->generic("      default:\n"
@@ -190,6 +212,50 @@ void CallTableMethod::generateHierarchy(unsigned int n)
   this->generateMethod(buf, i * functions_per_level, this->n_functions);
 }
 
+/*
+ * Callbacks are looked up by address once when they are registered,
+ * and then invoked through a tableswitch on the slot. Functions not
+ * found by the translator get -1 and go through call().
+ */
+void CallTableMethod::generateCallbacks()
+{
+  const char *ret_type = config->threadSafe ? "long" : "int";
+  int n = 0;
+
+  emit->generic("  public static final int getCallbackSlot(int address) {\n"
+                "    switch(address) {\n");
+  for (int i = 0; i < this->n_callbacks; i++)
+    {
+      /* Not a function (or not called through the table) */
+      if (!this->hasFunction(this->callbacks[i]))
+        continue;
+      emit->generic("      case 0x%x: return %d;\n", this->callbacks[i], n);
+      n++;
+    }
+  emit->generic("      default: return -1;\n"
+                "    }\n"
+                "  }\n\n");
+
+  emit->generic("  public static final %s callCallback(int slot, int sp, int a0, int a1, int a2, int a3) throws Exception {\n"
+                "    %s ret = 0;\n"
+                "    switch(slot) {\n",
+                ret_type, ret_type);
+  n = 0;
+  for (int i = 0; i < this->n_callbacks; i++)
+    {
+      if (!this->hasFunction(this->callbacks[i]))
+        continue;
+      emit->generic("      case %d:  ", n);
+      this->generateCall(this->m_function_table[this->callbacks[i]]);
+      n++;
+    }
+  emit->generic("      default:\n"
+                "         throw new Exception(\"Call to unknown callback slot \" + slot);\n"
+                "    }\n"
+                "    return ret;\n"
+                "  }\n\n");
+}
+
 bool CallTableMethod::pass2()
 {
   unsigned int functions_per_class = this->n_functions / config->callTableClasses;
@@ -210,6 +276,8 @@ bool CallTableMethod::pass2()
                     " }\n\n");
     }
 
+  this->generateCallbacks();
+
 
   panic_if(config->callTableClasses != 1 && config->callTableHierarchy != 1,
       "Setting both number of call table classes (%d) and call table hierarchy (%d)\n"
@@ -19,6 +19,8 @@
 #include <controller.hh>
 #include <registerallocator.hh>
 #include <syscall-wrappers.hh>
+#include <profile.hh>
+#include <stats.hh>
 #include <config.hh>
 
 #include <libgen.h>
@@ -82,6 +84,9 @@ Controller::Controller(const char *argv0, const char **defines,
     this->readSyscallDatabase(database_filenames[i]);
 
   this->builtins = new BuiltinFactory();
+  this->syscallWrappers = NULL;
+  this->profile = NULL;
+  this->stats = NULL;
 }
 
 const char *Controller::getInstallDirectory()
@@ -240,6 +245,16 @@ bool Controller::pass0()
   /* Create all functions and methods */
   fn_syms = elf->getFunctions();
   assert(fn_syms);
+
+  /* Before the functions are created, since they're added to the colocations then */
+  if (config->useProfile)
+    {
+      ProfileReader profile(config->useProfile);
+      const char *coloc = profile.getColocation(fn_syms);
+
+      if (coloc)
+        this->addColocation(coloc);
+    }
   int cnt = 0;
   for (i = 0; fn_syms[i]; i++)
     {
@@ -381,8 +396,7 @@ Syscall *Controller::getSyscall(uint32_t value)
                "  Are all syscall databases added on the command line (cibyl-syscalls.db)?\n",
                name);
 
-      this->syscalls[value] = new Syscall(p->name, p->nrArgs,
-                                          p->returns ? 'I' : 'V' );
+      this->syscalls[value] = new Syscall(p, this->syscallWrappers);
       /* Insert into the table for the syscall wrappers */
       this->m_syscall_used_table[p->name] = p;
     }
@@ -404,7 +418,7 @@ JavaMethod *Controller::getMethodByAddress(uint32_t addr)
   return NULL;
 }
 
-JavaMethod *Controller::getCallTableMethod()
+CallTableMethod *Controller::getCallTableMethod()
 {
   return this->callTableMethod;
 }
@@ -511,26 +525,97 @@ void Controller::lookupDataAddresses(uint32_t *data, int n_entries)
     }
 }
 
-uint32_t Controller::addAlignedSection(uint32_t addr, FILE *fp, void *data,
+uint32_t Controller::addAlignedSection(uint32_t addr, uint8_t *image, void *data,
                                        size_t data_len, int alignment)
 {
   uint32_t out = addr;
-  int pad = 0;
 
   if (addr & (alignment - 1))
-    pad = (-addr) & (alignment - 1);
-  out += pad;
-  while (pad != 0)
+    out += (-addr) & (alignment - 1);
+
+  /* The padding is already zero */
+  if (image)
+    memcpy(image + out, data, data_len);
+
+  return out + data_len;
+}
+
+/*
+ * The data image (program.data.bin) is a header of big-endian words
+ *
+ *   magic ("CIMG"), version, image size, .bss size, number of records
+ *
+ * followed by records of { address, length, data[length] }. Runs of
+ * zeroes are left out since the Java memory is already zeroed, and the
+ * records are word-aligned so CRunTime can load them in bulk.
+ */
+#define DATA_IMAGE_MAGIC    0x43494d47
+#define DATA_IMAGE_VERSION  1
+#define DATA_IMAGE_ZERO_RUN 32 /* Shorter zero runs are kept in the record */
+
+static void write_be32(FILE *fp, uint32_t v)
+{
+  uint32_t be = be32_to_host(v);
+
+  panic_if(fwrite(&be, 1, sizeof(be), fp) != sizeof(be),
+           "Cannot write to data image\n");
+}
+
+void Controller::writeDataImage(FILE *fp, uint8_t *image, uint32_t size,
+                                uint32_t bss_size)
+{
+  uint32_t *records = (uint32_t*)xcalloc(size / 4 + 2, sizeof(uint32_t));
+  int n_records = 0;
+  uint32_t addr = 0;
+
+  panic_if((size & 3) != 0, "Data image size %u is not word-aligned\n", size);
+
+  while (addr < size)
     {
-      int v = fputc('\0', fp);
-      panic_if(v < 0, "Cannot write padding to outfile in aligned section\n");
-      pad--;
+      uint32_t start;
+
+      /* Skip leading zeroes */
+      while (addr < size && *(uint32_t*)(image + addr) == 0)
+        addr += 4;
+      if (addr >= size)
+        break;
+
+      /* Extend the record until a long enough zero run */
+      start = addr;
+      while (addr < size)
+        {
+          uint32_t zeroes = addr;
+
+          while (zeroes < size && *(uint32_t*)(image + zeroes) == 0)
+            zeroes += 4;
+          if (zeroes != addr &&
+              (zeroes - addr >= DATA_IMAGE_ZERO_RUN || zeroes == size))
+            break;
+          addr = zeroes == addr ? addr + 4 : zeroes;
+        }
+      records[n_records * 2] = start;
+      records[n_records * 2 + 1] = addr - start;
+      n_records++;
     }
 
-  panic_if(fwrite(data, 1, data_len, fp) != data_len,
-           "Cannot write data to outfile in aligned section\n");
+  write_be32(fp, DATA_IMAGE_MAGIC);
+  write_be32(fp, DATA_IMAGE_VERSION);
+  write_be32(fp, size);
+  write_be32(fp, bss_size);
+  write_be32(fp, n_records);
 
-  return out + data_len;
+  for (int i = 0; i < n_records; i++)
+    {
+      uint32_t start = records[i * 2];
+      uint32_t len = records[i * 2 + 1];
+
+      write_be32(fp, start);
+      write_be32(fp, len);
+      panic_if(fwrite(image + start, 1, len, fp) != len,
+               "Cannot write data record to data image\n");
+    }
+
+  free(records);
 }
 
 class HiloRelocLimit
@@ -732,6 +817,7 @@ void Controller::lookupRelocations(JavaClass *cl)
 bool Controller::pass1()
 {
   ElfSection *scns[4];
+  char path[2048];
   bool out = true;
 
   scns[0] = elf->getSection(".data");
@@ -739,6 +825,15 @@ bool Controller::pass1()
   scns[2] = elf->getSection(".ctors");
   scns[3] = elf->getSection(".dtors");
 
+  /* Created here since the syscall sites ask it which syscalls to inline */
+  xsnprintf(path, 2048, "%s/%s", this->dstdir, this->getJasminPackagePath());
+  this->syscallWrappers = new SyscallWrapperGenerator(this->defines, strdup(path),
+                                                      this->n_syscall_dirs, this->syscall_dirs,
+                                                      this->n_syscall_sets, this->syscall_sets,
+                                                      this->m_syscall_used_table);
+  if (config->profile)
+    this->profile = new ProfileGenerator(path);
+
   /* Add addresses in the different ELF sections to the lookup tables */
   for (unsigned int j = 0; j < sizeof(scns) / sizeof(ElfSection*); j++)
     {
@@ -746,65 +841,133 @@ bool Controller::pass1()
         this->lookupDataAddresses((uint32_t*)scns[j]->data,
                                   scns[j]->size / sizeof(uint32_t));
     }
+  /* Basic blocks look up jumptab labels in pass 1 */
+  this->sortJumptabLabels();
 
   for (int i = 0; i < this->n_classes; i++)
     {
       JavaClass *cl = this->classes[i];
 
+      double start = StatsGenerator::now();
+
       /* And loop through the relocations and add these */
       this->lookupRelocations(cl);
+      if (this->stats)
+        this->stats->addTime("relocations", StatsGenerator::now() - start);
 
       if (cl->pass1() != true)
         out = false;
     }
   this->callTableMethod->pass1();
-  this->sortJumptabLabels();
+
+  /* All branch targets are known now */
+  for (int i = 0; i < this->n_methods; i++)
+    this->methods[i]->optimizeMemoryAccesses();
+
+  if (config->optimizeCallLiveness)
+    this->analyzeCallLiveness();
 
   return out;
 }
 
+/*
+ * Find the argument registers each method reads and how much of the
+ * return value its callers use. Everything starts out unused and is
+ * added until nothing changes, so recursive calls only keep what is
+ * really needed.
+ */
+void Controller::analyzeCallLiveness()
+{
+  bool changed;
+
+  for (int i = 0; i < this->n_methods; i++)
+    this->methods[i]->resetCallLiveness();
+
+  do
+    {
+      changed = false;
+      for (int i = 0; i < this->n_methods; i++)
+        {
+          if (this->methods[i]->updateCallLiveness())
+            changed = true;
+        }
+    } while (changed);
+
+  for (int i = 0; i < this->n_methods; i++)
+    this->methods[i]->finishCallLiveness();
+}
+
 
 bool Controller::pass2()
 {
   ElfSection *scns[4];
-  SyscallWrapperGenerator *syscallWrappers;
+  ElfSection *bss_scns[2];
   char path[2048];
   bool out = true;
   uint32_t addr = 0;
+  uint32_t image_size, bss_end;
+  uint8_t *image;
   FILE *fp;
 
   scns[0] = elf->getSection(".data");
   scns[1] = elf->getSection(".rodata");
   scns[2] = elf->getSection(".ctors");
   scns[3] = elf->getSection(".dtors");
+  bss_scns[0] = elf->getSection(".bss");
+  bss_scns[1] = elf->getSection(".cibylexpsyms");
 
   xsnprintf(path, 2048, "%s/%s", this->dstdir, this->getJasminPackagePath());
 
-  /* Output the data sections to a file */
-  fp = open_file_in_dir(this->dstdir, "program.data.bin", "w");
+  /* Lay out the data sections in memory, first to get the size */
   for (unsigned int j = 0; j < sizeof(scns) / sizeof(ElfSection*); j++)
     {
       if (scns[j])
-        addr = this->addAlignedSection(addr, fp, scns[j]->data,
+        addr = this->addAlignedSection(addr, NULL, scns[j]->data,
                                        scns[j]->size, scns[j]->align);
     }
+  image_size = (addr + 3) & ~3;
+  image = (uint8_t*)xcalloc(image_size + 4, 1);
+  addr = 0;
+  for (unsigned int j = 0; j < sizeof(scns) / sizeof(ElfSection*); j++)
+    {
+      if (scns[j])
+        addr = this->addAlignedSection(addr, image, scns[j]->data,
+                                       scns[j]->size, scns[j]->align);
+    }
+
+  /* Everything up to __edata which is not in the image (.bss etc) */
+  bss_end = image_size;
+  for (unsigned int j = 0; j < sizeof(bss_scns) / sizeof(ElfSection*); j++)
+    {
+      if (bss_scns[j] && bss_scns[j]->addr + bss_scns[j]->size > bss_end)
+        bss_end = bss_scns[j]->addr + bss_scns[j]->size;
+    }
+
+  /* Output the data sections to a file */
+  fp = open_file_in_dir(this->dstdir, "program.data.bin", "w");
+  this->writeDataImage(fp, image, image_size, bss_end - image_size);
   fclose(fp);
+  free(image);
 
   for (int i = 0; i < this->n_classes; i++)
     {
+      size_t emitted = emit->getEmittedBytes();
+
       emit->setOutputFile(open_file_in_dir(path,
                                            this->classes[i]->getFileName(), "w"));
 
       if (this->classes[i]->pass2() != true)
         out = false;
       emit->closeOutputFile();
+
+      /* The call table (last) is Java source and not packed */
+      if (this->stats && i < this->n_classes - 1)
+        this->stats->addClass(this->classes[i], emit->getEmittedBytes() - emitted);
     }
 
-  syscallWrappers = new SyscallWrapperGenerator(this->defines, strdup(path),
-                                                this->n_syscall_dirs, this->syscall_dirs,
-                                                this->n_syscall_sets, this->syscall_sets,
-                                                this->m_syscall_used_table);
-  syscallWrappers->pass2();
+  this->syscallWrappers->pass2();
+  if (this->profile)
+    this->profile->pass2();
 
   return out;
 }
@@ -835,13 +998,48 @@ static void usage()
          "   trace_start=0x...       The first address of instruction tracing\n"
          "   trace_end=0x...         The last address of instruction tracing\n"
          "   trace_stores=0/1        Set to 1 to trace memory stores\n"
-         "   thread_safe=0/1         Set to 1 to generate thread-safe code (default 0)\n"
+         "   check_object_handles=0/1  Set to 1 to add generation counts to object handles\n"
+         "                           and catch use of stale handles\n"
+         "   thread_safe=0/1         Set to 1 to generate thread-safe code, needed for\n"
+         "                           pthread_create (default 0)\n"
+         "   java_profile=P          Target cldc1.0, cldc1.1 or j2se. With cldc1.1 and j2se,\n"
+         "                           libm calls are done directly to java.lang.Math\n"
+         "                           (default cldc1.0)\n"
+         "   memory_model=int|byte   Address memory as an int[] or a byte[]. With byte,\n"
+         "                           lb/sb are single baload/bastore but lw/sw are\n"
+         "                           assembled from four bytes (default int)\n"
+         "   cache_rodata_strings=0/1  Set to 1 to cache Java Strings created from\n"
+         "                           char pointers to .rodata\n"
          "   class_size_limit=N      Set the size limit for classes (class split size)\n"
          "   call_table_hierarchy=N  Generate a call table hierarchy with N methods (default 1)\n"
          "   call_table_classes=N    Generate several call table classes\n"
          "   prune_call_table=0/1    Set to 1 to prune unused indirect function calls\n"
+         "   optimize_tail_calls=0/1 Replace calls followed by a return with jumps for\n"
+         "                           functions in the same method (default 1)\n"
+         "   optimize_jump_tables=0/1  Use a tableswitch for switch statement jump tables\n"
+         "                           found in .rodata (default 1)\n"
+         "   inline_syscalls=0/1     Call Java methods directly from the syscall site for\n"
+         "                           simple syscalls with known classes (default 1)\n"
+         "   optimize_call_liveness=0/1  Only pass argument registers and return values\n"
+         "                           which are used, over the whole call graph (default 1)\n"
+         "   optimize_constant_muldiv=0/1  Use shifts, adds and multiplications for mult/div\n"
+         "                           by constants set in the same basic block (default 1)\n"
+         "   optimize_base_index=0/1  Compute the word index once for lw/sw runs off the\n"
+         "                           same unmodified base register (default 1)\n"
+         "   optimize_load_forwarding=0/1  Take lw values from registers which hold them\n"
+         "                           from earlier in the basic block (default 1)\n"
+         "   profile=0/1             Set to 1 to count function calls and dump the profile\n"
+         "                           at exit (cibyl-profile.txt on j2se, otherwise stdout)\n"
+         "   profile_loops=0/1       Set to 1 to also count loop iterations (implies profile)\n"
+         "   profile_time=MS         Sample the running function every MS milliseconds in\n"
+         "                           a thread (implies profile, default 0 = off)\n"
+         "   use_profile=FILE        Colocate the hottest functions in FILE (from profile=1)\n"
+         "                           in a single method. Ranked by time samples, or by\n"
+         "                           call counts if the profile has no samples\n"
+         "   stats=FILE              Write pass times and per-method and class size\n"
+         "                           statistics to FILE\n"
          "   optimize_partial_memory_operations=0/1  Set to 1 to generate subroutine calls for\n"
-         "                           lb/lh/sb/sh (default 0)\n"
+         "                           lb/lh/sb/sh instead of inlining them (default 0)\n"
          "   prune_unused_functions=0/1  Prune unused functions from the call table\n"
          "   colocate_functions=FN1;FN2;... Colocate functions FN1... in a single method\n"
          "   package_name=NAME       Set Java package name (default: unnamed)\n"
@@ -880,10 +1078,58 @@ static void parse_config(Controller *cntr, Config *cfg, const char *config_str)
         cfg->traceRange[1] = int_val;
       else if (strcmp(p, "trace_stores") == 0)
         cfg->traceStores = int_val == 0 ? false : true;
+      else if (strcmp(p, "check_object_handles") == 0)
+        cfg->checkObjectHandles = int_val == 0 ? false : true;
       else if (strcmp(p, "thread_safe") == 0)
         cfg->threadSafe = int_val == 0 ? false : true;
+      else if (strcmp(p, "java_profile") == 0)
+        {
+          if (strcmp(value, "cldc1.0") == 0)
+            cfg->javaProfile = CLDC_1_0;
+          else if (strcmp(value, "cldc1.1") == 0)
+            cfg->javaProfile = CLDC_1_1;
+          else if (strcmp(value, "j2se") == 0)
+            cfg->javaProfile = J2SE;
+          else
+            usage();
+        }
+      else if (strcmp(p, "memory_model") == 0)
+        {
+          if (strcmp(value, "int") == 0)
+            cfg->memoryModel = MEMORY_MODEL_INT;
+          else if (strcmp(value, "byte") == 0)
+            cfg->memoryModel = MEMORY_MODEL_BYTE;
+          else
+            usage();
+        }
+      else if (strcmp(p, "cache_rodata_strings") == 0)
+        cfg->cacheRodataStrings = int_val == 0 ? false : true;
       else if (strcmp(p, "prune_call_table") == 0)
         cfg->optimizeCallTable = int_val == 0 ? false : true;
+      else if (strcmp(p, "optimize_tail_calls") == 0)
+        cfg->optimizeTailCalls = int_val == 0 ? false : true;
+      else if (strcmp(p, "optimize_jump_tables") == 0)
+        cfg->optimizeJumpTables = int_val == 0 ? false : true;
+      else if (strcmp(p, "inline_syscalls") == 0)
+        cfg->inlineSyscalls = int_val == 0 ? false : true;
+      else if (strcmp(p, "optimize_call_liveness") == 0)
+        cfg->optimizeCallLiveness = int_val == 0 ? false : true;
+      else if (strcmp(p, "optimize_constant_muldiv") == 0)
+        cfg->optimizeConstantMulDiv = int_val == 0 ? false : true;
+      else if (strcmp(p, "optimize_base_index") == 0)
+        cfg->optimizeBaseIndex = int_val == 0 ? false : true;
+      else if (strcmp(p, "optimize_load_forwarding") == 0)
+        cfg->optimizeLoadForwarding = int_val == 0 ? false : true;
+      else if (strcmp(p, "profile") == 0)
+        cfg->profile = int_val == 0 ? false : true;
+      else if (strcmp(p, "profile_loops") == 0)
+        cfg->profileLoops = int_val == 0 ? false : true;
+      else if (strcmp(p, "profile_time") == 0)
+        cfg->profileTime = int_val < 0 ? 0 : int_val;
+      else if (strcmp(p, "stats") == 0)
+        cfg->statsFile = xstrdup(value);
+      else if (strcmp(p, "use_profile") == 0)
+        cfg->useProfile = xstrdup(value);
       else if (strcmp(p, "optimize_partial_memory_operations") == 0)
         cfg->optimizePartialMemoryOps = int_val == 0 ? false : true;
       else if (strcmp(p, "optimize_prune_stack_stores") == 0)
@@ -908,6 +1154,20 @@ static void parse_config(Controller *cntr, Config *cfg, const char *config_str)
       p = strtok(NULL, ",");
     }
 
+  /* The lb/lh subroutines and word indices work on words, byte memory needs neither */
+  if (cfg->memoryModel == MEMORY_MODEL_BYTE)
+    {
+      cfg->optimizePartialMemoryOps = false;
+      cfg->optimizeBaseIndex = false;
+    }
+
+  if (cfg->profileLoops || cfg->profileTime)
+    cfg->profile = true;
+
+  /* Tail calls emit the epilogue again, which might have been pruned */
+  if (cfg->optimizePruneStackStores)
+    cfg->optimizeTailCalls = false;
+
   if (cfg->traceRange[1] < cfg->traceRange[0])
     {
       fprintf(stderr, "Trace start is after trace end!\n");
@@ -920,6 +1180,8 @@ static void parse_config(Controller *cntr, Config *cfg, const char *config_str)
 int main(int argc, const char **argv)
 {
   const char **defines = (const char **)xcalloc(argc, sizeof(const char*));
+  StatsGenerator *stats = NULL;
+  double start;
   int n, n_defines = 0;
 
   if (argc < 5)
@@ -949,10 +1211,29 @@ int main(int argc, const char **argv)
   controller = new Controller(argv[0], defines, argv[n], argv[n+1],
                               argc - n - 2, &argv[n + 2]);
   parse_config(controller, config, argv[1] + strlen("config:"));
+  if (config->statsFile)
+    {
+      stats = new StatsGenerator(config->statsFile);
+      controller->setStats(stats);
+    }
 
+  start = StatsGenerator::now();
   controller->pass0();
+  if (stats)
+    stats->addTime("pass0", StatsGenerator::now() - start);
+
+  start = StatsGenerator::now();
   controller->pass1();
+  if (stats)
+    stats->addTime("pass1", StatsGenerator::now() - start);
+
+  start = StatsGenerator::now();
   controller->pass2();
+  if (stats)
+    {
+      stats->addTime("pass2", StatsGenerator::now() - start);
+      stats->write();
+    }
 
   return 0;
 }
@@ -33,6 +33,7 @@
 Emit::Emit()
 {
   this->fp = stdout;
+  this->bytes = 0;
 }
 
 void Emit::bc_pushconst_u(uint32_t val)
@@ -171,6 +172,7 @@ void Emit::bc_popregister(MIPS_register_t reg)
 void Emit::bc_iinc(MIPS_register_t reg, int extra)
 {
   this->write("\tiinc %d %d", regalloc->regToLocal(reg), extra);
+  this->bytes += 3;
 }
 
 void Emit::bc_label(const char *fmt, ...)
@@ -187,6 +189,7 @@ void Emit::bc_goto(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tgoto ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -197,6 +200,7 @@ void Emit::bc_if_icmpne(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tif_icmpne ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -207,6 +211,7 @@ void Emit::bc_if_icmpeq(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tif_icmpeq ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -217,6 +222,7 @@ void Emit::bc_jsr(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tjsr ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -230,6 +236,7 @@ void Emit::bc_condbranch(const char *fmt, ...)
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
+  this->bytes += 3;
 }
 
 void Emit::generic(const char *fmt, ...)
@@ -245,6 +252,7 @@ void Emit::bc_invokestatic(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tinvokestatic ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -254,6 +262,7 @@ void Emit::bc_getstatic(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tgetstatic ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -264,6 +273,7 @@ void Emit::bc_putstatic(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tputstatic ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
@@ -274,33 +284,47 @@ void Emit::bc_invokevirtual(const char *fmt, ...)
   char buf[2048];
 
   this->output("\tinvokevirtual ");
+  this->bytes += 3;
   do_vsnprintf(buf, fmt);
   this->output(buf);
   this->output("\n");
 }
 
+void Emit::bc_invokeinterface(int n_args, const char *fmt, ...)
+{
+  char buf[2048];
+
+  this->output("\tinvokeinterface ");
+  this->bytes += 5;
+  do_vsnprintf(buf, fmt);
+  this->output(buf);
+  this->generic(" %d\n", n_args);
+}
+
 void Emit::bc_lookupswitch(int n, uint32_t *table,
-                           const char *def)
+                           const char *def, const char *prefix)
 {
   this->output("\tlookupswitch\n");
+  this->bytes += 1 + 3 + 8 + 8 * n; /* Assume the worst-case padding */
 
   for (int i = 0; i < n; i++)
     {
-      this->write("\t\t0x%x : L_%x",
-                  table[i], table[i]);
+      this->write("\t\t0x%x : %s%x",
+                  table[i], prefix, table[i]);
     }
   this->write("\t\tdefault: %s", def);
 }
 
 void Emit::bc_tableswitch(int first, int n, uint32_t *table,
-                          const char *def)
+                          const char *def, const char *prefix)
 {
   this->write("\ttableswitch %d %d", first, first + n - 1);
+  this->bytes += 1 + 3 + 12 + 4 * n;
 
   for (int i = 0; i < n; i++)
     {
-      this->write("\t\tL_%x",
-                  table[i]);
+      this->write("\t\t%s%x",
+                  prefix, table[i]);
     }
   this->write("\tdefault: %s", def);
 }
@@ -337,11 +361,41 @@ void Emit::write(const char *fmt, ...)
   this->output("\n");
 }
 
+/* The size of a simple instruction from the mnemonic and operands */
+void Emit::countInstruction(const char *insn)
+{
+  const char *operand = strchr(insn, ' ');
+  size_t len = operand ? operand - insn : strlen(insn);
+  const char *short_operand[] = {"bipush", "ldc", "iload", "istore",
+                                 "aload", "astore", "ret", "newarray"};
+
+  if (!operand)
+    {
+      this->bytes += 1;
+      return;
+    }
+  if (len == 6 && strncmp(insn, "goto_w", 6) == 0)
+    {
+      this->bytes += 5;
+      return;
+    }
+  for (unsigned int i = 0; i < sizeof(short_operand) / sizeof(const char*); i++)
+    {
+      if (strlen(short_operand[i]) == len && strncmp(insn, short_operand[i], len) == 0)
+        {
+          this->bytes += 2;
+          return;
+        }
+    }
+  this->bytes += 3;
+}
+
 void Emit::writeIndent(const char *fmt, ...)
 {
   char buf[2048];
 
   do_vsnprintf(buf, fmt);
+  this->countInstruction(buf);
 
   this->output("\t");
   this->output(buf);
@@ -13,6 +13,8 @@
 #include <stdlib.h>
 #include <utils.h>
 #include <function.hh>
+#include <controller.hh>
+#include <profile.hh>
 
 Function::Function(const char *name, Instruction **insns,
 		   int first_insn, int last_insn) : CodeBlock()
@@ -103,13 +105,84 @@ Function::Function(const char *name, Instruction **insns,
     }
   this->n_bbs = n_bbs;
 
+  this->analyzeStackUsage(insns, first_insn, last_insn);
+
   /* Fixup the bytecode size */
   this->bc_size = 0;
   this->maxStackHeight = 0;
+  this->profileIndex = -1;
   for (int i = 0; i < this->n_bbs; i++)
     this->bc_size += this->bbs[i]->getBytecodeSize();
 }
 
+static bool isStackMemoryAccess(Instruction *insn)
+{
+  if (insn->getRs() != R_SP)
+    return false;
+
+  switch (insn->getOpcode())
+    {
+    case OP_LW: case OP_LB: case OP_LBU: case OP_LH: case OP_LHU:
+    case OP_LWL: case OP_LWC1:
+      return true;
+    case OP_SW: case OP_SB: case OP_SH: case OP_SWL: case OP_SWC1:
+      /* Storing the stack pointer itself lets it escape */
+      return insn->getRt() != R_SP;
+    default:
+      break;
+    }
+
+  return false;
+}
+
+/*
+ * Find out if the function reads arguments passed on the stack (at or
+ * above its own stack frame), or if the stack pointer is used for
+ * anything but memory accesses and allocating the frame. Tail calls
+ * free the stack frame before the call, so neither is allowed then.
+ */
+void Function::analyzeStackUsage(Instruction **insns, int first, int last)
+{
+  int32_t frameSize = -1;
+
+  this->stackArguments = false;
+  this->stackAddressTaken = false;
+  for (int i = first; i < last; i++)
+    {
+      Instruction *insn = insns[i];
+      mips_opcode_t op = insn->getOpcode();
+      int p[N_REGS];
+
+      if (op == OP_ADDIU && insn->getRs() == R_SP && insn->getRt() == R_SP)
+        {
+          /* The first sp adjustment allocates the frame */
+          if (frameSize < 0)
+            frameSize = -insn->getExtra();
+          continue;
+        }
+      if (isStackMemoryAccess(insn))
+        {
+          if (insn->getExtra() >= max(frameSize, 0))
+            this->stackArguments = true;
+          continue;
+        }
+
+      /* Calls pass the stack pointer on. Syscalls are not setup until pass1 */
+      if (op == OP_JAL || op == OP_JALR || op == OP_BGEZAL || op == OP_BLTZAL ||
+          op == CIBYL_SYSCALL)
+        continue;
+
+      memset(p, 0, sizeof(p));
+      insn->fillSources(p);
+      if (p[R_SP])
+        this->stackAddressTaken = true;
+      memset(p, 0, sizeof(p));
+      insn->fillDestinations(p);
+      if (p[R_SP])
+        this->stackAddressTaken = true;
+    }
+}
+
 Function::~Function()
 {
   free(this->name);
@@ -123,18 +196,49 @@ bool Function::pass1()
 
       /* Run the pass1 of the bb and the instructions */
       bb->pass1();
-
-      /* Fill in the register usage of this function */
-      bb->fillDestinations(this->registerDestinations);
-      bb->fillSources(this->registerSources);
       this->maxStackHeight = max(this->maxStackHeight, bb->getMaxStackHeight());
     }
 
+  /* Fill in the register usage of this function */
+  this->updateRegisterUsage();
+
+  if (controller->getProfile())
+    {
+      this->profileIndex = controller->getProfile()->addFunction(this);
+      /* arrayref, index, value, 1 for the counter increments */
+      this->maxStackHeight = max(this->maxStackHeight, 4);
+    }
+
   return true;
 }
 
+void Function::optimizeMemoryAccesses()
+{
+  for (int i = 0; i < this->n_bbs; i++)
+    this->bbs[i]->optimizeMemoryAccesses();
+
+  this->updateRegisterUsage();
+}
+
+void Function::updateRegisterUsage()
+{
+  memset(this->registerSources, 0, sizeof(this->registerSources));
+  memset(this->registerDestinations, 0, sizeof(this->registerDestinations));
+
+  for (int i = 0; i < this->n_bbs; i++)
+    {
+      BasicBlock *bb = this->bbs[i];
+
+      bb->fillDestinations(this->registerDestinations);
+      bb->fillSources(this->registerSources);
+    }
+}
+
 bool Function::pass2()
 {
+  if (this->profileIndex >= 0)
+    controller->getProfile()->emitFunctionEntry(this->profileIndex);
+
   for (int i = 0; i < this->n_bbs; i++)
     {
       BasicBlock *bb = this->bbs[i];
@@ -169,20 +273,9 @@ StartFunction::StartFunction(const char *name, Instruction **insns,
   this->name = (char*)"start";
 }
 
-bool StartFunction::pass1()
+void StartFunction::updateRegisterUsage()
 {
-  for (int i = 0; i < this->n_bbs; i++)
-    {
-      BasicBlock *bb = this->bbs[i];
-
-      /* Run the pass1 of the bb and the instructions */
-      bb->pass1();
-
-      /* Fill in the register usage of this function */
-      bb->fillDestinations(this->registerDestinations);
-      bb->fillSources(this->registerSources);
-      this->maxStackHeight = max(this->maxStackHeight, bb->getMaxStackHeight());
-    }
+  Function::updateRegisterUsage();
 
   /* Start always have everything defined */
   this->registerDestinations[ R_SP ]++;
@@ -192,6 +285,4 @@ bool StartFunction::pass1()
   this->registerDestinations[ R_A3 ]++;
   this->registerDestinations[ R_V0 ]++;
   this->registerDestinations[ R_V1 ]++;
-
-  return true;
 }
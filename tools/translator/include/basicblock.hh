@@ -39,6 +39,13 @@ public:
 
   bool pass2();
 
+  /**
+   * Pair unaligned accesses, forward loads and share base indices.
+   * Branch targets can be anywhere in the basic block, so this is
+   * done after pass 1 of all basic blocks has set them.
+   */
+  void optimizeMemoryAccesses();
+
   int fillDestinations(int *p);
 
   int fillSources(int *p);
@@ -79,6 +86,17 @@ private:
   Instruction *lookupPrevRegister(Instruction *insn, MIPS_register_t reg,
       bool is_write);
 
+  int updateKnownWords(Instruction *insn, struct known_word *known, int n,
+                       bool separateStack);
+
+  void forwardLoads();
+
+  bool isWordAccess(Instruction *insn);
+
+  bool sharesBaseIndex(Instruction *leader, Instruction *insn);
+
+  void shareBaseIndices();
+
   int n_insns;
   bb_type_t type;
   Instruction **instructions;
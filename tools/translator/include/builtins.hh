@@ -43,6 +43,20 @@ public:
     return 0;
   };
 
+protected:
+  /**
+   * Push (r2 << 32) | r1 as a long, i.e., r1 is the low word.
+   *
+   * @param flip_sign invert the top bit of the result
+   */
+  void push_64_bit_from_32_bit_regs(MIPS_register_t r1, MIPS_register_t r2,
+                                    bool flip_sign = false);
+
+  /**
+   * Split the long on the top of the stack, the low word goes to r1
+   */
+  void pop_64_bit_to_32_bit_regs(MIPS_register_t r1, MIPS_register_t r2);
+
 private:
   const char *name;
 };
@@ -14,6 +14,19 @@
 
 #include <stdint.h>
 
+typedef enum
+{
+  CLDC_1_0 = 0,
+  CLDC_1_1 = 1,
+  J2SE     = 2,
+} java_profile_t;
+
+typedef enum
+{
+  MEMORY_MODEL_INT  = 0, /* CRunTime.memory is an int[] */
+  MEMORY_MODEL_BYTE = 1, /* CRunTime.memoryBytes is a byte[] */
+} memory_model_t;
+
 class Config
 {
 public:
@@ -22,14 +35,31 @@ public:
     this->traceRange[0] = 0;
     this->traceRange[1] = 0;
     this->traceStores = false;
+    this->checkObjectHandles = false;
 
     this->threadSafe = false;
+    this->javaProfile = CLDC_1_0;
+    this->memoryModel = MEMORY_MODEL_INT;
+    this->cacheRodataStrings = false;
+
+    this->profile = false;
+    this->profileLoops = false;
+    this->profileTime = 0;
+    this->statsFile = NULL;
+    this->useProfile = NULL;
 
     this->optimizeInlines = true;
+    this->inlineSyscalls = true;
+    this->optimizeJumpTables = true;
+    this->optimizeTailCalls = true;
     this->optimizeCallTable = false;
     this->optimizePartialMemoryOps = false;
     this->optimizePruneStackStores = false;
     this->optimizeFunctionReturnArguments = false;
+    this->optimizeCallLiveness = true;
+    this->optimizeConstantMulDiv = true;
+    this->optimizeBaseIndex = true;
+    this->optimizeLoadForwarding = true;
     this->pruneUnusedFunctions = true;
 
     this->classSizeLimit = 16384; /* Pretty arbitrary value! */
@@ -40,16 +70,34 @@ public:
   /* Debugging */
   uint32_t traceRange[2]; /* start, end */
   bool traceStores;
+  bool checkObjectHandles;
 
   /* Features */
   bool threadSafe;
+  java_profile_t javaProfile; /* What java.lang.Math provides */
+  memory_model_t memoryModel;
+  bool cacheRodataStrings;
+
+  /* Profiling */
+  bool profile;
+  bool profileLoops;
+  unsigned int profileTime; /* Sampling interval in ms, 0 for none */
+  const char *statsFile; /* Translator statistics, NULL for none */
+  const char *useProfile; /* Profile to colocate hot functions by, NULL for none */
 
   /* Optimizations */
   bool optimizeInlines;
+  bool inlineSyscalls;
+  bool optimizeJumpTables;
+  bool optimizeTailCalls;
   bool optimizeCallTable;
   bool optimizePartialMemoryOps;
   bool optimizePruneStackStores;
   bool optimizeFunctionReturnArguments;
+  bool optimizeCallLiveness;
+  bool optimizeConstantMulDiv;
+  bool optimizeBaseIndex;
+  bool optimizeLoadForwarding;
   bool pruneUnusedFunctions;
 
   /* Workarounds for bugs */
@@ -26,6 +26,9 @@
 
 using namespace std;
 
+class ProfileGenerator;
+class StatsGenerator;
+
 class Controller : public CodeBlock
 {
 public:
@@ -38,10 +41,32 @@ public:
   bool pass2();
 
   Instruction *getBranchTarget(uint32_t addr);
+  Instruction *getInstructionByAddress(uint32_t addr);
   JavaMethod *getMethodByAddress(uint32_t addr);
-  JavaMethod *getCallTableMethod();
+  CallTableMethod *getCallTableMethod();
   Syscall *getSyscall(uint32_t value);
 
+  /**
+   * @return the profile generator, or NULL if profiling is disabled
+   */
+  ProfileGenerator *getProfile()
+  {
+    return this->profile;
+  }
+
+  /**
+   * @return the statistics collector, or NULL if disabled
+   */
+  StatsGenerator *getStats()
+  {
+    return this->stats;
+  }
+
+  void setStats(StatsGenerator *stats)
+  {
+    this->stats = stats;
+  }
+
   const char *getDstDir()
   {
     return this->dstdir;
@@ -112,11 +137,13 @@ private:
   void readSyscallDatabase(const char *filename);
   void lookupDataAddresses(uint32_t *data, int n_entries);
   void lookupRelocations(JavaClass *cl);
+  void analyzeCallLiveness();
 
-  uint32_t addAlignedSection(uint32_t addr, FILE *fp, void *data,
+  uint32_t addAlignedSection(uint32_t addr, uint8_t *image, void *data,
                              size_t data_len, int alignment);
 
-  Instruction *getInstructionByAddress(uint32_t addr);
+  void writeDataImage(FILE *fp, uint8_t *image, uint32_t size,
+                      uint32_t bss_size);
 
   void fixupExportedSymbols(cibyl_exported_symbol_t *exp_syms, size_t n);
 
@@ -156,6 +183,10 @@ private:
 
   BuiltinFactory *builtins;
 
+  SyscallWrapperGenerator *syscallWrappers;
+  ProfileGenerator *profile;
+  StatsGenerator *stats;
+
   FunctionColocation **colocs;
   int n_colocs;
 
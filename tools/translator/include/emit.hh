@@ -88,9 +88,14 @@ public:
 
   void bc_invokevirtual(const char *what, ...);
 
-  void bc_lookupswitch(int n, uint32_t *table, const char *def);
+  void bc_invokeinterface(int n_args, const char *what, ...);
 
-  void bc_tableswitch(int first, int n, uint32_t *table, const char *def);
+  /* Jumps to labels named by prefix and the value, e.g., L_80001234 */
+  void bc_lookupswitch(int n, uint32_t *table, const char *def,
+                       const char *prefix = "L_");
+
+  void bc_tableswitch(int first, int n, uint32_t *table, const char *def,
+                      const char *prefix = "L_");
 
   void bc_iushr() { this->writeIndent("iushr"); }
 
@@ -138,6 +143,8 @@ public:
 
   void bc_dup2() { this->writeIndent("dup2"); }
 
+  void bc_dup2_x2() { this->writeIndent("dup2_x2"); }
+
   void bc_pop() { this->writeIndent("pop"); }
 
   void bc_pop2() { this->writeIndent("pop2"); }
@@ -162,6 +169,10 @@ public:
 
   void bc_iastore() { this->writeIndent("iastore"); }
 
+  void bc_baload() { this->writeIndent("baload"); }
+
+  void bc_bastore() { this->writeIndent("bastore"); }
+
   void bc_ireturn() { this->writeIndent("ireturn"); }
 
   void bc_lreturn() { this->writeIndent("lreturn"); }
@@ -182,6 +193,12 @@ public:
 
   FILE *getOutputFile() { return this->fp; }
 
+  /**
+   * @return an estimate of the number of bytecode bytes emitted so
+   * far, for the statistics
+   */
+  size_t getEmittedBytes() { return this->bytes; }
+
   void output(const char *what);
 
   void generic(const char *what, ...);
@@ -193,7 +210,10 @@ private:
 
   void writeIndent(const char *dst, ...);
 
+  void countInstruction(const char *insn);
+
   FILE *fp;
+  size_t bytes;
 };
 
 extern Emit *emit;
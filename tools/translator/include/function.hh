@@ -29,6 +29,12 @@ public:
 
   bool pass2();
 
+  /**
+   * Optimize the memory accesses of the basic blocks, see
+   * JavaMethod::optimizeMemoryAccesses()
+   */
+  void optimizeMemoryAccesses();
+
   /**
    * Get the name of this function as it will appear in the Java
    * bytecode. Unique in the entire program.
@@ -51,11 +57,36 @@ public:
 
   int fillSources(int *p);
 
+  /**
+   * Refill the register sources and destinations from the
+   * instructions, e.g., after the argument registers of called
+   * methods have changed
+   */
+  virtual void updateRegisterUsage();
+
   bool hasRegisterIndirectJumps()
   {
     return this->registerIndirectJumps;
   }
 
+  /**
+   * @return true if the function reads arguments passed on the stack
+   */
+  bool usesStackArguments()
+  {
+    return this->stackArguments;
+  }
+
+  /**
+   * @return true if the address of the stack frame is used for
+   * something else than loads and stores (e.g., passing a pointer
+   * to a local variable)
+   */
+  bool takesStackAddress()
+  {
+    return this->stackAddressTaken;
+  }
+
   bool opcodeIsUsed(mips_opcode_t op)
   {
     panic_if(op < 0 || op > N_INSNS,
@@ -73,6 +104,14 @@ public:
     return this->maxStackHeight;
   };
 
+  /**
+   * @return the index of the profile counter, or -1 if not profiled
+   */
+  int getProfileIndex()
+  {
+    return this->profileIndex;
+  }
+
   JavaMethod *parent;
 protected:
   void markOpcodeUsed(mips_opcode_t op)
@@ -82,17 +121,22 @@ protected:
     this->usedInsns[op] = 1;
   }
 
+  void analyzeStackUsage(Instruction **insns, int first, int last);
+
   int registerDestinations[N_REGS];
   int registerSources[N_REGS];
   int n_bbs;
 
   size_t bc_size;
   size_t maxStackHeight;
+  int profileIndex;
 
   BasicBlock **bbs;
   char *name;
   char *realName;
   bool registerIndirectJumps;
+  bool stackArguments;
+  bool stackAddressTaken;
 
   uint8_t usedInsns[N_INSNS];
 };
@@ -103,7 +147,7 @@ public:
   StartFunction(const char *name, Instruction **insns,
                 int first, int last);
 
-  bool pass1();
+  void updateRegisterUsage();
 };
 
 #endif /* !__FUNCTION_HH__ */
@@ -94,6 +94,32 @@ public:
 
   virtual int fillSources(int *p) { return 0; };
 
+  /**
+   * Use the memory word index computed by @a leader instead of
+   * computing it from the base register again. The leader is passed
+   * this instruction itself, and stores the index for the others.
+   *
+   * @param leader the first lw/sw off the same base register
+   */
+  virtual void setBaseIndexLeader(Instruction *leader) { };
+
+  /**
+   * Take the value of this load from @a reg instead of from memory,
+   * since the register already holds it
+   *
+   * @param reg the register holding the loaded value
+   */
+  virtual void setForwardedValue(MIPS_register_t reg) { };
+
+  virtual bool hasForwardedValue() { return false; };
+
+  /**
+   * Pair an lwl/lwr or swl/swr with the complementary instruction
+   * after it, see MemoryXX::pairUnaligned(). Done when all branch
+   * targets are known.
+   */
+  virtual void pairUnalignedAccess() { };
+
   void setDelayed(Instruction *delayed)
   {
     this->delayed = delayed;
@@ -45,6 +45,20 @@ public:
   char *name;
 };
 
+/* A call to a method, for the return value liveness */
+class CallSite
+{
+public:
+  CallSite(JavaMethod *caller, uint32_t returnAddress)
+  {
+    this->caller = caller;
+    this->returnAddress = returnAddress;
+  }
+
+  JavaMethod *caller;
+  uint32_t returnAddress; /* 0 if the caller returns the value directly */
+};
+
 class JavaMethod : public CodeBlock
 {
 public:
@@ -85,6 +99,67 @@ public:
 
   void setReturnSize(int n);
 
+  /**
+   * Add a call to this method from @a caller, returning to
+   * @a returnAddress. Used to find out if the return value is needed.
+   */
+  void addCallSite(JavaMethod *caller, uint32_t returnAddress);
+
+  /**
+   * The part of a returned value which is read at @a address in this
+   * method, e.g., after a call.
+   *
+   * @param address the address, or 0 for the return from this method
+   * @return 0, 1 (v0 only) or 2 (v0 and v1)
+   */
+  int returnSizeUsedAt(uint32_t address);
+
+  /**
+   * The part of v0/v1 which this method might write, including what
+   * the methods it calls write. Unlike returnSize(), this is not
+   * reduced to what the callers use, so a method which passes on the
+   * return value of another keeps it.
+   *
+   * @return 0, 1 (v0 only) or 2 (v0 and v1)
+   */
+  int returnSizeWritten()
+  {
+    return this->m_returnWritten;
+  }
+
+  /**
+   * Interprocedural liveness of arguments and return values. All
+   * methods are first reset, then updated until nothing changes and
+   * finally the register usage is recomputed.
+   *
+   * Methods in the call table can be called from Java, so the
+   * return value of these is always kept.
+   */
+  void resetCallLiveness();
+
+  /**
+   * @return true if the arguments or the return size changed
+   */
+  bool updateCallLiveness();
+
+  void finishCallLiveness();
+
+  /**
+   * Optimize the memory accesses in the basic blocks and update the
+   * register usage. Done after pass 1 of all methods, when all branch
+   * targets are known.
+   */
+  void optimizeMemoryAccesses();
+
+  /**
+   * @return true if the arguments and return size comes from the
+   * call liveness analysis
+   */
+  bool hasCallLiveness()
+  {
+    return this->m_callLiveness;
+  }
+
   int getRegistersToPass()
   {
     return this->n_registersToPass;
@@ -146,7 +221,11 @@ protected:
   void emitLoadSubroutine(mips_opcode_t op);
   void emitStoreSubroutine(mips_opcode_t op);
   void emitSubroutineForOp(mips_opcode_t op);
-  void emitSubroutines();
+  int emitSubroutines();
+
+  bool registerIsLiveAt(uint32_t address, MIPS_register_t reg, int *budget);
+
+  void updateRegisterUsage();
 
   Function **functions;
   int n_functions;
@@ -167,6 +246,12 @@ protected:
   size_t maxStackHeight;
 
   int m_returnSize;
+  int m_returnWritten;
+
+  int n_callSites;
+  CallSite **callSites;
+  bool m_callLiveness;
+  bool m_calledFromJava;
 
   /* M_ZERO-terminated list */
   MIPS_register_t *m_possibleArguments;
@@ -179,6 +264,26 @@ public:
 
   void addFunction(Function *fn);
 
+  /**
+   * Add a function which is registered as a callback. Callbacks get
+   * a slot in a dense table so that CRunTime.invokeCallback can call
+   * the method directly instead of going through call().
+   *
+   * @param addr the address of the callback function
+   */
+  void addCallback(uint32_t addr);
+
+  /**
+   * @return true if the function at @a addr can be called through
+   * the call table
+   */
+  bool hasFunction(uint32_t addr)
+  {
+    JavaFunctionTable_t::iterator it = this->m_function_table.find(addr);
+
+    return it != this->m_function_table.end() && it->second != NULL;
+  }
+
   bool pass1();
 
   bool pass2();
@@ -210,10 +315,18 @@ protected:
   /* Generate a hierarchy of methods */
   void generateHierarchy(unsigned int n);
 
+  /* Generate the dense callback table */
+  void generateCallbacks();
+
+  /* Output the call of @a fn in a switch case */
+  void generateCall(Function *fn);
+
   Function **functions;
   cibyl_exported_symbol_t *exp_syms;
   JavaFunctionTable_t m_function_table;
   size_t n_exp_syms;
+  uint32_t *callbacks;
+  int n_callbacks;
   int n_function;
 };
 
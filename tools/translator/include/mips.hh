@@ -98,10 +98,11 @@ typedef enum
   R_ECB = 82, /* Exception call back address */
   R_EAR = 83, /* Exception argument (to function) */
   R_FNA = 84, /* Function index (for multi-function methods) */
-  R_MEM = 85  /* Virtual memory "register" */
+  R_MEM = 85, /* Virtual memory "register" */
+  R_BIX = 86  /* Shared word index for lw/sw off the same base */
 } MIPS_register_t;
 
-#define N_REGS 86
+#define N_REGS 87
 
 typedef enum
 {
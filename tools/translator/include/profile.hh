@@ -0,0 +1,127 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      profile.hh
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Profiling counters in the translated code
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#ifndef __PROFILE_HH__
+#define __PROFILE_HH__
+
+#include <map>
+
+#include <function.hh>
+#include <elf.hh>
+#include <cpp-utils.hh>
+
+using namespace std;
+
+/**
+ * Generates the CibylProfile class and the counter updates in the
+ * translated code. Each function has a call counter, loop headers
+ * optionally have one as well. With time sampling, a thread samples
+ * the function which was last entered.
+ *
+ * The profile is written at exit (to cibyl-profile.txt on J2SE and
+ * to System.out otherwise) with one entry per line:
+ *
+ *   # cibyl-profile 1
+ *   function NAME CALLS SAMPLES
+ *   loop NAME 0xADDRESS COUNT
+ */
+class ProfileGenerator
+{
+public:
+  ProfileGenerator(const char *dstdir);
+
+  /**
+   * Add the counters of a function, i.e., the entry counter and
+   * counters for loop headers if these are enabled
+   *
+   * @param fn the function to add
+   * @return the index of the function counter
+   */
+  int addFunction(Function *fn);
+
+  /**
+   * @return the index of the counter for the loop header at
+   * @a address, or -1 if it's not a loop header
+   */
+  int lookupLoop(uint32_t address);
+
+  /* Bytecode for function entry (and time sampling) */
+  void emitFunctionEntry(int idx);
+
+  /* Set the function being sampled, e.g., after returning from a call */
+  void emitCurrentFunction(int idx);
+
+  void emitLoopHeader(int idx);
+
+  /* Generate CibylProfile.java */
+  bool pass2();
+
+  typedef map<uint32_t, int> LoopTable_t;
+
+private:
+  void addLoop(Function *fn, uint32_t address);
+
+  void emitIncrement(const char *array, int idx);
+
+  const char *m_dstdir;
+
+  int n_functions;
+  const char **functionNames;
+
+  int n_loops;
+  const char **loopFunctionNames;
+  uint32_t *loopAddresses;
+  LoopTable_t m_loops;
+};
+
+/**
+ * Reads a profile written by the generated code (or converted from a
+ * J2ME .prf file by cibyl-mips2java) for use_profile=FILE, and picks
+ * the hottest functions to colocate in a single method.
+ *
+ * Functions are ranked by the time samples. Without profile_time all
+ * samples are 0, and the call counts are used instead.
+ */
+class ProfileReader
+{
+public:
+  ProfileReader(const char *filename);
+
+  /**
+   * Select the hottest of @a syms which can be colocated. Functions
+   * with less than 1% of the weight of the hottest are left out, as
+   * are functions beyond a size budget.
+   *
+   * @return a colocate_functions string, or NULL if less than two
+   * functions were found
+   */
+  const char *getColocation(ElfSymbol **syms);
+
+  typedef struct
+  {
+    const char *name;
+    unsigned long calls;
+    unsigned long samples;
+  } profile_entry_t;
+
+private:
+  ElfSymbol *lookupSymbol(const char *name);
+
+  bool m_sampled;
+  int n_entries;
+  profile_entry_t *entries;
+
+  /* By Java method name and by name without the address */
+  map<const char *, ElfSymbol *, cmp_str> m_symbols;
+  map<const char *, int, cmp_str> m_nameCount;
+};
+
+#endif /* !__PROFILE_HH__ */
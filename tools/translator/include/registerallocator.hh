@@ -21,7 +21,14 @@ class RegisterAllocator
 public:
   RegisterAllocator();
 
-  void setAllocation(int *registerUsage);
+  /**
+   * Map the used registers to locals. The arguments come first, in
+   * order, and then the rest by how often they are used.
+   *
+   * @param registerUsage the usage count per register
+   * @param arguments R_ZERO-terminated list of argument registers
+   */
+  void setAllocation(int *registerUsage, MIPS_register_t *arguments);
 
   bool regIsStatic(MIPS_register_t reg);
 
@@ -0,0 +1,86 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      stats.hh
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Translator timing and code statistics
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#ifndef __STATS_HH__
+#define __STATS_HH__
+
+#include <stdint.h>
+#include <stddef.h>
+
+class JavaClass;
+
+typedef struct
+{
+  const char *name;
+  const char *className;
+  size_t estimatedSize;   /* From the instructions, used for class packing */
+  size_t emittedSize;     /* Bytecode bytes actually emitted */
+  int maxStack;           /* .limit stack */
+  int maxLocals;          /* .limit locals */
+  int n_functions;
+  int n_callTable;        /* Functions callable through the call table */
+  int n_subroutines;      /* jsr targets for partial memory operations */
+  int n_returnLocations;
+  int n_exceptionHandlers;
+} method_stats_t;
+
+/**
+ * Collects the time spent in the translator passes and statistics
+ * about the generated methods and classes. The report is written
+ * after pass 2 with one entry per line:
+ *
+ *   # cibyl-stats 1
+ *   time NAME SECONDS
+ *   method NAME CLASS ESTIMATED EMITTED STACK LOCALS FUNCTIONS CALLTABLE JSR RETURNS HANDLERS
+ *   class NAME METHODS ESTIMATED EMITTED LIMIT
+ *
+ * Emitted sizes are estimated from the Jasmin output and do not
+ * include constant pool growth or switch padding differences.
+ */
+class StatsGenerator
+{
+public:
+  StatsGenerator(const char *filename);
+
+  /**
+   * @return the current wall-clock time in seconds
+   */
+  static double now();
+
+  /**
+   * Add time to the timer @a name, repeated additions accumulate
+   */
+  void addTime(const char *name, double seconds);
+
+  void addMethod(method_stats_t *method);
+
+  void addClass(JavaClass *cl, size_t emittedSize);
+
+  bool write();
+
+private:
+  const char *m_filename;
+
+  int n_timers;
+  const char **timerNames;
+  double *timerSeconds;
+
+  int n_methods;
+  method_stats_t *methods;
+
+  int n_classes;
+  const char **classNames;
+  int *classMethods;
+  size_t *classEstimated;
+  size_t *classEmitted;
+};
+
+#endif /* !__STATS_HH__ */
@@ -15,6 +15,12 @@
 #include <syscall.hh>
 #include <controller.hh>
 
+typedef struct
+{
+  const char *path; /* e.g., javax/microedition/lcdui/Graphics, NULL if ambiguous */
+  bool isInterface;
+} jvm_class_t;
+
 class SyscallWrapperGenerator
 {
 public:
@@ -35,9 +41,41 @@ public:
                           int n_syscall_sets, char **syscall_sets,
                           Controller::CibylDbTable_t &used_syscalls);
 
-  /* No pass1 - this will not be created until after pass1 */
+  /* No pass1 - the used syscalls are registered in the controller pass1 */
   bool pass2();
 
+  /**
+   * Lookup the fully qualified name of a Java class, as given in
+   * the jvm-classes files of the syscall sets.
+   *
+   * @param name the class name used in the syscall database, e.g., Graphics
+   * @param isInterface set to true if the class is an interface (can be NULL)
+   *
+   * @return the JVM class name or NULL if it's not known
+   */
+  const char *lookupJvmClass(const char *name, bool *isInterface);
+
+  /**
+   * Check if a syscall can be called directly from the syscall
+   * site. This is true for generated syscalls with int and
+   * object handle arguments where all classes are known. Inlined
+   * syscalls are not generated in the Syscalls class.
+   *
+   * @param p the syscall
+   *
+   * @return true if the syscall can be inlined
+   */
+  bool canInline(cibyl_db_entry_t *p);
+
+  /**
+   * @return true if the syscall is a call on the object passed as the
+   * first argument
+   */
+  bool isObjectCall(cibyl_db_entry_t *p);
+
+  typedef map<const char *, jvm_class_t *, cmp_str> JvmClassTable_t;
+  typedef map<const char *, bool, cmp_str> NoInlineTable_t;
+
 private:
   const char *getJavaReturnString(int r);
 
@@ -47,6 +85,12 @@ private:
 
   void doOne(cibyl_db_entry_t *p);
 
+  void fixupSetUsage();
+
+  void stripComments(char *data);
+
+  void readJvmClasses();
+
   void generateImports();
 
   void generateInits();
@@ -65,6 +109,8 @@ private:
   char **syscall_sets;
   int *set_usage;
   Controller::CibylDbTable_t &m_used_syscalls;
+  JvmClassTable_t m_jvm_classes;
+  NoInlineTable_t m_noinline;
 };
 
 #endif /* !__SYSCALL_WRAPPERS_HH__ */
@@ -49,10 +49,30 @@ typedef struct
   unsigned long user;
 } cibyl_db_entry_t;
 
+class SyscallWrapperGenerator;
+
+typedef enum
+{
+  SYSCALL_INVOKE_WRAPPER   = 0, /* Call through the generated Syscalls class */
+  SYSCALL_INVOKE_STATIC    = 1, /* Inlined calls to the Java method */
+  SYSCALL_INVOKE_VIRTUAL   = 2,
+  SYSCALL_INVOKE_INTERFACE = 3,
+} syscall_invoke_t;
+
 class Syscall
 {
 public:
-  Syscall(const char *name, int nrArguments, char returnValue);
+  /**
+   * Create a new syscall. If the wrapper generator allows it, the
+   * syscall is inlined, i.e., the Java method is called directly
+   * at the syscall site instead of through the Syscalls class.
+   *
+   * @param p the syscall database entry
+   * @param wrappers the syscall wrapper generator
+   */
+  Syscall(cibyl_db_entry_t *p, SyscallWrapperGenerator *wrappers);
+
+  const char *getName() { return this->name; }
 
   char *getJavaSignature() { return this->javaSignature; }
 
@@ -60,10 +80,34 @@ public:
 
   int getRegistersToPass() { return this->nrArguments; }
 
+  syscall_invoke_t getInvokeType() { return this->invokeType; }
+
+  bool isInlined() { return this->invokeType != SYSCALL_INVOKE_WRAPPER; }
+
+  /**
+   * Get the class an argument should be converted to at the
+   * syscall site
+   *
+   * @param n the argument number
+   *
+   * @return the JVM class name, or NULL if the argument is passed as
+   * an int
+   */
+  const char *getArgumentClass(int n) { return this->argumentClasses[n]; }
+
+  /**
+   * @return true if the (inlined) call returns an object which should
+   * be registered
+   */
+  bool returnsObject() { return this->returnValue == 'L'; }
+
 private:
+  const char *name;
   int nrArguments;
   char *javaSignature;
   char returnValue;
+  syscall_invoke_t invokeType;
+  const char **argumentClasses;
 };
 
 #endif /* !__SYSCALL_HH__ */
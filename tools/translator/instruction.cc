@@ -17,6 +17,7 @@
 #include <javaclass.hh>
 #include <emit.hh>
 #include <config.hh>
+#include <profile.hh>
 #include <utils.h>
 
 /* The base class for all instructions */
@@ -193,21 +194,19 @@ Instruction *InstructionFactory::create(uint32_t address, uint32_t word)
     case OP_LBU: return new Lbu(address, opcode, rs, rt, extra);
     case OP_LH:  return new Lh(address, opcode, rs, rt, extra);
     case OP_LHU: return new Lhu(address, opcode, rs, rt, extra);
-    case OP_LWL: return new LoadXX("WordLeft", address, opcode,
-				   rs, rt, extra);
-    case OP_LWR: return new Nop(address);
+    case OP_LWL: return new UnalignedLoad(address, opcode, rs, rt, extra);
+    case OP_LWR: return new UnalignedLoad(address, opcode, rs, rt, extra);
     case OP_SB: return new Sb(address, opcode, rs, rt, extra);
     case OP_SH: return new Sh(address, opcode, rs, rt, extra);
-    case OP_SWL: return new StoreXX("WordLeft", address, opcode,
-				    rs, rt, extra);
-    case OP_SWR: return new Nop(address);
+    case OP_SWL: return new UnalignedStore(address, opcode, rs, rt, extra);
+    case OP_SWR: return new UnalignedStore(address, opcode, rs, rt, extra);
 
       /* Misc other instructions */
     case OP_BREAK: return new Nop(address);
     case OP_MULT: return new Mult(address, opcode, rs, rt);
-    case OP_MULTU: return new MulDiv("multu", address, opcode, rs, rt, rd, extra);
+    case OP_MULTU: return new Multu(address, opcode, rs, rt);
     case OP_DIV: return new Div(address, opcode, rs, rt);
-    case OP_DIVU: return new MulDiv("divu", address, opcode, rs, rt, rd, extra);
+    case OP_DIVU: return new Divu(address, opcode, rs, rt);
     case OP_MFLO: return new Mfxx(address, opcode, rd, R_LO);
     case OP_MFHI: return new Mfxx(address, opcode, rd, R_HI);
     case OP_MTLO: return new Mtxx(address, opcode, rd, R_LO);
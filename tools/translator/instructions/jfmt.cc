@@ -77,6 +77,9 @@ public:
 };
 
 
+/* The number of instructions after a call to look for the epilogue */
+#define TAILCALL_WINDOW 16
+
 class Jal : public BranchInstruction
 {
 public:
@@ -86,6 +89,7 @@ public:
     this->dstMethod = NULL;
     this->dstClass = NULL;
     this->builtin = NULL;
+    this->epilogue = 0;
   }
 
   Jal(uint32_t address, int opcode, MIPS_register_t rs, int32_t extra) : BranchInstruction(address, opcode, rs, R_ZERO, R_ZERO, extra)
@@ -94,6 +98,7 @@ public:
     this->dstMethod = NULL;
     this->dstClass = NULL;
     this->builtin = NULL;
+    this->epilogue = 0;
   }
 
   bool pass1()
@@ -124,6 +129,21 @@ public:
     if (this->builtin)
       return this->builtin->pass1(this);
 
+    if (config->optimizeTailCalls && this->opcode == OP_JAL &&
+        this->isTailCall(dst))
+      {
+        this->epilogue = this->lookupEpilogue();
+
+        /* Functions in multi-function methods always have a label */
+        if (!this->method->hasMultipleFunctions())
+          controller->getBranchTarget(dst)->setBranchTarget();
+      }
+
+    /* Calls within the method keep the return value in the registers */
+    if (this->method != this->dstMethod ||
+        (!this->method->hasMultipleFunctions() && !this->epilogue))
+      this->dstMethod->addCallSite(this->method, this->getReturnAddress());
+
     return true;
   }
 
@@ -137,6 +157,24 @@ public:
     if (this->builtin)
       return this->builtin->pass2(this);
 
+    if (this->epilogue)
+      {
+        /*
+         * Tail call: Pop the stack frame and jump to the function,
+         * which will then return directly to our caller. The jr ra
+         * itself is replaced by the jump.
+         */
+        Instruction *jr = controller->getInstructionByAddress(this->epilogue);
+
+        for (uint32_t a = this->address + 8; a < this->epilogue; a += 4)
+          controller->getInstructionByAddress(a)->pass2();
+        if (jr->hasDelayed())
+          jr->getDelayed()->pass2();
+        emit->bc_goto(dst);
+
+        return true;
+      }
+
     /* OK, a bit ugly... */
     if (this->opcode == OP_JAL && this->method->hasMultipleFunctions() &&
         this->method == this->dstMethod)
@@ -174,34 +212,61 @@ public:
     emit->bc_invokestatic("%s%s/%s",
         controller->getJasminPackagePath(), dstClass->getName(), this->dstMethod->getJavaMethodName());
 
+    /* The time sampler should see the caller again */
+    if (controller->getProfile())
+      {
+        Function *fn = this->method->getFunctionByAddress(this->address);
+
+        if (fn && fn->getProfileIndex() >= 0)
+          controller->getProfile()->emitCurrentFunction(fn->getProfileIndex());
+      }
+
+    /* Only keep the parts of the return value which are read */
+    int used = this->dstMethod->returnSize();
+    if (config->optimizeCallLiveness)
+      {
+        int read = this->method->returnSizeUsedAt(this->getReturnAddress());
+
+        if (read < used)
+          used = read;
+      }
+
     if (config->threadSafe)
       {
         if (this->dstMethod->returnSize() == 2)
           {
             /* We have a 64-bit value on the stack */
-            emit->bc_dup2();
-            emit->bc_pushconst(32);
-            emit->bc_lushr();
-            emit->bc_l2i(); /* v1 */
-            emit->bc_popregister( R_V1 );
-            emit->bc_l2i(); /* v0 */
-            emit->bc_popregister( R_V0 );
+            if (used == 2)
+              {
+                emit->bc_dup2();
+                emit->bc_pushconst(32);
+                emit->bc_lushr();
+                emit->bc_l2i(); /* v1 */
+                emit->bc_popregister( R_V1 );
+              }
+            if (used >= 1)
+              {
+                emit->bc_l2i(); /* v0 */
+                emit->bc_popregister( R_V0 );
+              }
+            else
+              emit->bc_pop2();
           }
         else if (this->dstMethod->returnSize() == 1)
-          emit->bc_popregister( R_V0 );
+          this->popReturnValue(used);
         /* else: Nada */
       }
     else
       {
-        if (this->dstMethod->returnSize() == 2)
+        if (this->dstMethod->returnSize() == 2 && used == 2)
           {
             emit->bc_getstatic("%sCRunTime/saved_v1 I",
                 controller->getJasminPackagePath());
             emit->bc_popregister( R_V1 );
             emit->bc_popregister( R_V0 );
           }
-        else if (this->dstMethod->returnSize() == 1)
-          emit->bc_popregister( R_V0 );
+        else if (this->dstMethod->returnSize() >= 1)
+          this->popReturnValue(used);
       }
 
     return true;
@@ -211,7 +276,16 @@ public:
   {
     int out = 0;
 
-    out += this->addToRegisterUsage(R_V0, p) + this->addToRegisterUsage(R_V1, p);
+    /* What the called method writes, once that's known */
+    if (!this->builtin && this->dstMethod && this->dstMethod->hasCallLiveness())
+      {
+        if (this->dstMethod->returnSizeWritten() >= 1)
+          out += this->addToRegisterUsage(R_V0, p);
+        if (this->dstMethod->returnSizeWritten() >= 2)
+          out += this->addToRegisterUsage(R_V1, p);
+      }
+    else
+      out += this->addToRegisterUsage(R_V0, p) + this->addToRegisterUsage(R_V1, p);
     if (this->builtin)
       out += this->builtin->fillDestinations(p);
     if (this->method == this->dstMethod && this->method->hasMultipleFunctions())
@@ -222,8 +296,22 @@ public:
 
   int fillSources(int *p)
   {
+    MIPS_register_t args[] = {R_SP, R_A0, R_A1, R_A2, R_A3};
     int out = 0;
 
+    /* Only the registers the called method takes, once that's known */
+    if (!this->builtin && this->dstMethod && this->dstMethod->hasCallLiveness())
+      {
+        out += this->addToRegisterUsage(this->rs, p);
+        for (unsigned int i = 0; i < sizeof(args) / sizeof(args[0]); i++)
+          {
+            if (this->dstMethod->registerIsArgument(args[i]))
+              out += this->addToRegisterUsage(args[i], p);
+          }
+
+        return out;
+      }
+
     out += this->addToRegisterUsage(this->rs, p) + this->addToRegisterUsage(R_A0, p) +
       this->addToRegisterUsage(R_A1, p) + this->addToRegisterUsage(R_A2, p) +
       this->addToRegisterUsage(R_A3, p) + this->addToRegisterUsage(R_SP, p);
@@ -233,6 +321,15 @@ public:
     return out;
   };
 
+  /**
+   * @return the address execution continues at after the call, or 0
+   * if the caller returns directly afterwards
+   */
+  virtual uint32_t getReturnAddress()
+  {
+    return this->address + 8;
+  }
+
   size_t getMaxStackHeight()
   {
     /* Cowardly assume all 6 possible registers are passed */
@@ -240,10 +337,95 @@ public:
   }
 
 protected:
+  /* Pop a 32-bit return value to v0 if it's read */
+  void popReturnValue(int used)
+  {
+    if (used >= 1)
+      emit->bc_popregister( R_V0 );
+    else
+      emit->bc_pop();
+  }
+
+  /**
+   * Check if the call can be replaced by a jump, i.e., if it's to a
+   * function in the same method and only the epilogue follows it.
+   */
+  bool isTailCall(uint32_t dst)
+  {
+    Function *src = this->method->getFunctionByAddress(this->address);
+    Function *dstFn = this->method->getFunctionByAddress(dst);
+
+    if (this->method != this->dstMethod || !dstFn || dstFn->getAddress() != dst)
+      return false;
+
+    /* The callee can't access our (freed) stack frame */
+    if (dstFn->usesStackArguments() || src->takesStackAddress())
+      return false;
+
+    return this->lookupEpilogue() != 0;
+  }
+
+  /*
+   * Restores of s0-s7, fp and ra from the stack frame, frame pop and
+   * nops. These are done before the jump to the callee, so anything
+   * else (arguments, temporaries, the return value) must be left
+   */
+  bool isEpilogueInstruction(Instruction *insn)
+  {
+    if (insn->isNop())
+      return true;
+    if (insn->getOpcode() == OP_ADDIU && insn->getRs() == R_SP &&
+        insn->getRt() == R_SP && insn->getExtra() > 0)
+      return true;
+    if (insn->getOpcode() != OP_LW || insn->getRs() != R_SP)
+      return false;
+
+    if (insn->getRt() == R_RA)
+      return true;
+    for (int i = 0; mips_caller_saved[i] != R_ZERO; i++)
+      {
+        if (insn->getRt() == mips_caller_saved[i])
+          return true;
+      }
+
+    return false;
+  }
+
+  /**
+   * @return the address of the jr ra after the call, or 0 if
+   * something else than the epilogue comes before it
+   */
+  uint32_t lookupEpilogue()
+  {
+    for (uint32_t a = this->address + 8; a < this->address + 8 + TAILCALL_WINDOW * 4; a += 4)
+      {
+        Instruction *insn = controller->getInstructionByAddress(a);
+        Instruction *delayed;
+
+        if (!insn)
+          return 0;
+        if (insn->getOpcode() != OP_JR || insn->getRs() != R_RA)
+          {
+            if (!this->isEpilogueInstruction(insn))
+              return 0;
+            continue;
+          }
+        /* The delay slot is held by the jr, the table has a nop there */
+        delayed = insn->getDelayed();
+        if (delayed && !this->isEpilogueInstruction(delayed))
+          return 0;
+
+        return a;
+      }
+
+    return 0;
+  }
+
   JavaMethod *method;
   JavaMethod *dstMethod;
   JavaClass *dstClass;
   Builtin *builtin;
+  uint32_t epilogue; /* The jr ra for tail calls */
 };
 
 class Jalr : public Jal
@@ -255,6 +437,9 @@ public:
 
   bool pass1()
   {
+    this->method = controller->getMethodByAddress(this->getAddress());
+    panic_if(!this->method, "No method found for jalr at 0x%x\n", this->getAddress());
+
     this->dstMethod = controller->getCallTableMethod();
     panic_if(!this->dstMethod, "No method found for jalr to 0x%x\n", this->extra << 2);
 
@@ -284,6 +469,11 @@ public:
   {
   }
 
+  uint32_t getReturnAddress()
+  {
+    return 0;
+  }
+
   bool pass2()
   {
     bool out = Jal::pass2();
@@ -296,12 +486,19 @@ public:
 };
 
 
+/* How far back from the jr to look for the jump table code */
+#define JUMPTAB_WINDOW    16
+#define JUMPTAB_MAX_SIZE  4096
+
 class Jr : public BranchInstruction
 {
 public:
   Jr(uint32_t address, int opcode, MIPS_register_t rs) : BranchInstruction(address, opcode,
       rs, R_ZERO, R_ZERO, 0)
   {
+    this->table = NULL;
+    this->n_table = 0;
+    this->indexRegister = R_ZERO;
   }
 
   virtual bool isRegisterIndirectJump()
@@ -323,6 +520,12 @@ public:
     return this->addToRegisterUsage(this->rs, p);
   };
 
+  size_t getMaxStackHeight()
+  {
+    /* The address and the case index */
+    return 2 + (this->delayed ? this->delayed->getMaxStackHeight() : 0);
+  }
+
   bool pass2()
   {
     if (this->rs == R_RA)
@@ -330,6 +533,43 @@ public:
 	if (this->delayed)
 	  this->delayed->pass2();
 	emit->bc_goto("__CIBYL_function_return");
+	return true;
+      }
+
+    /* Done here since all branch targets are known after pass1 */
+    if (config->optimizeJumpTables)
+      this->recoverJumpTable();
+
+    if (this->table)
+      {
+	char def[64];
+	char prefix[64];
+
+	/* Switch on the case index, anything else through the method
+	 * jumptab. The address is pushed before the delay slot as below,
+	 * so the cases pop it before going to the target */
+	xsnprintf(def, sizeof(def), "L_%x_jumptab_default", this->address);
+	xsnprintf(prefix, sizeof(prefix), "L_%x_case_", this->address);
+	emit->bc_pushregister( this->rs );
+	emit->bc_pushregister( this->indexRegister );
+	if (this->delayed)
+	  this->delayed->pass2();
+	emit->bc_tableswitch(0, this->n_table, this->table, def, prefix);
+	for (uint32_t i = 0; i < this->n_table; i++)
+	  {
+	    uint32_t j;
+
+	    /* Once per target */
+	    for (j = 0; j < i && this->table[j] != this->table[i]; j++)
+	      ;
+	    if (j < i)
+	      continue;
+	    emit->bc_label("%s%x", prefix, this->table[i]);
+	    emit->bc_pop();
+	    emit->bc_goto(this->table[i]);
+	  }
+	emit->bc_label("%s", def);
+	emit->bc_goto("__CIBYL_local_jumptab");
       }
     else
       {
@@ -341,6 +581,259 @@ public:
 
     return true;
   }
+
+private:
+  /**
+   * Get the instruction at @a addr. Delay slots are taken from the
+   * branch, which is returned in @a branch (NULL otherwise).
+   */
+  Instruction *getInstruction(uint32_t addr, Instruction **branch)
+  {
+    Instruction *insn = controller->getInstructionByAddress(addr);
+
+    *branch = NULL;
+    if (insn && insn->isDelaySlotNop())
+      {
+        *branch = controller->getInstructionByAddress(addr - 4);
+        insn = *branch ? (*branch)->getDelayed() : NULL;
+      }
+
+    return insn;
+  }
+
+  /* Calls and jumps, i.e., everything except conditional branches */
+  static bool isJumpOrCall(Instruction *insn)
+  {
+    switch (insn->getOpcode())
+      {
+      case OP_J:
+      case OP_JAL:
+      case OP_JALR:
+      case OP_JR:
+      case OP_BGEZAL:
+      case OP_BLTZAL:
+        return true;
+      default:
+        break;
+      }
+
+    return false;
+  }
+
+  /**
+   * Find the closest instruction before @a addr which writes @a reg.
+   * The delay slot of a conditional branch is executed on both paths,
+   * but the search stops at the branch.
+   *
+   * @return the instruction or NULL if it's not found in the window
+   */
+  Instruction *findRegisterWrite(uint32_t addr, MIPS_register_t reg)
+  {
+    for (uint32_t a = addr - 4; a >= this->windowStart && a < addr; a -= 4)
+      {
+        Instruction *branch;
+        Instruction *insn = this->getInstruction(a, &branch);
+        int p[N_REGS];
+
+        /* Calls clobber registers, jumps end the straight-line code */
+        if (!insn || insn->isBranch() || (branch && isJumpOrCall(branch)))
+          return NULL;
+
+        memset(p, 0, sizeof(p));
+        insn->fillDestinations(p);
+        if (p[reg])
+          return insn;
+        if (branch)
+          return NULL;
+      }
+
+    return NULL;
+  }
+
+  void setChainStart(uint32_t addr)
+  {
+    if (addr < this->chainStart)
+      this->chainStart = addr;
+  }
+
+  /**
+   * Lookup the constant value of @a reg at @a addr from lui/addiu/ori
+   *
+   * @return true if the value is constant
+   */
+  bool getConstant(uint32_t addr, MIPS_register_t reg, uint32_t *out)
+  {
+    Instruction *insn;
+
+    if (reg == R_ZERO)
+      {
+        *out = 0;
+        return true;
+      }
+    insn = this->findRegisterWrite(addr, reg);
+    if (!insn)
+      return false;
+
+    switch (insn->getOpcode())
+      {
+      case OP_LUI:
+        *out = (uint32_t)insn->getExtra() << 16;
+        this->setChainStart(insn->getAddress());
+        return true;
+      case OP_ADDIU:
+      case OP_ORI:
+        if (!this->getConstant(insn->getAddress(), insn->getRs(), out))
+          return false;
+        if (insn->getOpcode() == OP_ADDIU)
+          *out += insn->getExtra();
+        else
+          *out |= insn->getExtra();
+        this->setChainStart(insn->getAddress());
+        return true;
+      default:
+        break;
+      }
+
+    return false;
+  }
+
+  /**
+   * Lookup the register which @a reg is the case index (<< 2) of
+   *
+   * @return the instruction shifting the index or NULL
+   */
+  Instruction *getScaledIndex(uint32_t addr, MIPS_register_t reg)
+  {
+    Instruction *insn = this->findRegisterWrite(addr, reg);
+
+    if (!insn || insn->getOpcode() != OP_SLL || insn->getExtra() != 2 ||
+        insn->getRt() == R_ZERO)
+      return NULL;
+
+    return insn;
+  }
+
+  /**
+   * Recognize the GCC jump table idiom
+   *
+   *   sltiu  t, idx, N
+   *   beqz   t, default
+   *   sll    a, idx, 2          (in the delay slot)
+   *   lui    b, %hi(table)
+   *   addiu  b, b, %lo(table)   (or as the lw offset)
+   *   addu   a, a, b
+   *   lw     rs, 0(a)
+   *   jr     rs
+   *
+   * and read the table from .rodata. The case index is then used for
+   * a tableswitch directly to the targets. Index values outside the
+   * table are still handled through the local jumptab, so the bounds
+   * check only gives the size of the table.
+   */
+  void recoverJumpTable()
+  {
+    JavaMethod *mt = controller->getMethodByAddress(this->address);
+    ElfSection *rodata = elf->getSection(".rodata");
+    Instruction *lw, *addu, *sll, *insn, *branch;
+    uint32_t base, tableAddr, n;
+    int p[N_REGS];
+
+    if (!mt || !rodata)
+      return;
+    this->windowStart = mt->getFunctionByAddress(this->address)->getAddress();
+    if (this->address - this->windowStart > JUMPTAB_WINDOW * 4)
+      this->windowStart = this->address - JUMPTAB_WINDOW * 4;
+
+    /* lw rs, off(a) */
+    lw = this->findRegisterWrite(this->address, this->rs);
+    if (!lw || lw->getOpcode() != OP_LW)
+      return;
+    this->chainStart = lw->getAddress();
+
+    /* addu a, x, y where one is the index and the other the table */
+    addu = this->findRegisterWrite(lw->getAddress(), lw->getRs());
+    if (!addu || addu->getOpcode() != OP_ADDU)
+      return;
+    this->chainStart = addu->getAddress();
+
+    sll = this->getScaledIndex(addu->getAddress(), addu->getRs());
+    if (sll && this->getConstant(addu->getAddress(), addu->getRt(), &base))
+      ;
+    else if ( (sll = this->getScaledIndex(addu->getAddress(), addu->getRt())) &&
+              this->getConstant(addu->getAddress(), addu->getRs(), &base) )
+      ;
+    else
+      return;
+    this->setChainStart(sll->getAddress());
+    tableAddr = base + lw->getExtra();
+
+    /* The index must be unchanged until the jump. This includes the
+     * sll itself, so sll idx, idx, 2 (the usual after a biased
+     * addiu idx, x, -min) is left to the local jumptab */
+    this->indexRegister = sll->getRt();
+    for (uint32_t a = sll->getAddress(); a <= this->address + 4; a += 4)
+      {
+        insn = this->getInstruction(a, &branch);
+        if (!insn)
+          return;
+        memset(p, 0, sizeof(p));
+        insn->fillDestinations(p);
+        if (p[this->indexRegister] || (a > this->address && p[this->rs]))
+          return;
+      }
+
+    /* Nothing may jump into the middle of the sequence */
+    for (uint32_t a = this->chainStart + 4; a <= this->address + 4; a += 4)
+      {
+        insn = controller->getInstructionByAddress(a);
+        if (!insn || insn->isBranchTarget() || controller->hasJumptabLabel(a))
+          return;
+      }
+
+    /* The bounds check gives the number of entries */
+    n = 0;
+    for (uint32_t a = sll->getAddress() - 4; a >= this->windowStart && a < sll->getAddress(); a -= 4)
+      {
+        insn = this->getInstruction(a, &branch);
+        if (!insn)
+          break;
+        if (insn->getOpcode() == OP_SLTIU && insn->getRs() == this->indexRegister)
+          {
+            n = (uint32_t)insn->getExtra();
+            break;
+          }
+        memset(p, 0, sizeof(p));
+        insn->fillDestinations(p);
+        if (p[this->indexRegister])
+          break;
+      }
+    if (n == 0 || n > JUMPTAB_MAX_SIZE ||
+        tableAddr < rodata->addr || tableAddr + n * 4 > rodata->addr + rodata->size ||
+        (tableAddr & 3) != 0)
+      return;
+
+    /* All targets must be labels in this method */
+    this->table = (uint32_t*)xcalloc(n, sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++)
+      {
+        uint32_t v = be32_to_host(((uint32_t*)(rodata->data + (tableAddr - rodata->addr)))[i]);
+
+        if (controller->getMethodByAddress(v) != mt || !controller->hasJumptabLabel(v))
+          {
+            free(this->table);
+            this->table = NULL;
+            return;
+          }
+        this->table[i] = v;
+      }
+    this->n_table = n;
+  }
+
+  uint32_t *table;
+  uint32_t n_table;
+  MIPS_register_t indexRegister;
+  uint32_t windowStart;
+  uint32_t chainStart;
 };
 
 
@@ -17,8 +17,16 @@ class MemoryXX : public Instruction
            MIPS_register_t rs, MIPS_register_t rt, int32_t extra) : Instruction(address, opcode, rs, rt, R_ZERO, extra)
     {
       this->method = NULL;
+      this->partner = NULL;
+      this->pairLeader = false;
+      this->baseLeader = NULL;
     }
 
+  void setBaseIndexLeader(Instruction *leader)
+  {
+    this->baseLeader = (MemoryXX*)leader;
+  }
+
   bool pass1()
   {
     this->method = controller->getMethodByAddress(this->address);
@@ -35,7 +43,149 @@ class MemoryXX : public Instruction
   }
 
  protected:
+  /*
+   * Return the bit shift of a byte/halfword in its word if it's known
+   * at translation time, or -1 otherwise. The stack pointer is always
+   * 8-byte aligned and R_ZERO-based addresses are constants, so for
+   * these the (address & 3) part depends only on the offset.
+   */
+  int getKnownShift(int word_size)
+  {
+    if (this->rs != R_SP && this->rs != R_ZERO)
+      return -1;
+
+    if (word_size == 8)
+      return (3 - (this->extra & 3)) * 8;
+
+    return (2 - (this->extra & 2)) * 8;
+  }
+
+  /* With the byte memory model: push the byte at rs + extra + offset */
+  void pushByte(int offset)
+  {
+    emit->bc_pushregister(R_MEM);
+    emit->bc_pushaddress(this->rs, this->extra + offset);
+    emit->bc_baload();
+  }
+
+  /* ... and store (rt >> shift) there */
+  void storeByte(int offset, int shift)
+  {
+    emit->bc_pushregister(R_MEM);
+    emit->bc_pushaddress(this->rs, this->extra + offset);
+    emit->bc_pushregister(this->rt);
+    if (shift != 0)
+      {
+        emit->bc_pushconst(shift);
+        emit->bc_ishr();
+      }
+    emit->bc_bastore();
+  }
+
+  /*
+   * Pair this lwl/lwr (or swl/swr) with the complementary instruction
+   * following it if the two access the same word with the same base
+   * and register, i.e., "lwl rt,N(rs); lwr rt,N+3(rs)" in any order.
+   * The first one of the pair does the whole unaligned access and the
+   * second is left empty.
+   */
+  void pairUnaligned(int left, int right)
+  {
+    Instruction *next = controller->getInstructionByAddress(this->address + 4);
+    int32_t left_extra, right_extra;
+
+    /* Already paired with the previous, or in a delay slot */
+    if (this->partner ||
+        controller->getInstructionByAddress(this->address) != this)
+      return;
+    if (!next || next->getOpcode() != (this->opcode == left ? right : left) ||
+        next->isBranchTarget() || controller->hasJumptabLabel(next->getAddress()) ||
+        next->getRs() != this->rs || next->getRt() != this->rt)
+      return;
+    /* The load overwrites the base register */
+    if (this->opcode == OP_LWL || this->opcode == OP_LWR)
+      {
+        if (this->rs == this->rt)
+          return;
+      }
+
+    left_extra = this->opcode == left ? this->extra : next->getExtra();
+    right_extra = this->opcode == left ? next->getExtra() : this->extra;
+    if (left_extra + 3 != right_extra)
+      return;
+
+    this->partner = (MemoryXX*)next;
+    this->pairLeader = true;
+    this->partner->partner = this;
+  }
+
+  /* The offset of the paired access, i.e., that of the lwl/swl */
+  int32_t getPairExtra(int left)
+  {
+    if (this->opcode == left)
+      return this->extra;
+    return this->partner->getExtra();
+  }
+
+  /* A paired access known to be word-aligned is a plain lw/sw */
+  bool pairIsAligned(int left)
+  {
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      return false;
+
+    return (this->rs == R_SP || this->rs == R_ZERO) &&
+      (this->getPairExtra(left) & 3) == 0;
+  }
+
+  /*
+   * Push the word index of rs + extra. With a shared base index, the
+   * leader also keeps its index in R_BIX and the others add their word
+   * offset from the leader to it. The offsets all have the same
+   * remainder modulo 4, so the difference is exact.
+   */
+  void pushIndex()
+  {
+    int32_t delta;
+
+    if (!this->baseLeader)
+      {
+        emit->bc_pushindex(this->rs, this->extra);
+        return;
+      }
+    if (this->baseLeader == this)
+      {
+        emit->bc_pushindex(this->rs, this->extra);
+        emit->bc_dup();
+        emit->bc_popregister(R_BIX);
+        return;
+      }
+    delta = (this->extra - this->baseLeader->getExtra()) / 4;
+    emit->bc_pushregister(R_BIX);
+    if (delta != 0)
+      {
+        emit->bc_pushconst(delta);
+        emit->bc_iadd();
+      }
+  }
+
+  int addBaseIndexSource(int *p)
+  {
+    if (this->baseLeader && this->baseLeader != this)
+      return this->addToRegisterUsage(R_BIX, p);
+    return 0;
+  }
+
+  int addBaseIndexDestination(int *p)
+  {
+    if (this->baseLeader == this)
+      return this->addToRegisterUsage(R_BIX, p);
+    return 0;
+  }
+
   JavaMethod *method;
+  MemoryXX *partner; /* For lwl/lwr and swl/swr pairs */
+  bool pairLeader;
+  MemoryXX *baseLeader; /* For lw/sw sharing the word index */
 };
 
 class LoadXX : public MemoryXX
@@ -99,16 +249,33 @@ public:
 
     emit->bc_pushaddress( this->rs, this->extra );
     emit->bc_pushregister( this->rt );
-    emit->bc_invokestatic("%sCRunTime/memoryWrite%s(II)V",
-        controller->getJasminPackagePath(), this->bc);
+    /* Either a call to a subroutine or a regular function call */
+    if ( this->usesSubroutine() )
+      emit->bc_jsr("__CIBYL_memoryWrite%s", this->bc);
+    else
+      emit->bc_invokestatic("%sCRunTime/memoryWrite%s(II)V",
+          controller->getJasminPackagePath(), this->bc);
     return true;
   }
 
+  int fillDestinations(int *p)
+  {
+    if ( this->usesSubroutine() )
+      return this->addToRegisterUsage(R_MADR, p);
+
+    return 0;
+  }
+
   int fillSources(int *p)
   {
     return this->addToRegisterUsage(this->rs, p) + this->addToRegisterUsage(this->rt, p) + this->addToRegisterUsage(R_MEM, p);
   };
 protected:
+  bool usesSubroutine()
+  {
+    return config->optimizePartialMemoryOps &&
+      (this->opcode == OP_SB || this->opcode == OP_SH);
+  }
 
   void traceStore()
   {
@@ -151,6 +318,19 @@ public:
   Lw(uint32_t address, int opcode,
      MIPS_register_t rs, MIPS_register_t rt, int32_t extra) : LoadXX("", address, opcode, rs, rt, extra)
   {
+    this->forwarded = false;
+    this->forwardedValue = R_ZERO;
+  }
+
+  void setForwardedValue(MIPS_register_t reg)
+  {
+    this->forwarded = true;
+    this->forwardedValue = reg;
+  }
+
+  bool hasForwardedValue()
+  {
+    return this->forwarded;
   }
 
   bool pass2()
@@ -161,17 +341,66 @@ public:
 
     if (this->prefix)
       this->prefix->pass2();
+    if (this->forwarded)
+      {
+        if (this->forwardedValue != this->rt)
+          {
+            emit->bc_pushregister( this->forwardedValue );
+            emit->bc_popregister( this->rt );
+          }
+        return true;
+      }
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      {
+        /* Big-endian, b0 << 24 | b1 << 16 | b2 << 8 | b3 */
+        this->pushByte(0);
+        emit->bc_pushconst(24);
+        emit->bc_ishl();
+        for (int i = 1; i < 4; i++)
+          {
+            this->pushByte(i);
+            emit->bc_pushconst(0xff);
+            emit->bc_iand();
+            if (i != 3)
+              {
+                emit->bc_pushconst(24 - i * 8);
+                emit->bc_ishl();
+              }
+            emit->bc_ior();
+          }
+        emit->bc_popregister( this->rt );
+        return true;
+      }
     emit->bc_pushregister( R_MEM );
-    emit->bc_pushindex( this->rs, this->extra );
+    this->pushIndex();
     emit->bc_iaload();
     emit->bc_popregister( this->rt );
     return true;
   }
 
+  int fillDestinations(int *p)
+  {
+    return LoadXX::fillDestinations(p) + this->addBaseIndexDestination(p);
+  }
+
+  int fillSources(int *p)
+  {
+    if (this->forwarded)
+      return this->addToRegisterUsage(this->forwardedValue, p);
+
+    return LoadXX::fillSources(p) + this->addBaseIndexSource(p);
+  }
+
   virtual size_t getBytecodeSize(void)
   {
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      return 48;
     return 11;
   };
+
+private:
+  bool forwarded;
+  MIPS_register_t forwardedValue;
 };
 
 class PartialLoad : public LoadXX
@@ -195,6 +424,10 @@ protected:
              "No method for instruction at 0x%x\n",
              this->getAddress());
 
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      return this->pass2ByteMemory();
+    if (this->getKnownShift(this->word_size) >= 0)
+      return this->pass2KnownShift(this->getKnownShift(this->word_size));
     if ( config->optimizePartialMemoryOps ||
          !config->optimizeInlines)
       return LoadXX::pass2();
@@ -212,13 +445,9 @@ protected:
       }
 
     int b_v = 3; /* Assume lb(u) */
-    unsigned int mask_val = 0xff;
 
     if (this->word_size == 16)
-      {
-        b_v = 2;
-        mask_val = 0xffff;
-      }
+      b_v = 2;
     /* Maybe skip ra */
     if (this->rt == R_RA && !this->method->hasMultipleFunctions())
       return true;
@@ -247,6 +476,64 @@ protected:
 
     /* out = (val >>> b) & 0xff */
     emit->bc_iushr();
+    this->convertResult();
+    emit->bc_popregister( this->rt );
+
+    return true;
+  }
+
+  /* out = (mem[addr >>> 2] >>> shift) & 0xff, no runtime alignment check */
+  bool pass2KnownShift(int shift)
+  {
+    /* Maybe skip ra */
+    if (this->rt == R_RA && !this->method->hasMultipleFunctions())
+      return true;
+
+    emit->bc_pushregister(R_MEM);
+    emit->bc_pushindex(this->rs, this->extra & ~3);
+    emit->bc_iaload();
+    if (shift != 0)
+      {
+        emit->bc_pushconst(shift);
+        emit->bc_iushr();
+      }
+    this->convertResult();
+    emit->bc_popregister( this->rt );
+
+    return true;
+  }
+
+  /* baload sign-extends, so only the low byte needs masking */
+  bool pass2ByteMemory()
+  {
+    /* Maybe skip ra */
+    if (this->rt == R_RA && !this->method->hasMultipleFunctions())
+      return true;
+
+    this->pushByte(0);
+    if (this->word_size == 16)
+      {
+        emit->bc_pushconst(8);
+        emit->bc_ishl();
+        this->pushByte(1);
+        emit->bc_pushconst(0xff);
+        emit->bc_iand();
+        emit->bc_ior();
+        if (!this->is_signed) /* lhu */
+          emit->bc_i2c();
+      }
+    else if (!this->is_signed) /* lbu */
+      {
+        emit->bc_pushconst(0xff);
+        emit->bc_iand();
+      }
+    emit->bc_popregister( this->rt );
+
+    return true;
+  }
+
+  void convertResult()
+  {
     if (this->word_size == 8 && this->is_signed) /* lb */
       emit->bc_i2b();
     else if (this->word_size == 16 && !this->is_signed) /* lhu */
@@ -255,12 +542,9 @@ protected:
       emit->bc_i2s();
     else /* lbu */
       {
-        emit->bc_pushconst(mask_val);
+        emit->bc_pushconst(0xff);
         emit->bc_iand();
       }
-    emit->bc_popregister( this->rt );
-
-    return true;
   }
 
   virtual size_t getBytecodeSize(void)
@@ -268,6 +552,15 @@ protected:
     return 24;
   };
 
+  virtual int fillDestinations(int *p)
+  {
+    if (config->memoryModel == MEMORY_MODEL_BYTE ||
+        this->getKnownShift(this->word_size) >= 0)
+      return this->addToRegisterUsage(this->rt, p);
+
+    return LoadXX::fillDestinations(p);
+  }
+
   virtual size_t getMaxStackHeight()
   {
     return 5;
@@ -298,6 +591,18 @@ protected:
              "No method for instruction at 0x%x\n",
              this->getAddress());
 
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      {
+        if (config->traceStores)
+          this->traceStore();
+        /* bastore truncates, so sh is just two byte stores */
+        if (this->word_size == 16)
+          this->storeByte(0, 8);
+        this->storeByte(this->word_size == 16 ? 1 : 0, 0);
+        return true;
+      }
+    if (this->getKnownShift(this->word_size) >= 0)
+      return this->pass2KnownShift(this->getKnownShift(this->word_size));
     if ( config->optimizePartialMemoryOps ||
          !config->optimizeInlines)
       return StoreXX::pass2();
@@ -375,6 +680,44 @@ protected:
     return true;
   }
 
+  /* cur = (cur & ~(0xff << shift)) | ((rt & 0xff) << shift) with a constant shift */
+  bool pass2KnownShift(int shift)
+  {
+    uint32_t mask_val = this->word_size == 8 ? 0xff : 0xffff;
+
+    if (config->traceStores)
+      this->traceStore();
+
+    emit->bc_pushregister(R_MEM);
+    emit->bc_pushindex(this->rs, this->extra & ~3);
+    emit->bc_dup2();
+    emit->bc_iaload();
+    emit->bc_pushconst(~(mask_val << shift));
+    emit->bc_iand();
+
+    emit->bc_pushregister( this->rt );
+    emit->bc_pushconst(mask_val);
+    emit->bc_iand();
+    if (shift != 0)
+      {
+        emit->bc_pushconst(shift);
+        emit->bc_ishl();
+      }
+    emit->bc_ior();
+    emit->bc_iastore();
+
+    return true;
+  }
+
+  virtual int fillDestinations(int *p)
+  {
+    if (config->memoryModel == MEMORY_MODEL_BYTE ||
+        this->getKnownShift(this->word_size) >= 0)
+      return 0;
+
+    return StoreXX::fillDestinations(p);
+  }
+
   virtual size_t getBytecodeSize(void)
   {
     return 32;
@@ -465,15 +808,33 @@ public:
 
     if (this->prefix)
       this->prefix->pass2();
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      {
+        for (int i = 0; i < 4; i++)
+          this->storeByte(i, 24 - i * 8);
+        return true;
+      }
     emit->bc_pushregister( R_MEM );
-    emit->bc_pushindex( this->rs, this->extra );
+    this->pushIndex();
     emit->bc_pushregister( this->rt );
     emit->bc_iastore();
     return true;
   }
 
+  int fillDestinations(int *p)
+  {
+    return StoreXX::fillDestinations(p) + this->addBaseIndexDestination(p);
+  }
+
+  int fillSources(int *p)
+  {
+    return StoreXX::fillSources(p) + this->addBaseIndexSource(p);
+  }
+
   virtual size_t getBytecodeSize(void)
   {
+    if (config->memoryModel == MEMORY_MODEL_BYTE)
+      return 44;
     return 11;
   };
 };
@@ -511,3 +872,133 @@ public:
     return true;
   }
 };
+
+class UnalignedLoad : public LoadXX
+{
+public:
+  UnalignedLoad(uint32_t address, int opcode,
+                MIPS_register_t rs, MIPS_register_t rt, int32_t extra) : LoadXX(opcode == OP_LWL ? "WordLeftPart" : "WordRightPart",
+                                                                                   address, opcode, rs, rt, extra)
+  {
+  }
+
+  void pairUnalignedAccess()
+  {
+    this->pairUnaligned(OP_LWL, OP_LWR);
+  }
+
+  bool pass2()
+  {
+    /* Done by the first instruction of the pair */
+    if (this->partner && !this->pairLeader)
+      return true;
+
+    if (!this->partner)
+      {
+        emit->bc_pushaddress( this->rs, this->extra );
+        emit->bc_pushregister( this->rt );
+        emit->bc_invokestatic("%sCRunTime/memoryRead%s(II)I",
+            controller->getJasminPackagePath(), this->bc);
+      }
+    else if (this->pairIsAligned(OP_LWL))
+      {
+        emit->bc_pushregister( R_MEM );
+        emit->bc_pushindex( this->rs, this->getPairExtra(OP_LWL) );
+        emit->bc_iaload();
+      }
+    else
+      {
+        emit->bc_pushaddress( this->rs, this->getPairExtra(OP_LWL) );
+        emit->bc_invokestatic("%sCRunTime/memoryReadWordLeft(I)I",
+            controller->getJasminPackagePath());
+      }
+    emit->bc_popregister( this->rt );
+
+    return true;
+  }
+
+  int fillDestinations(int *p)
+  {
+    if (this->partner && !this->pairLeader)
+      return 0;
+
+    return this->addToRegisterUsage(this->rt, p);
+  }
+
+  int fillSources(int *p)
+  {
+    if (this->partner && !this->pairLeader)
+      return 0;
+    /* Unpaired instructions keep part of rt */
+    if (!this->partner)
+      return LoadXX::fillSources(p) + this->addToRegisterUsage(this->rt, p);
+
+    return LoadXX::fillSources(p);
+  };
+};
+
+class UnalignedStore : public StoreXX
+{
+public:
+  UnalignedStore(uint32_t address, int opcode,
+                 MIPS_register_t rs, MIPS_register_t rt, int32_t extra) : StoreXX(opcode == OP_SWL ? "WordLeftPart" : "WordRightPart",
+                                                                                    address, opcode, rs, rt, extra)
+  {
+  }
+
+  void pairUnalignedAccess()
+  {
+    this->pairUnaligned(OP_SWL, OP_SWR);
+  }
+
+  bool pass2()
+  {
+    int32_t extra;
+
+    if (this->partner && !this->pairLeader)
+      return true;
+
+    if (!this->partner)
+      {
+        emit->bc_pushaddress( this->rs, this->extra );
+        emit->bc_pushregister( this->rt );
+        emit->bc_invokestatic("%sCRunTime/memoryWrite%s(II)V",
+            controller->getJasminPackagePath(), this->bc);
+        return true;
+      }
+
+    extra = this->getPairExtra(OP_SWL);
+    if (config->traceStores)
+      {
+        emit->bc_pushconst( this->address );
+        emit->bc_pushaddress( this->rs, extra );
+        emit->bc_pushregister( this->rt );
+        emit->bc_invokestatic("%sCRunTime/memoryWriteWordLeftPc(III)V",
+            controller->getJasminPackagePath());
+      }
+    else if (this->pairIsAligned(OP_SWL))
+      {
+        emit->bc_pushregister( R_MEM );
+        emit->bc_pushindex( this->rs, extra );
+        emit->bc_pushregister( this->rt );
+        emit->bc_iastore();
+      }
+    else
+      {
+        emit->bc_pushaddress( this->rs, extra );
+        emit->bc_pushregister( this->rt );
+        emit->bc_invokestatic("%sCRunTime/memoryWriteWordLeft(II)V",
+            controller->getJasminPackagePath());
+      }
+
+    return true;
+  }
+
+  int fillSources(int *p)
+  {
+    if (this->partner && !this->pairLeader)
+      return 0;
+
+    return StoreXX::fillSources(p);
+  };
+};
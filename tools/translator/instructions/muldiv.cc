@@ -69,6 +69,188 @@ public:
     return 6;
   }
 protected:
+  /*
+   * Basic blocks are split before the branch targets are known, so
+   * the previous write @a w in the basic block is only the one which
+   * reaches @a insn if nothing after it up to @a insn is a target.
+   */
+  static bool onlyReachedFrom(Instruction *insn, Instruction *w)
+  {
+    if (w->getAddress() >= insn->getAddress())
+      return false;
+
+    for (uint32_t addr = w->getAddress() + 4; addr <= insn->getAddress(); addr += 4)
+      {
+        Instruction *cur = controller->getInstructionByAddress(addr);
+
+        if (!cur || cur->isBranchTarget() || controller->hasJumptabLabel(addr))
+          return false;
+      }
+
+    return true;
+  }
+
+  /*
+   * Get the value of the register @a which of @a insn if it's set to a
+   * constant earlier in the basic block, i.e., by li (addiu/ori from
+   * zero) or a lui/ori pair.
+   */
+  static bool lookupConstant(Instruction *insn, mips_register_type_t which, int32_t *out)
+  {
+    Instruction *w;
+    int32_t base = 0;
+
+    if (insn->getRegister(which) == R_ZERO)
+      {
+        *out = 0;
+        return true;
+      }
+
+    w = insn->getPrevRegisterWrite(which);
+    if (!w || !onlyReachedFrom(insn, w))
+      return false;
+
+    switch (w->getOpcode())
+      {
+      case OP_LUI:
+        *out = (int32_t)((uint32_t)w->getExtra() << 16);
+        return true;
+      case OP_ADDI:
+      case OP_ADDIU:
+      case OP_ORI:
+        if (w->getRs() != R_ZERO && !lookupConstant(w, I_RS, &base))
+          return false;
+        if (w->getOpcode() == OP_ORI)
+          *out = base | w->getExtra();
+        else
+          *out = (int32_t)((uint32_t)base + (uint32_t)w->getExtra());
+        return true;
+      default:
+        return false;
+      }
+  }
+
+  /* Find an operand which is constant, and the other one */
+  bool lookupConstantOperand(MIPS_register_t *other, int32_t *value)
+  {
+    if (!config->optimizeConstantMulDiv)
+      return false;
+
+    if (lookupConstant(this, I_RT, value))
+      {
+        *other = this->rs;
+        return true;
+      }
+    if (lookupConstant(this, I_RS, value))
+      {
+        *other = this->rt;
+        return true;
+      }
+
+    return false;
+  }
+
+  /* @return log2 of @a v if it's a power of two, otherwise -1 */
+  static int log2Exact(uint32_t v)
+  {
+    int out = 0;
+
+    if (v == 0 || (v & (v - 1)) != 0)
+      return -1;
+    while (v >>= 1)
+      out++;
+
+    return out;
+  }
+
+  /* Push the low word of @a reg * @a c, with shifts and adds if possible */
+  void pushMultiplyByConstant(MIPS_register_t reg, int32_t c)
+  {
+    uint32_t a = c < 0 ? -(uint32_t)c : (uint32_t)c;
+
+    if (c == 0)
+      {
+        emit->bc_pushconst(0);
+        return;
+      }
+    if (log2Exact(a) >= 0)
+      {
+        emit->bc_pushregister(reg);
+        if (a != 1)
+          {
+            emit->bc_pushconst(log2Exact(a));
+            emit->bc_ishl();
+          }
+      }
+    else if (log2Exact(a - 1) > 0)
+      {
+        /* (x << k) + x */
+        emit->bc_pushregister(reg);
+        emit->bc_pushconst(log2Exact(a - 1));
+        emit->bc_ishl();
+        emit->bc_pushregister(reg);
+        emit->bc_iadd();
+      }
+    else if (log2Exact(a + 1) > 0)
+      {
+        /* (x << k) - x */
+        emit->bc_pushregister(reg);
+        emit->bc_pushconst(log2Exact(a + 1));
+        emit->bc_ishl();
+        emit->bc_pushregister(reg);
+        emit->bc_isub();
+      }
+    else
+      {
+        emit->bc_pushregister(reg);
+        emit->bc_pushconst(c);
+        emit->bc_imul();
+        return;
+      }
+    if (c < 0)
+      emit->bc_ineg();
+  }
+
+  /*
+   * For a power of two multiplier 2^k, hi is x >> (32 - k) and lo is
+   * x << k (with k > 0, hi is 0 or -1 for k = 0). Returns false for
+   * other values.
+   */
+  bool emitMultiplyByPowerOfTwo(MIPS_register_t reg, int32_t c, bool is_unsigned)
+  {
+    int k = log2Exact((uint32_t)c);
+
+    /* 0x80000000 is negative for mult */
+    if (k < 0 || (k == 31 && !is_unsigned))
+      return false;
+
+    if (k == 0)
+      {
+        if (is_unsigned)
+          emit->bc_pushconst(0);
+        else
+          {
+            emit->bc_pushregister(reg);
+            emit->bc_pushconst(31);
+            emit->bc_ishr();
+          }
+      }
+    else
+      {
+        emit->bc_pushregister(reg);
+        emit->bc_pushconst(32 - k);
+        if (is_unsigned)
+          emit->bc_iushr();
+        else
+          emit->bc_ishr();
+      }
+    emit->bc_popregister(R_HI);
+    this->pushMultiplyByConstant(reg, c);
+    emit->bc_popregister(R_LO);
+
+    return true;
+  }
+
   bool using_hi, using_lo;
   const char *bc;
 };
@@ -83,6 +265,21 @@ public:
 
   bool pass2()
   {
+    MIPS_register_t other;
+    int32_t c;
+
+    if (this->lookupConstantOperand(&other, &c))
+      {
+        if (this->using_hi == false)
+          {
+            this->pushMultiplyByConstant(other, c);
+            emit->bc_popregister( R_LO );
+            return true;
+          }
+        if (this->emitMultiplyByPowerOfTwo(other, c, false))
+          return true;
+      }
+
     if (this->using_lo && this->using_hi == false)
       {
         /* Just calculate the low parts */
@@ -121,6 +318,46 @@ public:
   }
 };
 
+class Multu : public Mult
+{
+public:
+  Multu(uint32_t address, int opcode,
+        MIPS_register_t rs, MIPS_register_t rt) : Mult(address, opcode, rs, rt)
+  {
+    this->bc = "multu";
+  }
+
+  bool pass2()
+  {
+    MIPS_register_t other;
+    int32_t c;
+
+    if (this->lookupConstantOperand(&other, &c))
+      {
+        if (this->using_hi == false)
+          {
+            this->pushMultiplyByConstant(other, c);
+            emit->bc_popregister( R_LO );
+            return true;
+          }
+        if (this->emitMultiplyByPowerOfTwo(other, c, true))
+          return true;
+      }
+
+    /* The low word is the same as for signed multiplication */
+    if (this->using_lo && this->using_hi == false)
+      {
+        emit->bc_pushregister( this->rs );
+        emit->bc_pushregister( this->rt );
+        emit->bc_imul();
+        emit->bc_popregister( R_LO );
+        return true;
+      }
+
+    return MulDiv::pass2();
+  }
+};
+
 
 class Div : public MulDiv
 {
@@ -132,6 +369,12 @@ public:
 
   bool pass2()
   {
+    int32_t d;
+
+    if (config->optimizeConstantMulDiv &&
+        lookupConstant(this, I_RT, &d) && this->emitDivideByConstant(d))
+      return true;
+
     if (this->using_lo == true && this->using_hi == false)
       {
         /* Only div */
@@ -175,6 +418,157 @@ public:
 
     return out;
   }
+
+protected:
+  /*
+   * Push rs / d, rounded towards zero. Powers of two are shifts with
+   * negative dividends rounded up, other divisors a multiplication by
+   * M = 2^(31 + l) / d + 1 with l = ceil(log2(|d|)). See Granlund and
+   * Montgomery, "Division by invariant integers using multiplication".
+   */
+  void pushQuotient(int32_t d)
+  {
+    uint32_t a = d < 0 ? -(uint32_t)d : (uint32_t)d;
+    int k = log2Exact(a);
+
+    if (k >= 0)
+      {
+        /* (x + (x < 0 ? 2^k - 1 : 0)) >> k */
+        emit->bc_pushregister( this->rs );
+        emit->bc_pushregister( this->rs );
+        if (k > 1)
+          {
+            emit->bc_pushconst(31);
+            emit->bc_ishr();
+          }
+        emit->bc_pushconst(32 - k);
+        emit->bc_iushr();
+        emit->bc_iadd();
+        emit->bc_pushconst(k);
+        emit->bc_ishr();
+      }
+    else
+      {
+        int l = 0;
+
+        while ((1U << l) < a)
+          l++;
+
+        /* ((x * M) >> (31 + l)) + (x < 0 ? 1 : 0) */
+        emit->bc_pushregister( this->rs );
+        emit->bc_i2l();
+        emit->bc_pushconst_l(((uint64_t)1 << (31 + l)) / a + 1);
+        emit->bc_lmul();
+        emit->bc_pushconst(31 + l);
+        emit->bc_lshr();
+        emit->bc_l2i();
+        emit->bc_pushregister( this->rs );
+        emit->bc_pushconst(31);
+        emit->bc_iushr();
+        emit->bc_iadd();
+      }
+    if (d < 0)
+      emit->bc_ineg();
+  }
+
+  bool emitDivideByConstant(int32_t d)
+  {
+    /* 0 traps and -1 can overflow, leave these to idiv */
+    if (d == 0 || d == -1 || d == (int32_t)0x80000000)
+      return false;
+
+    if (d == 1)
+      {
+        if (this->using_lo)
+          {
+            emit->bc_pushregister( this->rs );
+            emit->bc_popregister( R_LO );
+          }
+        if (this->using_hi)
+          {
+            emit->bc_pushconst(0);
+            emit->bc_popregister( R_HI );
+          }
+        return true;
+      }
+
+    if (!this->using_hi)
+      {
+        this->pushQuotient(d);
+        emit->bc_popregister( R_LO );
+        return true;
+      }
+
+    /* hi = x - (x / d) * d */
+    if (this->using_lo)
+      {
+        this->pushQuotient(d);
+        emit->bc_dup();
+        emit->bc_popregister( R_LO );
+        emit->bc_pushconst(d);
+        emit->bc_imul();
+        emit->bc_pushregister( this->rs );
+        emit->bc_swap();
+      }
+    else
+      {
+        emit->bc_pushregister( this->rs );
+        this->pushQuotient(d);
+        emit->bc_pushconst(d);
+        emit->bc_imul();
+      }
+    emit->bc_isub();
+    emit->bc_popregister( R_HI );
+
+    return true;
+  }
+};
+
+class Divu : public Div
+{
+public:
+  Divu(uint32_t address, int opcode,
+       MIPS_register_t rs, MIPS_register_t rt) : Div(address, opcode, rs, rt)
+  {
+    this->bc = "divu";
+  }
+
+  bool pass2()
+  {
+    int32_t d;
+    int k;
+
+    /* Powers of two are shifts and masks */
+    if (config->optimizeConstantMulDiv &&
+        lookupConstant(this, I_RT, &d) && (k = log2Exact((uint32_t)d)) >= 0)
+      {
+        if (this->using_lo)
+          {
+            emit->bc_pushregister( this->rs );
+            if (k > 0)
+              {
+                emit->bc_pushconst(k);
+                emit->bc_iushr();
+              }
+            emit->bc_popregister( R_LO );
+          }
+        if (this->using_hi)
+          {
+            emit->bc_pushregister( this->rs );
+            emit->bc_pushconst_u((uint32_t)d - 1);
+            emit->bc_iand();
+            emit->bc_popregister( R_HI );
+          }
+        return true;
+      }
+
+    return MulDiv::pass2();
+  }
+
+  int fillDestinations(int *p)
+  {
+    return MulDiv::fillDestinations(p);
+  }
 };
 
 
@@ -10,95 +10,303 @@
  *
  ********************************************************************/
 #include <controller.hh>
+#include <syscall-wrappers.hh>
 
-Syscall::Syscall(const char *name, int nrArguments, char returnValue)
+Syscall::Syscall(cibyl_db_entry_t *p, SyscallWrapperGenerator *wrappers)
 {
-  int len = strlen(name) + strlen(controller->getJasminPackagePath()) +
-      nrArguments + 4 + strlen("Syscalls/");
-  int i, n;
-
-  this->javaSignature = (char*)xcalloc( len, sizeof(char) );
-  n = snprintf(this->javaSignature, len, "%sSyscalls/%s(",
-      controller->getJasminPackagePath(), name);
-  for (i = 0; i < nrArguments; i++)
-    this->javaSignature[n + i] = 'I';
-  this->javaSignature[n + i] = ')';
-  i++;
-  this->javaSignature[n + i] = returnValue;
-
-  this->returnValue = returnValue;
-  this->nrArguments = nrArguments;
+  this->name = p->name;
+  this->nrArguments = p->nrArgs;
+  this->returnValue = p->returns ? 'I' : 'V';
+  this->invokeType = SYSCALL_INVOKE_WRAPPER;
+  this->argumentClasses = (const char**)xcalloc(p->nrArgs + 1, sizeof(const char*));
+
+  if (!wrappers->canInline(p))
+    {
+      int len = strlen(p->name) + strlen(controller->getJasminPackagePath()) +
+        this->nrArguments + 4 + strlen("Syscalls/");
+      int i, n;
+
+      this->javaSignature = (char*)xcalloc( len, sizeof(char) );
+      n = snprintf(this->javaSignature, len, "%sSyscalls/%s(",
+                   controller->getJasminPackagePath(), p->name);
+      for (i = 0; i < this->nrArguments; i++)
+        this->javaSignature[n + i] = 'I';
+      this->javaSignature[n + i] = ')';
+      i++;
+      this->javaSignature[n + i] = this->returnValue;
+
+      return;
+    }
+
+  /* Inlined, call the Java method directly */
+  char buf[2048];
+  bool isInterface;
+  const char *cls = wrappers->lookupJvmClass(p->javaClass, &isInterface);
+  int first = 0;
+
+  this->invokeType = SYSCALL_INVOKE_STATIC;
+  if (wrappers->isObjectCall(p))
+    {
+      /* The object is the first argument and not part of the signature */
+      this->invokeType = isInterface ? SYSCALL_INVOKE_INTERFACE : SYSCALL_INVOKE_VIRTUAL;
+      first = 1;
+    }
+
+  xsnprintf(buf, sizeof(buf), "%s/%s(", cls, p->javaMethod);
+  for (int i = 0; i < this->nrArguments; i++)
+    {
+      cibyl_db_arg_t *a = &p->args[i];
+      size_t n = strlen(buf);
+
+      /* canInline only allows ints and object references */
+      if (strcmp(a->type, a->javaType) != 0)
+        this->argumentClasses[i] = wrappers->lookupJvmClass(a->javaType, NULL);
+      if (i < first)
+        continue;
+      if (this->argumentClasses[i])
+        xsnprintf(buf + n, sizeof(buf) - n, "L%s;", this->argumentClasses[i]);
+      else
+        xsnprintf(buf + n, sizeof(buf) - n, "%s", "I");
+    }
+
+  size_t n = strlen(buf);
+  switch (p->returns)
+    {
+    case CIBYL_DB_RETURN_VOID:
+      xsnprintf(buf + n, sizeof(buf) - n, "%s", ")V"); break;
+    case CIBYL_DB_RETURN_INT:
+      xsnprintf(buf + n, sizeof(buf) - n, "%s", ")I"); break;
+    case CIBYL_DB_RETURN_BOOLEAN:
+      /* Booleans are 0/1 ints on the operand stack */
+      xsnprintf(buf + n, sizeof(buf) - n, "%s", ")Z"); break;
+    case CIBYL_DB_RETURN_OBJREF:
+      xsnprintf(buf + n, sizeof(buf) - n, ")L%s;",
+                wrappers->lookupJvmClass(p->returnType, NULL));
+      this->returnValue = 'L';
+      break;
+    default:
+      panic("Unknown return type %lu for %s\n", p->returns, p->name);
+    }
+
+  this->javaSignature = xstrdup(buf);
 }
 
-class SyscallInsn : public Instruction
+class SyscallRegisterArgument : public Instruction
 {
 public:
-  SyscallInsn(uint32_t address, int32_t extra) : Instruction(address,
-		  CIBYL_SYSCALL, R_ZERO, R_ZERO, R_ZERO, extra)
+  SyscallRegisterArgument(uint32_t address, int32_t extra) : Instruction(address,
+		  CIBYL_REGISTER_ARGUMENT, R_ZERO, R_ZERO, R_ZERO, extra)
   {
-    this->sysc = NULL;
+    this->argumentClass = NULL;
   }
 
   bool pass1()
   {
-    /* FIXME: Mark syscall used */
-    this->sysc = controller->getSyscall(this->extra);
     return true;
   }
 
   bool pass2()
   {
-    emit->bc_invokestatic( this->sysc->getJavaSignature() );
+    emit->bc_pushregister( (MIPS_register_t)this->extra );
+    if (!this->argumentClass)
+      return true;
 
-    if ( this->sysc->returnsValue() )
-      emit->bc_popregister( R_V0 );
+    /* Object argument to an inlined syscall, lookup the handle */
+    if (config->checkObjectHandles)
+      emit->bc_invokestatic("%sCRunTime/getRegisteredObject(I)Ljava/lang/Object;",
+          controller->getJasminPackagePath());
+    else
+      {
+        emit->bc_getstatic("%sCRunTime/objectRepository [Ljava/lang/Object;",
+            controller->getJasminPackagePath());
+        emit->bc_swap();
+        emit->bc_aaload();
+      }
+    emit->bc_checkcast(this->argumentClass);
     return true;
   }
 
-  int fillDestinations(int *p)
+  /**
+   * Set the class this argument is converted to (for inlined syscalls)
+   *
+   * @param cls the JVM class name
+   */
+  void setArgumentClass(const char *cls)
   {
-    if ( this->sysc->returnsValue() )
-      return this->addToRegisterUsage(R_V0, p);
-    return 0;
+    this->argumentClass = cls;
+  }
+
+  int fillSources(int *p)
+  {
+    return this->addToRegisterUsage((MIPS_register_t)this->extra, p);
   };
 
   size_t getMaxStackHeight()
   {
-    return max(this->sysc->getRegistersToPass(), 1);
+    return this->argumentClass ? 2 : 1;
   }
 
-protected:
-  Syscall *sysc;
+private:
+  const char *argumentClass;
 };
 
 
+/*
+ * The last write to @a reg before @a address in the straight-line
+ * code just before it, or NULL if there is none
+ */
+static Instruction *lookupPrevWrite(uint32_t address, MIPS_register_t reg)
+{
+  for (uint32_t addr = address - 4; ; addr -= 4)
+    {
+      Instruction *insn = controller->getInstructionByAddress(addr);
+      Instruction *prev = controller->getInstructionByAddress(addr - 4);
+      int dsts[N_REGS];
 
-class SyscallRegisterArgument : public Instruction
+      /* Don't look past branches and delay slots */
+      if (!insn || insn->isBranch() || (prev && prev->isBranch()))
+        return NULL;
+
+      memset(dsts, 0, sizeof(dsts));
+      insn->fillDestinations(dsts);
+      if (dsts[reg])
+        return insn;
+
+      if (insn->isBranchTarget() || controller->hasJumptabLabel(addr))
+        return NULL;
+    }
+}
+
+/* The constant value of @a reg at @a address from lui/addiu/ori */
+static bool lookupConstant(uint32_t address, MIPS_register_t reg, uint32_t *out)
+{
+  Instruction *insn;
+
+  if (reg == R_ZERO)
+    {
+      *out = 0;
+      return true;
+    }
+  insn = lookupPrevWrite(address, reg);
+  if (!insn)
+    return false;
+
+  switch (insn->getOpcode())
+    {
+    case OP_LUI:
+      *out = (uint32_t)insn->getExtra() << 16;
+      return true;
+    case OP_ADDIU:
+    case OP_ORI:
+      if (!lookupConstant(insn->getAddress(), insn->getRs(), out))
+        return false;
+      if (insn->getOpcode() == OP_ADDIU)
+        *out += insn->getExtra();
+      else
+        *out |= insn->getExtra();
+      return true;
+    default:
+      break;
+    }
+
+  return false;
+}
+
+class SyscallInsn : public Instruction
 {
 public:
-  SyscallRegisterArgument(uint32_t address, int32_t extra) : Instruction(address,
-		  CIBYL_REGISTER_ARGUMENT, R_ZERO, R_ZERO, R_ZERO, extra)
+  SyscallInsn(uint32_t address, int32_t extra) : Instruction(address,
+		  CIBYL_SYSCALL, R_ZERO, R_ZERO, R_ZERO, extra)
   {
+    this->sysc = NULL;
   }
 
   bool pass1()
   {
+    int n;
+
+    this->sysc = controller->getSyscall(this->extra);
+    if (strcmp(this->sysc->getName(), "NOPH_registerCallback") == 0)
+      this->lookupCallback();
+    if (!this->sysc->isInlined())
+      return true;
+
+    /* The arguments are pushed by the instructions just before */
+    n = this->sysc->getRegistersToPass();
+    for (int i = 0; i < n; i++)
+      {
+        const char *cls = this->sysc->getArgumentClass(i);
+        Instruction *insn;
+
+        if (!cls)
+          continue;
+        insn = controller->getInstructionByAddress(this->address - (n - i) * 4);
+        panic_if(!insn || insn->getOpcode() != CIBYL_REGISTER_ARGUMENT,
+                 "Syscall at 0x%x: argument %d is not a register argument\n",
+                 this->address, i);
+        ((SyscallRegisterArgument*)insn)->setArgumentClass(cls);
+      }
+
     return true;
   }
 
   bool pass2()
   {
-    emit->bc_pushregister( (MIPS_register_t)this->extra );
+    switch (this->sysc->getInvokeType())
+      {
+      case SYSCALL_INVOKE_VIRTUAL:
+        emit->bc_invokevirtual( this->sysc->getJavaSignature() );
+        break;
+      case SYSCALL_INVOKE_INTERFACE:
+        /* The object reference counts as an argument here */
+        emit->bc_invokeinterface( this->sysc->getRegistersToPass(),
+                                  this->sysc->getJavaSignature() );
+        break;
+      default:
+        emit->bc_invokestatic( this->sysc->getJavaSignature() );
+        break;
+      }
+    if ( this->sysc->returnsObject() )
+      emit->bc_invokestatic("%sCRunTime/registerObject(Ljava/lang/Object;)I",
+          controller->getJasminPackagePath());
+
+    if ( this->sysc->returnsValue() )
+      emit->bc_popregister( R_V0 );
     return true;
   }
 
-  int fillSources(int *p)
+  int fillDestinations(int *p)
   {
-    return this->addToRegisterUsage((MIPS_register_t)this->extra, p);
+    if ( this->sysc->returnsValue() )
+      return this->addToRegisterUsage(R_V0, p);
+    return 0;
   };
 
   size_t getMaxStackHeight()
   {
-    return 1;
+    /* Room for converting the last argument of an inlined call */
+    if (this->sysc->isInlined())
+      return this->sysc->getRegistersToPass() + 1;
+    return max(this->sysc->getRegistersToPass(), 1);
   }
+
+protected:
+  /*
+   * Give functions registered as callbacks a slot in the dense
+   * callback table. The function address is the last argument, in
+   * whatever register the inlined syscall wrapper got it. It is
+   * usually a lui/addiu constant set just before the call.
+   */
+  void lookupCallback()
+  {
+    Instruction *arg = controller->getInstructionByAddress(this->address - 4);
+    uint32_t fn;
+
+    if (!arg || arg->getOpcode() != CIBYL_REGISTER_ARGUMENT)
+      return;
+    if (lookupConstant(arg->getAddress(), (MIPS_register_t)arg->getExtra(), &fn))
+      controller->getCallTableMethod()->addCallback(fn);
+  }
+
+  Syscall *sysc;
 };
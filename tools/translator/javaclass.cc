@@ -17,6 +17,8 @@
 #include <javaclass.hh>
 #include <controller.hh>
 #include <emit.hh>
+#include <config.hh>
+#include <elf.hh>
 
 /* Some utilities */
 static int method_cmp(const void *_a, const void *_b)
@@ -186,12 +188,30 @@ bool CallTableClass::pass1()
 
 bool CallTableClass::pass2()
 {
+  ElfSection *rodata = elf->getSection(".rodata");
   bool out = true;
 
   if (controller->getPackageName() != NULL)
     emit->generic("package %s;\n", controller->getPackageName());
   emit->generic("public class CibylCallTable {\n");
 
+  /* Constants, so CRunTime only keeps the code for the selected options */
+  emit->generic("  public static final boolean byteMemory = %s;\n",
+                config->memoryModel == MEMORY_MODEL_BYTE ? "true" : "false");
+  emit->generic("  public static final boolean checkObjectHandles = %s;\n",
+                config->checkObjectHandles ? "true" : "false");
+  emit->generic("  public static final boolean threadSafe = %s;\n",
+                config->threadSafe ? "true" : "false");
+
+  /* Strings in this range are cached by CRunTime.charPtrToString */
+  if (config->cacheRodataStrings && rodata)
+    emit->generic("  public static final int rodataStart = 0x%x;\n"
+                  "  public static final int rodataEnd = 0x%x;\n\n",
+                  rodata->addr, rodata->addr + rodata->size);
+  else
+    emit->generic("  public static final int rodataStart = 0;\n"
+                  "  public static final int rodataEnd = 0;\n\n");
+
   out = this->methods[0]->pass2();
 
   emit->generic("}\n");
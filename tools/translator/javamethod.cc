@@ -15,6 +15,7 @@
 #include <controller.hh>
 #include <config.hh>
 #include <emit.hh>
+#include <stats.hh>
 
 bool ExceptionHandler::pass2()
 {
@@ -70,6 +71,7 @@ JavaMethod::JavaMethod(Function **fns,
   this->n_registersToPass = 0;
   this->registerIndirectJumps = false;
   this->m_returnSize = -1;
+  this->m_returnWritten = 0;
 
   this->m_possibleArguments = (MIPS_register_t*)xcalloc(7,
       sizeof(MIPS_register_t));
@@ -98,6 +100,11 @@ JavaMethod::JavaMethod(Function **fns,
   this->n_returnLocations = 0;
   this->returnLocations = NULL;
 
+  this->n_callSites = 0;
+  this->callSites = NULL;
+  this->m_callLiveness = false;
+  this->m_calledFromJava = false;
+
   /* Fixup the bytecode size */
   this->bc_size = 0;
   this->maxStackHeight = 0;
@@ -237,7 +244,16 @@ Function *JavaMethod::getFunctionByAddress(uint32_t addr)
     {
       Function *fn = this->functions[i];
 
-      if ( addr >= fn->getAddress() && addr <= fn->getAddress() + fn->getSize() )
+      if ( addr >= fn->getAddress() && addr < fn->getAddress() + fn->getSize() )
+        return fn;
+    }
+
+  /* The address just after the last instruction, e.g., a return address */
+  for (int i = 0; i < this->n_functions; i++)
+    {
+      Function *fn = this->functions[i];
+
+      if ( addr == fn->getAddress() + fn->getSize() )
         return fn;
     }
 
@@ -260,6 +276,62 @@ int JavaMethod::getFunctionIndexByAddress(uint32_t addr)
 
 void JavaMethod::emitStoreSubroutine(mips_opcode_t op)
 {
+  uint32_t and_value = 3; /* Assume byte*/
+  uint32_t mask_value = 0xff;
+
+  if (op == OP_SH)
+    {
+      and_value = 2;
+      mask_value = 0xffff;
+    }
+
+  /* Called with the address and the value to store below the return address */
+  emit->bc_label("__CIBYL_memoryWrite%s",
+                 op == OP_SB ? "Byte" : "Short");
+  emit->bc_astore( R_MADR );
+
+  /* val &= 0xff, then put the address on the top */
+  emit->bc_pushconst(mask_value);
+  emit->bc_iand();
+  emit->bc_swap();
+
+  /* Place CRunTime.memory and addr >>> 2 below the rest for the iastore */
+  emit->bc_dup();
+  emit->bc_pushconst(2);
+  emit->bc_iushr();
+  emit->bc_pushregister(R_MEM);
+  emit->bc_swap();
+  emit->bc_dup2_x2();    /* mem, idx, val, addr, mem, idx */
+  emit->bc_iaload();     /* mem, idx, val, addr, cur */
+
+  /* b = (3 - (address & 3)) * 8 */
+  emit->bc_swap();
+  emit->bc_pushconst(and_value);
+  emit->bc_iand();
+  emit->bc_pushconst(and_value);
+  emit->bc_swap();
+  emit->bc_isub();
+  emit->bc_pushconst(3);
+  emit->bc_ishl();
+  emit->bc_dup_x2();     /* mem, idx, b, val, cur, b */
+
+  /* cur &= ~(0xff << b) */
+  emit->bc_pushconst(mask_value);
+  emit->bc_swap();
+  emit->bc_ishl();
+  emit->bc_pushconst(-1);
+  emit->bc_ixor();
+  emit->bc_iand();       /* mem, idx, b, val, cur */
+
+  /* cur |= val << b */
+  emit->bc_dup_x2();
+  emit->bc_pop();        /* mem, idx, cur, b, val */
+  emit->bc_swap();
+  emit->bc_ishl();
+  emit->bc_ior();
+
+  emit->bc_iastore();
+  emit->bc_ret( R_MADR );
 }
 
 void JavaMethod::emitLoadSubroutine(mips_opcode_t op)
@@ -337,12 +409,17 @@ void JavaMethod::emitSubroutineForOp(mips_opcode_t op)
     this->emitStoreSubroutine(op);
 }
 
-void JavaMethod::emitSubroutines()
+int JavaMethod::emitSubroutines()
 {
   uint8_t is_emitted[N_INSNS];
+  int out = 0;
 
   memset(is_emitted, 0, sizeof(is_emitted));
 
+  /* All partial memory operations might have been at known offsets */
+  if (this->registerUsage[R_MADR] == 0)
+    return 0;
+
   /* If any of LB/LBU, LH/LHU, SB,SH, emit subroutines to handle
    * these */
   for (int i = 0; i < this->n_functions; i++)
@@ -357,16 +434,21 @@ void JavaMethod::emitSubroutines()
             {
               this->emitSubroutineForOp(op);
               is_emitted[op] = 1;
+              out++;
             }
         }
     }
+
+  return out;
 }
 
 bool JavaMethod::pass2()
 {
+  size_t emitted = emit->getEmittedBytes();
+  int n_subroutines = 0;
   bool out = true;
 
-  regalloc->setAllocation(this->registerUsage);
+  regalloc->setAllocation(this->registerUsage, this->m_possibleArguments);
 
   emit->generic("\n.method public static %s\n"
                 ".limit stack %d\n"
@@ -401,6 +483,9 @@ bool JavaMethod::pass2()
           /* Multi-function classes assign to RA */
           if (this->hasMultipleFunctions() && i == R_RA)
             emit->bc_pushconst(-1);
+          else if (i == R_MEM && config->memoryModel == MEMORY_MODEL_BYTE)
+            emit->bc_getstatic( "%sCRunTime/memoryBytes [B",
+                controller->getJasminPackagePath());
           else if (i == R_MEM)
             emit->bc_getstatic( "%sCRunTime/memory [I",
                 controller->getJasminPackagePath());
@@ -415,7 +500,7 @@ bool JavaMethod::pass2()
   if (config->optimizePartialMemoryOps)
     {
       emit->bc_goto("__CIBYL_javamethod_begin");
-      this->emitSubroutines();
+      n_subroutines = this->emitSubroutines();
     }
 
   emit->bc_label("__CIBYL_javamethod_begin");
@@ -517,6 +602,31 @@ bool JavaMethod::pass2()
 
   emit->generic(".end method ; %s\n", this->getJavaMethodName());
 
+  if (controller->getStats())
+    {
+      CallTableMethod *callTable = controller->getCallTableMethod();
+      method_stats_t stats;
+
+      stats.name = this->getName();
+      stats.className = controller->getClassByMethodName(this->getName())->getName();
+      stats.estimatedSize = this->getBytecodeSize();
+      stats.emittedSize = emit->getEmittedBytes() - emitted;
+      stats.maxStack = this->getMaxStackHeight() + 2;
+      stats.maxLocals = regalloc->getNumberOfLocals();
+      stats.n_functions = this->n_functions;
+      stats.n_callTable = 0;
+      for (int i = 0; i < this->n_functions; i++)
+        {
+          if (callTable->hasFunction(this->functions[i]->getAddress()))
+            stats.n_callTable++;
+        }
+      stats.n_subroutines = n_subroutines;
+      stats.n_returnLocations = this->n_returnLocations;
+      stats.n_exceptionHandlers = this->n_exceptionHandlers;
+
+      controller->getStats()->addMethod(&stats);
+    }
+
   return out;
 }
 
@@ -571,6 +681,255 @@ void JavaMethod::setReturnSize(int n)
   this->m_returnSize = n;
 }
 
+void JavaMethod::addCallSite(JavaMethod *caller, uint32_t returnAddress)
+{
+  int n = this->n_callSites;
+
+  this->callSites = (CallSite**)xrealloc(this->callSites,
+                                         (n + 1) * sizeof(CallSite*));
+  this->n_callSites = n + 1;
+  this->callSites[n] = new CallSite(caller, returnAddress);
+}
+
+/* The number of instructions to look at for reads of the return value */
+#define RETURN_LIVENESS_WINDOW 48
+
+/*
+ * Check if @a reg might be read before it's written, starting at
+ * @a address. Both ways of conditional branches are followed, and
+ * anything unknown is taken as a read.
+ */
+bool JavaMethod::registerIsLiveAt(uint32_t address, MIPS_register_t reg, int *budget)
+{
+  while ((*budget)-- > 0)
+    {
+      Instruction *insn = controller->getInstructionByAddress(address);
+      Instruction *delayed;
+      int srcs[N_REGS];
+      int dsts[N_REGS];
+
+      if (!insn || !this->getFunctionByAddress(address))
+        return true;
+
+      memset(srcs, 0, sizeof(srcs));
+      memset(dsts, 0, sizeof(dsts));
+      if (insn->hasPrefix())
+        {
+          insn->getPrefix()->fillSources(srcs);
+          if (srcs[reg])
+            return true;
+        }
+      insn->fillSources(srcs);
+      if (srcs[reg])
+        return true;
+
+      if (!insn->isBranch())
+        {
+          insn->fillDestinations(dsts);
+          if (dsts[reg])
+            return false;
+          address += 4;
+          continue;
+        }
+
+      /* The delay slot executes before the branch */
+      delayed = insn->getDelayed();
+      if (delayed)
+        {
+          delayed->fillSources(srcs);
+          delayed->fillDestinations(dsts);
+          if (srcs[reg])
+            return true;
+          if (dsts[reg])
+            return false;
+        }
+
+      switch (insn->getOpcode())
+        {
+        case OP_JAL:
+        case OP_JALR:
+        case OP_BGEZAL:
+        case OP_BLTZAL:
+          /* v0 and v1 are not preserved over calls */
+          return false;
+        case OP_JR:
+          /* Multi-function methods might return to within the method */
+          if (insn->getRs() != R_RA || this->hasMultipleFunctions())
+            return true;
+          return (reg == R_V0 && this->returnSize() >= 1) ||
+            (reg == R_V1 && this->returnSize() >= 2);
+        case OP_J:
+          address = insn->getExtra() << 2;
+          break;
+        default:
+          /* Conditional branch */
+          if (this->registerIsLiveAt(address + 4 + (insn->getExtra() << 2),
+                                     reg, budget))
+            return true;
+          address += 8;
+          break;
+        }
+    }
+
+  return true;
+}
+
+int JavaMethod::returnSizeUsedAt(uint32_t address)
+{
+  int budget = RETURN_LIVENESS_WINDOW;
+
+  if (address == 0)
+    return this->returnSize();
+
+  if (this->registerIsLiveAt(address, R_V1, &budget))
+    return 2;
+  budget = RETURN_LIVENESS_WINDOW;
+  if (this->registerIsLiveAt(address, R_V0, &budget))
+    return 1;
+
+  return 0;
+}
+
+void JavaMethod::resetCallLiveness()
+{
+  CallTableMethod *callTable = controller->getCallTableMethod();
+  int n = 0;
+
+  this->m_calledFromJava = false;
+  for (int i = 0; i < this->n_functions; i++)
+    {
+      uint32_t addr = this->functions[i]->getAddress();
+
+      if (callTable->hasFunction(addr) || addr == elf->getEntryPoint())
+        this->m_calledFromJava = true;
+    }
+
+  /* Start with nothing passed and nothing returned */
+  if (this->hasMultipleFunctions())
+    this->m_possibleArguments[n++] = R_FNA;
+  this->m_possibleArguments[n] = R_ZERO;
+  this->m_returnSize = 0;
+  this->m_returnWritten = 0;
+  this->m_callLiveness = true;
+}
+
+bool JavaMethod::updateCallLiveness()
+{
+  MIPS_register_t args[7];
+  ElfSymbol *sym = NULL;
+  int srcs[N_REGS];
+  int dsts[N_REGS];
+  int written = 0;
+  int used = 0;
+  int n = 0;
+  bool out = false;
+
+  memset(srcs, 0, sizeof(srcs));
+  memset(dsts, 0, sizeof(dsts));
+  for (int i = 0; i < this->n_functions; i++)
+    {
+      Function *fn = this->functions[i];
+
+      /* Calls now read and write what the called methods currently use */
+      fn->updateRegisterUsage();
+      fn->fillSources(srcs);
+      fn->fillDestinations(dsts);
+    }
+
+  /* The DWARF information is per function */
+  if (!this->hasMultipleFunctions())
+    sym = elf->getSymbolByAddr(this->getAddress());
+
+  /* Registers which are never read need not be passed */
+  if (srcs[R_SP])
+    args[n++] = R_SP;
+  if (this->hasMultipleFunctions())
+    args[n++] = R_FNA;
+  for (int reg = R_A0; reg <= R_A3; reg++)
+    {
+      if (sym && sym->n_args >= 0 && reg - R_A0 >= sym->n_args)
+        break;
+      if (srcs[reg])
+        args[n++] = (MIPS_register_t)reg;
+    }
+  args[n] = R_ZERO;
+
+  /* Return what's written and read by some caller. Calls write what
+   * the called method writes, not what's left after pruning it, since
+   * our own callers might read that through us */
+  if (dsts[R_V1])
+    written = 2;
+  else if (dsts[R_V0])
+    written = 1;
+  if (sym && sym->ret_size >= 0 && sym->ret_size < written)
+    written = sym->ret_size;
+  if (written != this->m_returnWritten)
+    out = true;
+  this->m_returnWritten = written;
+
+  if (this->m_calledFromJava)
+    used = 2;
+  for (int i = 0; i < this->n_callSites && used < written; i++)
+    {
+      CallSite *site = this->callSites[i];
+
+      used = max(used, site->caller->returnSizeUsedAt(site->returnAddress));
+    }
+
+  for (int i = 0; i <= n; i++)
+    {
+      if (this->m_possibleArguments[i] != args[i])
+        out = true;
+      this->m_possibleArguments[i] = args[i];
+    }
+  if (used > written)
+    used = written;
+  if (used != this->m_returnSize)
+    out = true;
+  this->m_returnSize = used;
+
+  return out;
+}
+
+void JavaMethod::finishCallLiveness()
+{
+  this->updateRegisterUsage();
+}
+
+void JavaMethod::optimizeMemoryAccesses()
+{
+  for (int i = 0; i < this->n_functions; i++)
+    this->functions[i]->optimizeMemoryAccesses();
+
+  this->updateRegisterUsage();
+}
+
+void JavaMethod::updateRegisterUsage()
+{
+  void *it;
+
+  memset(this->registerUsage, 0, sizeof(this->registerUsage));
+  for (int i = 0; i < this->n_functions; i++)
+    {
+      Function *fn = this->functions[i];
+
+      fn->fillDestinations(this->registerUsage);
+      fn->fillSources(this->registerUsage);
+    }
+  if (this->hasMultipleFunctions())
+    this->registerUsage[R_FNA]++;
+
+  this->n_registersToPass = 0;
+  for (MIPS_register_t reg = this->getFirstRegisterToPass(&it);
+      reg != R_ZERO;
+      reg = this->getNextRegisterToPass(&it))
+    this->n_registersToPass++;
+
+  /* The signature might have changed */
+  free(this->javaName);
+  this->javaName = NULL;
+}
+
 bool JavaMethod::clobbersReg(MIPS_register_t reg)
 {
   return this->registerUsage[reg] > 0;
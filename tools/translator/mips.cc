@@ -95,7 +95,7 @@ const char *mips_reg_strings[] =
   "f14", "f15", "f16", "f17", "f18", "f19", "f20", "f21", "f22", "f23", "f24", "f25",
   "f26", "f27", "f28", "f29", "f30", "f31",
   "cpc", "cm0", "cm1", "cm2", "cm3", "cm4", "cm5", "cm6", "cm7", "madr", "ecb", "ear",
-  "fna", "mem",
+  "fna", "mem", "bix",
 };
 
 MIPS_register_t mips_caller_saved[] = { R_S0, R_S1, R_S2, R_S3, R_S4, R_S5, R_S6, R_S7, R_S8, R_ZERO };
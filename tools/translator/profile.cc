@@ -0,0 +1,442 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      profile.cc
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Profiling counters in the translated code
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <profile.hh>
+#include <controller.hh>
+#include <functioncolocation.hh>
+#include <config.hh>
+#include <emit.hh>
+
+/* Keep the Java string constants well below the 64KB limit */
+#define NAME_CHUNK_SIZE 16384
+
+/* MIPS code in the colocated method, well below the 64KB method limit */
+#define PROFILE_COLOCATION_SIZE 8192
+
+ProfileGenerator::ProfileGenerator(const char *dstdir)
+{
+  this->m_dstdir = xstrdup(dstdir);
+
+  this->n_functions = 0;
+  this->functionNames = NULL;
+
+  this->n_loops = 0;
+  this->loopFunctionNames = NULL;
+  this->loopAddresses = NULL;
+}
+
+int ProfileGenerator::addFunction(Function *fn)
+{
+  int out = this->n_functions;
+
+  this->n_functions++;
+  this->functionNames = (const char**)xrealloc(this->functionNames,
+                                               this->n_functions * sizeof(const char*));
+  this->functionNames[out] = fn->getName();
+
+  if (!config->profileLoops)
+    return out;
+
+  /* Targets of backward branches are loop headers */
+  for (uint32_t addr = fn->getAddress(); addr < fn->getAddress() + fn->getSize(); addr += 4)
+    {
+      Instruction *insn = controller->getInstructionByAddress(addr);
+      uint32_t dst;
+
+      if (!insn || !insn->isBranch())
+        continue;
+
+      switch (insn->getOpcode())
+        {
+        case OP_BEQ:
+        case OP_BNE:
+        case OP_BLEZ:
+        case OP_BGTZ:
+        case OP_BLTZ:
+        case OP_BGEZ:
+          dst = addr + 4 + (insn->getExtra() << 2);
+          break;
+        case OP_J:
+          dst = insn->getExtra() << 2;
+          break;
+        default:
+          continue;
+        }
+
+      if (dst <= addr && dst >= fn->getAddress())
+        this->addLoop(fn, dst);
+    }
+
+  return out;
+}
+
+void ProfileGenerator::addLoop(Function *fn, uint32_t address)
+{
+  int n = this->n_loops;
+
+  if (this->m_loops.find(address) != this->m_loops.end())
+    return;
+
+  this->n_loops++;
+  this->loopFunctionNames = (const char**)xrealloc(this->loopFunctionNames,
+                                                   this->n_loops * sizeof(const char*));
+  this->loopAddresses = (uint32_t*)xrealloc(this->loopAddresses,
+                                            this->n_loops * sizeof(uint32_t));
+  this->loopFunctionNames[n] = fn->getName();
+  this->loopAddresses[n] = address;
+  this->m_loops[address] = n;
+}
+
+int ProfileGenerator::lookupLoop(uint32_t address)
+{
+  LoopTable_t::iterator it = this->m_loops.find(address);
+
+  if (it == this->m_loops.end())
+    return -1;
+
+  return it->second;
+}
+
+void ProfileGenerator::emitIncrement(const char *array, int idx)
+{
+  /* CibylProfile.array[idx]++ */
+  emit->bc_getstatic("%sCibylProfile/%s [I",
+                     controller->getJasminPackagePath(), array);
+  emit->bc_pushconst(idx);
+  emit->bc_dup2();
+  emit->bc_iaload();
+  emit->bc_pushconst(1);
+  emit->bc_iadd();
+  emit->bc_iastore();
+}
+
+void ProfileGenerator::emitFunctionEntry(int idx)
+{
+  this->emitIncrement("calls", idx);
+  this->emitCurrentFunction(idx);
+}
+
+void ProfileGenerator::emitCurrentFunction(int idx)
+{
+  if (config->profileTime == 0)
+    return;
+
+  emit->bc_pushconst(idx);
+  emit->bc_putstatic("%sCibylProfile/current I",
+                     controller->getJasminPackagePath());
+}
+
+void ProfileGenerator::emitLoopHeader(int idx)
+{
+  this->emitIncrement("loops", idx);
+}
+
+/* Space-separated strings, split in chunks */
+static void emitNameChunks(const char *name, int n, const char **a, uint32_t *b)
+{
+  size_t len = 0;
+
+  emit->generic("  private static final String[] %s = {\n    \"", name);
+  for (int i = 0; i < n; i++)
+    {
+      if (len > NAME_CHUNK_SIZE)
+        {
+          emit->generic("\",\n    \"");
+          len = 0;
+        }
+      else if (i > 0)
+        emit->generic(" ");
+      emit->generic("%s", a[i]);
+      len += strlen(a[i]) + 1;
+      if (b)
+        {
+          emit->generic(" 0x%x", b[i]);
+          len += 11;
+        }
+    }
+  emit->generic("\"\n  };\n");
+}
+
+bool ProfileGenerator::pass2()
+{
+  bool j2se = config->javaProfile == J2SE;
+
+  emit->setOutputFile(open_file_in_dir(this->m_dstdir, "CibylProfile.java", "w"));
+  emit->generic("/* GENERATED, DON'T EDIT */\n");
+  if (controller->getPackageName())
+    emit->generic("package %s;\n", controller->getPackageName());
+  emit->generic("import java.io.*;\n\n"
+                "public class CibylProfile implements Runnable {\n"
+                "  public static final int[] calls = new int[%d];\n"
+                "  public static final int[] samples = new int[%d];\n"
+                "  public static final int[] loops = new int[%d];\n"
+                "  public static int current;\n"
+                "  private static boolean sampling;\n\n",
+                this->n_functions, this->n_functions, this->n_loops);
+
+  emitNameChunks("functionNames", this->n_functions, this->functionNames, NULL);
+  emitNameChunks("loopNames", this->n_loops, this->loopFunctionNames, this->loopAddresses);
+
+  emit->generic("\n"
+                "  private boolean sampler;\n\n"
+                "  private CibylProfile(boolean sampler) {\n"
+                "    this.sampler = sampler;\n"
+                "  }\n\n"
+                "  static {\n"
+                "    CRunTime.addExitHook(new CibylProfile(false));\n");
+  if (config->profileTime)
+    emit->generic("    Thread t = new Thread(new CibylProfile(true));\n"
+                  "%s"
+                  "    CibylProfile.sampling = true;\n"
+                  "    t.start();\n",
+                  j2se ? "    t.setDaemon(true);\n" : "");
+  emit->generic("  }\n\n");
+
+  emit->generic("  public void run() {\n"
+                "    if (!this.sampler) {\n"
+                "      CibylProfile.dump();\n"
+                "      return;\n"
+                "    }\n"
+                "    while (CibylProfile.sampling) {\n"
+                "      try {\n"
+                "        Thread.sleep(%u);\n"
+                "      } catch (InterruptedException e) {\n"
+                "      }\n"
+                "      CibylProfile.samples[CibylProfile.current]++;\n"
+                "    }\n"
+                "  }\n\n",
+                config->profileTime);
+
+  emit->generic("  private static String[] split(String[] chunks, int n) {\n"
+                "    String[] out = new String[n];\n"
+                "    int i = 0;\n\n"
+                "    for (int c = 0; c < chunks.length; c++) {\n"
+                "      String s = chunks[c];\n"
+                "      int start = 0;\n\n"
+                "      while (start < s.length() && i < n) {\n"
+                "        int end = s.indexOf(' ', start);\n\n"
+                "        if (end < 0)\n"
+                "          end = s.length();\n"
+                "        out[i++] = s.substring(start, end);\n"
+                "        start = end + 1;\n"
+                "      }\n"
+                "    }\n"
+                "    return out;\n"
+                "  }\n\n");
+
+  emit->generic("  public static void dump() {\n"
+                "    PrintStream out = System.out;\n"
+                "    String[] fns = CibylProfile.split(CibylProfile.functionNames, calls.length);\n"
+                "    String[] lns = CibylProfile.split(CibylProfile.loopNames, loops.length * 2);\n\n"
+                "    CibylProfile.sampling = false;\n");
+  if (j2se)
+    emit->generic("    try {\n"
+                  "      out = new PrintStream(new FileOutputStream(\"cibyl-profile.txt\"));\n"
+                  "    } catch (IOException e) {\n"
+                  "    }\n");
+  emit->generic("    out.println(\"# cibyl-profile 1\");\n"
+                "    for (int i = 0; i < calls.length; i++) {\n"
+                "      if (calls[i] != 0 || samples[i] != 0)\n"
+                "        out.println(\"function \" + fns[i] + \" \" + calls[i] + \" \" + samples[i]);\n"
+                "    }\n"
+                "    for (int i = 0; i < loops.length; i++) {\n"
+                "      if (loops[i] != 0)\n"
+                "        out.println(\"loop \" + lns[i * 2] + \" \" + lns[i * 2 + 1] + \" \" + loops[i]);\n"
+                "    }\n"
+                "    out.flush();\n"
+                "    if (out != System.out)\n"
+                "      out.close();\n"
+                "  }\n"
+                "}\n");
+  emit->closeOutputFile();
+
+  return true;
+}
+
+
+ProfileReader::ProfileReader(const char *filename)
+{
+  FILE *fp = fopen(filename, "r");
+  char line[1024];
+
+  panic_if(!fp, "Cannot open profile %s\n", filename);
+
+  this->m_sampled = false;
+  this->n_entries = 0;
+  this->entries = NULL;
+  while (fgets(line, sizeof(line), fp))
+    {
+      profile_entry_t *e;
+      char name[512];
+      unsigned long calls, samples;
+      int n = this->n_entries;
+
+      if (sscanf(line, "function %511s %lu %lu", name, &calls, &samples) != 3)
+        continue;
+
+      this->n_entries++;
+      this->entries = (profile_entry_t*)xrealloc(this->entries,
+                                                 this->n_entries * sizeof(profile_entry_t));
+      e = &this->entries[n];
+      e->name = xstrdup(name);
+      e->calls = calls;
+      e->samples = samples;
+      if (samples > 0)
+        this->m_sampled = true;
+    }
+  fclose(fp);
+}
+
+static bool profileSampled;
+
+static unsigned long profileWeight(const ProfileReader::profile_entry_t *e)
+{
+  return profileSampled ? e->samples : e->calls;
+}
+
+static int compareProfileEntries(const void *a, const void *b)
+{
+  unsigned long wa = profileWeight((const ProfileReader::profile_entry_t*)a);
+  unsigned long wb = profileWeight((const ProfileReader::profile_entry_t*)b);
+
+  /* Hottest first */
+  if (wa != wb)
+    return wa < wb ? 1 : -1;
+  return 0;
+}
+
+/* The Java method name, as in Function */
+static char *javaName(ElfSymbol *sym, bool withAddress)
+{
+  size_t len = strlen(sym->name) + 16;
+  char *out = (char*)xcalloc(len, 1);
+
+  if (withAddress)
+    xsnprintf(out, len, "%s_%x", sym->name, sym->addr);
+  else
+    xsnprintf(out, len, "%s", sym->name);
+  for (char *p = out; *p; p++)
+    {
+      if (*p == '.')
+        *p = '_';
+    }
+
+  return out;
+}
+
+/*
+ * Exact names first. If the program has been rebuilt since the
+ * profile was taken, the addresses might differ, so the name without
+ * the address is also tried
+ */
+ElfSymbol *ProfileReader::lookupSymbol(const char *name)
+{
+  map<const char *, ElfSymbol *, cmp_str>::iterator it;
+  const char *p = strrchr(name, '_');
+  ElfSymbol *out = NULL;
+
+  it = this->m_symbols.find(name);
+  if (it != this->m_symbols.end())
+    return it->second;
+  if (!p || p == name)
+    return NULL;
+
+  char *stripped = xstrdup(name);
+
+  stripped[p - name] = '\0';
+  if (this->m_nameCount[stripped] == 1)
+    {
+      it = this->m_symbols.find(stripped);
+      if (it != this->m_symbols.end())
+        out = it->second;
+    }
+  free(stripped);
+
+  return out;
+}
+
+const char *ProfileReader::getColocation(ElfSymbol **syms)
+{
+  map<uint32_t, bool> selected;
+  char *out = NULL;
+  size_t len = 0;
+  uint32_t size = 0;
+  unsigned long first;
+  int n = 0;
+
+  for (int i = 0; syms[i]; i++)
+    {
+      char *plain = javaName(syms[i], false);
+
+      this->m_symbols[javaName(syms[i], true)] = syms[i];
+      this->m_symbols[plain] = syms[i];
+      this->m_nameCount[plain]++;
+    }
+
+  profileSampled = this->m_sampled;
+  qsort(this->entries, this->n_entries, sizeof(profile_entry_t),
+        compareProfileEntries);
+  if (this->n_entries == 0)
+    return NULL;
+  first = profileWeight(&this->entries[0]);
+
+  for (int i = 0; i < this->n_entries; i++)
+    {
+      profile_entry_t *e = &this->entries[i];
+      unsigned long w = profileWeight(e);
+      ElfSymbol *sym;
+      bool unique;
+      char *plain;
+
+      if (w == 0 || w < first / 100)
+        break;
+      sym = this->lookupSymbol(e->name);
+      if (!sym || size + sym->size > PROFILE_COLOCATION_SIZE)
+        continue;
+
+      /* Colocations go by the C name, which must then be unique */
+      plain = javaName(sym, false);
+      unique = this->m_nameCount[plain] == 1;
+      free(plain);
+      if (!unique)
+        continue;
+
+      /* The start function, pruned functions, other colocations and
+       * functions listed twice (with different addresses) */
+      if (sym->addr == elf->getEntryPoint() ||
+          (config->pruneUnusedFunctions && !elf->getRelocationBySymbol(sym) &&
+           sym->binding != STB_LOCAL) ||
+          FunctionColocation::lookup(sym->name) || selected[sym->addr])
+        continue;
+      selected[sym->addr] = true;
+
+      len += strlen(sym->name) + 2;
+      out = (char*)xrealloc(out, len);
+      if (n == 0)
+        out[0] = '\0';
+      else
+        strcat(out, ";");
+      strcat(out, sym->name);
+      size += sym->size;
+      n++;
+    }
+
+  if (n < 2)
+    {
+      free(out);
+      return NULL;
+    }
+
+  return out;
+}
@@ -27,7 +27,7 @@ static int allocateRegister(int n, MIPS_register_t reg, MIPS_register_t *sorted,
   return n;
 }
 
-void RegisterAllocator::setAllocation(int *registerUsage)
+void RegisterAllocator::setAllocation(int *registerUsage, MIPS_register_t *arguments)
 {
   MIPS_register_t sorted[N_REGS];
   int usage[N_REGS];
@@ -37,19 +37,12 @@ void RegisterAllocator::setAllocation(int *registerUsage)
   memset(sorted, 0, sizeof(sorted));
   memcpy(usage, registerUsage, sizeof(usage));
 
-  /* Allocate initial registers */
-  if (registerUsage[R_SP] > 0)
-    n = allocateRegister(n, R_SP, sorted, usage);
-  if (registerUsage[R_FNA] > 0)
-    n = allocateRegister(n, R_FNA, sorted, usage);
-  if (registerUsage[R_A0] > 0)
-    n = allocateRegister(n, R_A0, sorted, usage);
-  if (registerUsage[R_A1] > 0)
-    n = allocateRegister(n, R_A1, sorted, usage);
-  if (registerUsage[R_A2] > 0)
-    n = allocateRegister(n, R_A2, sorted, usage);
-  if (registerUsage[R_A3] > 0)
-    n = allocateRegister(n, R_A3, sorted, usage);
+  /* Allocate the arguments first, they are the first locals */
+  for (int i = 0; arguments[i] != R_ZERO; i++)
+    {
+      if (registerUsage[arguments[i]] > 0)
+        n = allocateRegister(n, arguments[i], sorted, usage);
+    }
 
   /* Allocate the rest of the registers */
   int largest;
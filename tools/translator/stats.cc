@@ -0,0 +1,135 @@
+/*********************************************************************
+ *
+ * Copyright (C) 2008,  Simon Kagstrom
+ *
+ * Filename:      stats.cc
+ * Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+ * Description:   Translator timing and code statistics
+ *
+ * $Id:$
+ *
+ ********************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <stats.hh>
+#include <javaclass.hh>
+#include <config.hh>
+#include <utils.h>
+
+StatsGenerator::StatsGenerator(const char *filename)
+{
+  this->m_filename = xstrdup(filename);
+
+  this->n_timers = 0;
+  this->timerNames = NULL;
+  this->timerSeconds = NULL;
+
+  this->n_methods = 0;
+  this->methods = NULL;
+
+  this->n_classes = 0;
+  this->classNames = NULL;
+  this->classMethods = NULL;
+  this->classEstimated = NULL;
+  this->classEmitted = NULL;
+}
+
+double StatsGenerator::now()
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void StatsGenerator::addTime(const char *name, double seconds)
+{
+  int n = this->n_timers;
+
+  for (int i = 0; i < this->n_timers; i++)
+    {
+      if (strcmp(this->timerNames[i], name) == 0)
+        {
+          this->timerSeconds[i] += seconds;
+          return;
+        }
+    }
+
+  this->n_timers++;
+  this->timerNames = (const char**)xrealloc(this->timerNames,
+                                            this->n_timers * sizeof(const char*));
+  this->timerSeconds = (double*)xrealloc(this->timerSeconds,
+                                         this->n_timers * sizeof(double));
+  this->timerNames[n] = name;
+  this->timerSeconds[n] = seconds;
+}
+
+void StatsGenerator::addMethod(method_stats_t *method)
+{
+  int n = this->n_methods;
+
+  this->n_methods++;
+  this->methods = (method_stats_t*)xrealloc(this->methods,
+                                            this->n_methods * sizeof(method_stats_t));
+  this->methods[n] = *method;
+}
+
+void StatsGenerator::addClass(JavaClass *cl, size_t emittedSize)
+{
+  int n = this->n_classes;
+  size_t estimated = 0;
+
+  for (int i = 0; i < cl->getNumberOfMethods(); i++)
+    estimated += cl->getMethodByIndex(i)->getBytecodeSize();
+
+  this->n_classes++;
+  this->classNames = (const char**)xrealloc(this->classNames,
+                                            this->n_classes * sizeof(const char*));
+  this->classMethods = (int*)xrealloc(this->classMethods,
+                                      this->n_classes * sizeof(int));
+  this->classEstimated = (size_t*)xrealloc(this->classEstimated,
+                                           this->n_classes * sizeof(size_t));
+  this->classEmitted = (size_t*)xrealloc(this->classEmitted,
+                                         this->n_classes * sizeof(size_t));
+  this->classNames[n] = cl->getName();
+  this->classMethods[n] = cl->getNumberOfMethods();
+  this->classEstimated[n] = estimated;
+  this->classEmitted[n] = emittedSize;
+}
+
+bool StatsGenerator::write()
+{
+  FILE *fp = fopen(this->m_filename, "w");
+
+  panic_if(!fp, "Cannot open stats file %s\n", this->m_filename);
+
+  fprintf(fp, "# cibyl-stats 1\n");
+  for (int i = 0; i < this->n_timers; i++)
+    fprintf(fp, "time %s %.6f\n", this->timerNames[i], this->timerSeconds[i]);
+
+  for (int i = 0; i < this->n_methods; i++)
+    {
+      method_stats_t *m = &this->methods[i];
+
+      fprintf(fp, "method %s %s %lu %lu %d %d %d %d %d %d %d\n",
+              m->name, m->className,
+              (unsigned long)m->estimatedSize, (unsigned long)m->emittedSize,
+              m->maxStack, m->maxLocals, m->n_functions, m->n_callTable,
+              m->n_subroutines, m->n_returnLocations, m->n_exceptionHandlers);
+    }
+
+  /* The packing is against the limit, the last class takes what's left */
+  for (int i = 0; i < this->n_classes; i++)
+    fprintf(fp, "class %s %d %lu %lu %lu\n",
+            this->classNames[i], this->classMethods[i],
+            (unsigned long)this->classEstimated[i],
+            (unsigned long)this->classEmitted[i],
+            (unsigned long)config->classSizeLimit);
+
+  fclose(fp);
+
+  return true;
+}
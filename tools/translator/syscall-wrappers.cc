@@ -13,7 +13,9 @@
 #include <syscall-wrappers.hh>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <ctype.h>
 #include <controller.hh>
+#include <config.hh>
 
 
 SyscallWrapperGenerator::SyscallWrapperGenerator(const char **defines, const char *dstdir,
@@ -37,7 +39,11 @@ SyscallWrapperGenerator::SyscallWrapperGenerator(const char **defines, const cha
 
   this->set_usage = (int*)xcalloc( n_syscall_sets, sizeof(int) );
 
-  /* Fixup set usage */
+  this->readJvmClasses();
+}
+
+void SyscallWrapperGenerator::fixupSetUsage()
+{
   for (Controller::CibylDbTable_t::iterator it = this->m_used_syscalls.begin();
        it != this->m_used_syscalls.end();
        ++it)
@@ -53,6 +59,158 @@ SyscallWrapperGenerator::SyscallWrapperGenerator(const char **defines, const cha
     }
 }
 
+/* cpp -C keeps comments (also those of the predefined headers) */
+void SyscallWrapperGenerator::stripComments(char *data)
+{
+  bool inComment = false;
+
+  for (char *p = data; *p; p++)
+    {
+      if (!inComment && p[0] == '/' && p[1] == '*')
+        inComment = true;
+      else if (inComment && p[0] == '*' && p[1] == '/')
+        {
+          p[0] = p[1] = ' ';
+          inComment = false;
+          p++;
+          continue;
+        }
+      if (inComment && *p != '\n')
+        *p = ' ';
+    }
+}
+
+void SyscallWrapperGenerator::readJvmClasses()
+{
+  /* The syscall sets do not carry dir information, thus loop through
+   * all dirs and all sets */
+  for (int i = 0; i < this->n_syscall_dirs; i++)
+    {
+      const char *dir = this->lookupFilePath(this->syscall_dirs[i]);
+
+      for (int j = 0; j < this->n_syscall_sets; j++)
+        {
+          char *data, *line, *saveptr;
+          size_t size;
+
+          data = (char*)read_cpp(&size, this->defines, "%s/%s/jvm-classes",
+                                 dir, this->syscall_sets[j]);
+          if (!data)
+            continue;
+          this->stripComments(data);
+
+          /*
+           * One fully qualified class per line, prefixed by "interface"
+           * for interfaces. "noinline NAME" lines list syscalls where
+           * the C and Java types differ (e.g., int vs long).
+           */
+          for (line = strtok_r(data, "\n", &saveptr);
+               line;
+               line = strtok_r(NULL, "\n", &saveptr))
+            {
+              bool isInterface = false;
+              jvm_class_t *cls;
+              const char *name;
+
+              while (isspace(*line))
+                line++;
+              if (*line == '\0')
+                continue;
+
+              if (strncmp(line, "noinline ", strlen("noinline ")) == 0)
+                {
+                  line += strlen("noinline ");
+                  line[strcspn(line, " \t\r")] = '\0';
+                  this->m_noinline[xstrdup(line)] = true;
+                  continue;
+                }
+              if (strncmp(line, "interface ", strlen("interface ")) == 0)
+                {
+                  isInterface = true;
+                  line += strlen("interface ");
+                  while (isspace(*line))
+                    line++;
+                }
+              line[strcspn(line, " \t\r")] = '\0';
+              name = strrchr(line, '/');
+              name = name ? name + 1 : line;
+
+              /* The same name in two packages, don't guess */
+              if (this->m_jvm_classes.find(name) != this->m_jvm_classes.end())
+                {
+                  cls = this->m_jvm_classes[name];
+                  if (cls->path && strcmp(cls->path, line) != 0)
+                    cls->path = NULL;
+                  continue;
+                }
+
+              cls = (jvm_class_t*)xcalloc(1, sizeof(jvm_class_t));
+              cls->path = xstrdup(line);
+              cls->isInterface = isInterface;
+              this->m_jvm_classes[xstrdup(name)] = cls;
+            }
+          free(data);
+        }
+    }
+}
+
+const char *SyscallWrapperGenerator::lookupJvmClass(const char *name, bool *isInterface)
+{
+  JvmClassTable_t::iterator it = this->m_jvm_classes.find(name);
+
+  if (it == this->m_jvm_classes.end() || !it->second->path)
+    return NULL;
+  if (isInterface)
+    *isInterface = it->second->isInterface;
+
+  return it->second->path;
+}
+
+bool SyscallWrapperGenerator::isObjectCall(cibyl_db_entry_t *p)
+{
+  return p->nrArgs != 0 &&
+    (p->args[0].flags & CIBYL_DB_ARG_OBJREF) &&
+    (strcmp(p->javaClass, p->args[0].javaType) == 0);
+}
+
+bool SyscallWrapperGenerator::canInline(cibyl_db_entry_t *p)
+{
+  if (!config->inlineSyscalls ||
+      (p->qualifier & CIBYL_DB_QUALIFIER_NOT_GENERATED) != 0 ||
+      strcmp(p->javaMethod, "new") == 0 ||
+      this->m_noinline.find(p->name) != this->m_noinline.end())
+    return false;
+
+  /* We need the full class name to call it from bytecode */
+  if (!this->lookupJvmClass(p->javaClass, NULL))
+    return false;
+
+  if (p->returns == CIBYL_DB_RETURN_INT &&
+      strcmp(p->returnType, "int") != 0)
+    return false;
+  if (p->returns == CIBYL_DB_RETURN_OBJREF &&
+      !this->lookupJvmClass(p->returnType, NULL))
+    return false;
+
+  /* Only ints and object handles, which need no temporaries */
+  for (unsigned int i = 0; i < p->nrArgs; i++)
+    {
+      cibyl_db_arg_t *a = &p->args[i];
+
+      if (strcmp(a->type, a->javaType) == 0)
+        {
+          if (strcmp(a->javaType, "int") != 0)
+            return false;
+        }
+      else if (strcmp(a->javaType, "boolean") == 0 ||
+               strcmp(a->javaType, "String") == 0 ||
+               !this->lookupJvmClass(a->javaType, NULL))
+        return false;
+    }
+
+  return true;
+}
+
 void SyscallWrapperGenerator::doOneArgumentGet(cibyl_db_entry_t *p, cibyl_db_arg_t *a )
 {
   if ( strcmp(a->javaType, "void") == 0 || strcmp(a->javaType, a->type) == 0)
@@ -64,6 +222,9 @@ void SyscallWrapperGenerator::doOneArgumentGet(cibyl_db_entry_t *p, cibyl_db_arg
   else if ( strcmp(a->javaType, "String") == 0 )
     emit->generic("CRunTime.charPtrToString(__%s)",
                   a->name);
+  else if (config->checkObjectHandles)
+    emit->generic("(%s)CRunTime.getRegisteredObject(__%s)",
+                  a->javaType, a->name);
   else
     emit->generic("(%s)CRunTime.objectRepository[__%s]",
                   a->javaType,
@@ -135,9 +296,7 @@ void SyscallWrapperGenerator::doOne(cibyl_db_entry_t *p)
     emit->generic("new %s(", p->javaClass);
   else
     {
-      if (p->nrArgs != 0 &&
-          (p->args[0].flags & CIBYL_DB_ARG_OBJREF) &&
-          (strcmp(p->javaClass, p->args[0].javaType) == 0))
+      if (this->isObjectCall(p))
         {
           /* Object call */
           emit->generic("%s.%s(", p->args[0].name,
@@ -276,6 +435,8 @@ void SyscallWrapperGenerator::generateHelperClasses()
 
 bool SyscallWrapperGenerator::pass2()
 {
+  this->fixupSetUsage();
+
   emit->setOutputFile(open_file_in_dir(this->m_dstdir, "Syscalls.java", "w"));
   emit->generic("/* GENERATED, DON'T EDIT */\n");
   if (controller->getPackageName())
@@ -291,6 +452,10 @@ bool SyscallWrapperGenerator::pass2()
     {
       cibyl_db_entry_t *p = it->second;
 
+      /* Called directly from the syscall site */
+      if (this->canInline(p))
+        continue;
+
       if ((p->qualifier & CIBYL_DB_QUALIFIER_NOT_GENERATED) == 0)
         this->doOne(p);
       else
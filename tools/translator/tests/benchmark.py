@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+######################################################################
+##
+## Copyright (C) 2008,  Simon Kagstrom
+##
+## Filename:      benchmark.py
+## Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+## Description:   Translator scalability benchmark on synthetic ELFs
+##
+## $Id:$
+##
+######################################################################
+import sys, os, time, shutil, tempfile, subprocess
+from optparse import OptionParser
+
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+import elfgen
+
+usage = """Usage: benchmark.py [options]
+
+Translate synthetic MIPS ELF files of increasing size and report the
+wall time, peak memory and the pass times from the translator stats
+report. The time per function should stay flat as the size grows;
+if it increases with the size, something is quadratic."""
+
+parser = OptionParser(usage = usage)
+parser.add_option("--translator", default=os.path.join(os.path.dirname(os.path.abspath(__file__)),
+							  "..", "xcibyl-translator"),
+		  help="The translator to run (default ../xcibyl-translator)",
+		  dest="translator", metavar="PATH")
+parser.add_option("--functions", default="1000,10000,100000",
+		  help="Comma-separated list of number of functions (default 1000,10000,100000)",
+		  dest="functions", metavar="N1,N2,...")
+parser.add_option("--blocks", default=4,
+		  help="Conditional branches per function (default 4)",
+		  dest="blocks", metavar="N")
+parser.add_option("--calls", default=2,
+		  help="Calls (R_MIPS_26 relocations) per function (default 2)",
+		  dest="calls", metavar="N")
+parser.add_option("--hilos", default=1,
+		  help="HI16/LO16 pairs with function addresses per function (default 1)",
+		  dest="hilos", metavar="N")
+parser.add_option("--rodata-pointers", default=10,
+		  help="Function pointers in .rodata, in percent of the functions (default 10)",
+		  dest="rodataPointers", metavar="PERCENT")
+parser.add_option("--config", default="",
+		  help="Additional translator configuration, e.g., class_size_limit=65536",
+		  dest="config", metavar="CONFIG")
+parser.add_option("--keep", default=None,
+		  help="Keep the ELF files and the translator output in DIR",
+		  dest="keep", metavar="DIR")
+
+def readStats(filename):
+	times = {}
+	n_methods = 0
+	n_classes = 0
+
+	f = open(filename)
+	for line in f.readlines():
+		words = line.split()
+		if len(words) == 0 or words[0] == "#":
+			continue
+		if words[0] == "time":
+			times[words[1]] = float(words[2])
+		elif words[0] == "method":
+			n_methods = n_methods + 1
+		elif words[0] == "class":
+			n_classes = n_classes + 1
+	f.close()
+
+	return times, n_methods, n_classes
+
+def run(translator, workdir, n, options):
+	opts = elfgen.Options()
+	opts.functions = n
+	opts.blocks = int(options.blocks)
+	opts.calls = int(options.calls)
+	opts.hilos = int(options.hilos)
+	opts.rodataPointers = n * int(options.rodataPointers) // 100
+
+	elf = os.path.join(workdir, "synthetic-%d.elf" % n)
+	db = os.path.join(workdir, "synthetic.db")
+	stats = os.path.join(workdir, "stats-%d.txt" % n)
+	outdir = os.path.join(workdir, "out-%d" % n)
+
+	# In a separate process to keep it out of the peak memory of the translator
+	if subprocess.call([sys.executable, elfgen.__file__, "--functions", str(n),
+			    "--blocks", str(opts.blocks), "--calls", str(opts.calls),
+			    "--hilos", str(opts.hilos), "--rodata-pointers", str(opts.rodataPointers),
+			    elf, db]) != 0:
+		print("Generating %s failed" % elf)
+		sys.exit(1)
+
+	config = "config:stats=" + stats
+	if options.config != "":
+		config = config + "," + options.config
+
+	start = time.time()
+	p = subprocess.Popen([translator, config, outdir, elf, db],
+			     stdout = open(os.devnull, "w"))
+	pid, status, rusage = os.wait4(p.pid, 0)
+	wall = time.time() - start
+
+	if status != 0:
+		print("%s failed on %s (status %d)" % (translator, elf, status))
+		sys.exit(1)
+
+	times, n_methods, n_classes = readStats(stats)
+
+	# ru_maxrss is in kilobytes on Linux, and includes the (small)
+	# Python process forking the translator
+	return (n, elfgen.countRelocations(opts), n_methods, n_classes, wall, rusage.ru_maxrss,
+		times.get("pass0", 0), times.get("pass1", 0),
+		times.get("relocations", 0), times.get("pass2", 0))
+
+if __name__ == "__main__":
+	(options, args) = parser.parse_args()
+
+	if not os.path.isfile(options.translator):
+		parser.error("The translator %s does not exist" % options.translator)
+
+	if options.keep:
+		workdir = options.keep
+		if not os.path.isdir(workdir):
+			os.makedirs(workdir)
+	else:
+		workdir = tempfile.mkdtemp(prefix="cibyl-benchmark-")
+
+	print("%9s %9s %9s %7s %9s %9s %9s %9s %9s %9s %9s" %
+	      ("functions", "relocs", "methods", "classes", "wall", "peak-kb",
+	       "pass0", "pass1", "relocs", "pass2", "us/fn"))
+	for n in [int(x) for x in options.functions.split(",")]:
+		r = run(options.translator, workdir, n, options)
+
+		print("%9d %9d %9d %7d %9.3f %9d %9.3f %9.3f %9.3f %9.3f %9.1f" %
+		      (r + (r[4] * 1000000 / n,)))
+		sys.stdout.flush()
+
+	if not options.keep:
+		shutil.rmtree(workdir)
@@ -0,0 +1,268 @@
+######################################################################
+##
+## Copyright (C) 2008,  Simon Kagstrom
+##
+## Filename:      elfgen.py
+## Author:        Simon Kagstrom <simon.kagstrom@gmail.com>
+## Description:   Synthetic MIPS ELF files for the translator
+##
+## $Id:$
+##
+######################################################################
+import sys, struct, random
+from optparse import OptionParser
+
+# Laid out as by build/linker.lds
+TEXT_BASE = 0x1000000
+STRTAB_BASE = 0xff000000
+
+R_MIPS_32 = 2
+R_MIPS_26 = 4
+R_MIPS_HI16 = 5
+R_MIPS_LO16 = 6
+
+SHT_PROGBITS = 1
+SHT_SYMTAB = 2
+SHT_STRTAB = 3
+SHT_REL = 9
+
+SHF_WRITE = 1
+SHF_ALLOC = 2
+SHF_EXECINSTR = 4
+
+STB_LOCAL = 0
+STB_GLOBAL = 1
+STT_OBJECT = 1
+STT_FUNC = 2
+STT_SECTION = 3
+
+ZERO = 0
+V0 = 2
+A0 = 4
+A1 = 5
+SP = 29
+RA = 31
+
+def itype(op, rs, rt, imm):
+	return (op << 26) | (rs << 21) | (rt << 16) | (imm & 0xffff)
+
+def addiu(rt, rs, imm):
+	return itype(0x09, rs, rt, imm)
+
+def lui(rt, imm):
+	return itype(0x0f, 0, rt, imm)
+
+def lw(rt, off, base):
+	return itype(0x23, base, rt, off)
+
+def sw(rt, off, base):
+	return itype(0x2b, base, rt, off)
+
+def beq(rs, rt, off):
+	return itype(0x04, rs, rt, off)
+
+def jal(addr):
+	return (0x03 << 26) | ((addr >> 2) & 0x03ffffff)
+
+def jr(rs):
+	return (rs << 21) | 0x08
+
+NOP = 0
+
+class Options:
+	"""What to put in the ELF file, all per function unless noted"""
+	def __init__(self):
+		self.functions = 1000
+		self.blocks = 4        # Conditional branches
+		self.calls = 2         # jal with R_MIPS_26 relocations
+		self.hilos = 1         # lui/addiu of a function address
+		self.rodataPointers = 100 # Function pointers in .rodata (in total)
+		self.seed = 1
+
+class StringTable:
+	def __init__(self):
+		self.parts = [b"\0"]
+		self.size = 1
+		self.offsets = {}
+
+	def add(self, s):
+		if s in self.offsets:
+			return self.offsets[s]
+		out = self.size
+		self.parts.append(s.encode("ascii") + b"\0")
+		self.size = self.size + len(s) + 1
+		self.offsets[s] = out
+		return out
+
+	def data(self):
+		return b"".join(self.parts)
+
+def functionSize(opts):
+	# Prologue, blocks, hi/lo pairs, calls and the epilogue
+	return 2 + opts.blocks * 3 + opts.hilos * 2 + opts.calls * 2 + 4
+
+def countRelocations(opts):
+	return opts.functions * (opts.calls + opts.hilos * 2) + opts.rodataPointers
+
+def generate(filename, opts):
+	"""Write a statically linked big-endian MIPS ELF with opts.functions
+	functions. Function 0 is the entry point. Functions which are never
+	referenced are pruned by the translator, like in real programs."""
+	rnd = random.Random(opts.seed)
+	n = opts.functions
+	fn_words = functionSize(opts)
+	fn_addrs = [TEXT_BASE + i * fn_words * 4 for i in range(0, n)]
+
+	text = []
+	rel_text = []
+	rel_rodata = []
+
+	# Symbol 1 is the .text section, 2 the data object, then the functions
+	sym_text = 1
+	sym_fn = 3
+
+	for i in range(0, n):
+		addr = fn_addrs[i]
+		words = [addiu(SP, SP, -16), sw(RA, 12, SP)]
+
+		for b in range(0, opts.blocks):
+			# Skip over the delay slot and the add
+			words = words + [beq(A0, ZERO, 2), NOP, addiu(V0, V0, b + 1)]
+		for h in range(0, opts.hilos):
+			dst = rnd.randint(0, n - 1)
+			lo = fn_addrs[dst] & 0xffff
+			hi = ((fn_addrs[dst] + 0x8000) >> 16) & 0xffff
+			here = addr + len(words) * 4
+			rel_text.append((here, R_MIPS_HI16, sym_fn + dst))
+			rel_text.append((here + 4, R_MIPS_LO16, sym_fn + dst))
+			words = words + [lui(A1, hi), addiu(A1, A1, lo)]
+		for c in range(0, opts.calls):
+			# Always call the next function so that nothing is pruned
+			if c == 0:
+				callee = (i + 1) % n
+			else:
+				callee = rnd.randint(0, n - 1)
+			rel_text.append((addr + len(words) * 4, R_MIPS_26, sym_fn + callee))
+			words = words + [jal(fn_addrs[callee]), NOP]
+		words = words + [lw(RA, 12, SP), addiu(SP, SP, 16), jr(RA), NOP]
+
+		assert len(words) == fn_words
+		text.extend(words)
+
+	text_data = struct.pack(">%dL" % len(text), *text)
+
+	# .data at 0, .rodata after it
+	data_data = struct.pack(">4L", 1, 2, 3, 4)
+	rodata_addr = (len(data_data) + 15) & ~15
+	pointers = []
+	for p in range(0, opts.rodataPointers):
+		pointers.append(fn_addrs[rnd.randint(0, n - 1)])
+		# Section-relative, the addend is in the contents
+		rel_rodata.append((rodata_addr + p * 4, R_MIPS_32, sym_text))
+	rodata_data = struct.pack(">%dL" % len(pointers), *pointers)
+
+	# Minimal DWARF, a compile unit without children
+	abbrev_data = struct.pack(">6B", 1, 0x11, 0, 0, 0, 0)
+	info_data = struct.pack(">LHLBB", 8, 2, 0, 4, 1)
+
+	strtab = StringTable()
+	syms = [struct.pack(">LLLBBH", 0, 0, 0, 0, 0, 0),
+		struct.pack(">LLLBBH", 0, 0, 0, (STB_LOCAL << 4) | STT_SECTION, 0, 1),
+		struct.pack(">LLLBBH", strtab.add("synthetic_data"), 0, len(data_data),
+			    (STB_GLOBAL << 4) | STT_OBJECT, 0, 2)]
+	for i in range(0, n):
+		if i == 0:
+			name = "__start"
+		else:
+			name = "fn_%d" % i
+		syms.append(struct.pack(">LLLBBH", strtab.add(name), fn_addrs[i], fn_words * 4,
+					(STB_GLOBAL << 4) | STT_FUNC, 0, 1))
+	symtab_data = b"".join(syms)
+
+	rel_text.sort()
+	rel_text_data = b"".join([struct.pack(">LL", a, (s << 8) | t) for (a, t, s) in rel_text])
+	rel_rodata_data = b"".join([struct.pack(">LL", a, (s << 8) | t) for (a, t, s) in rel_rodata])
+
+	# name, type, flags, addr, data, link, info, align, entsize
+	sections = [
+		(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, TEXT_BASE, text_data, 0, 0, 4, 0),
+		(".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, data_data, 0, 0, 16, 0),
+		(".rodata", SHT_PROGBITS, SHF_ALLOC, rodata_addr, rodata_data, 0, 0, 16, 0),
+		(".cibylstrtab", SHT_PROGBITS, SHF_ALLOC, STRTAB_BASE, b"\0\0\0\0", 0, 0, 4, 0),
+		(".rel.text", SHT_REL, 0, 0, rel_text_data, 9, 1, 4, 8),
+		(".rel.rodata", SHT_REL, 0, 0, rel_rodata_data, 9, 3, 4, 8),
+		(".debug_abbrev", SHT_PROGBITS, 0, 0, abbrev_data, 0, 0, 1, 0),
+		(".debug_info", SHT_PROGBITS, 0, 0, info_data, 0, 0, 1, 0),
+		(".symtab", SHT_SYMTAB, 0, 0, symtab_data, 10, 2, 4, 16),
+		(".strtab", SHT_STRTAB, 0, 0, strtab.data(), 0, 0, 1, 0),
+	]
+	shstrtab = StringTable()
+	for s in sections:
+		shstrtab.add(s[0])
+	shstrtab.add(".shstrtab")
+	sections.append((".shstrtab", SHT_STRTAB, 0, 0, shstrtab.data(), 0, 0, 1, 0))
+
+	# ELF header, section contents and then the section headers
+	offset = 52
+	contents = []
+	headers = [struct.pack(">10L", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)]
+	for (name, type, flags, addr, data, link, info, align, entsize) in sections:
+		pad = (-offset) & 3
+		contents.append(b"\0" * pad + data)
+		offset = offset + pad
+		headers.append(struct.pack(">10L", shstrtab.add(name), type, flags, addr,
+					   offset, len(data), link, info, align, entsize))
+		offset = offset + len(data)
+	pad = (-offset) & 3
+	contents.append(b"\0" * pad)
+	shoff = offset + pad
+
+	ident = b"\x7fELF" + struct.pack(">BBBB", 1, 2, 1, 0) + b"\0" * 8
+	ehdr = ident + struct.pack(">HHLLLLLHHHHHH", 2, 8, 1, TEXT_BASE, 0, shoff,
+				   0x1000, 52, 0, 0, 40, len(headers), len(headers) - 1)
+
+	f = open(filename, "wb")
+	f.write(ehdr)
+	f.write(b"".join(contents))
+	f.write(b"".join(headers))
+	f.close()
+
+def generateSyscallDatabase(filename):
+	"""An empty syscall database (in host byte order, as the one from
+	cibyl-generate-syscall-db)"""
+	header = struct.calcsize("P") * 6
+	f = open(filename, "wb")
+	f.write(struct.pack("PPPPPP", 0x11b1c1d1, 0, 0, 0, header, header))
+	f.write(b"\0" * 4)
+	f.close()
+
+if __name__ == "__main__":
+	parser = OptionParser(usage = "Usage: elfgen.py [options] OUT.elf [OUT.db]")
+	parser.add_option("--functions", default=1000, dest="functions", metavar="N",
+			  help="Number of functions (default 1000)")
+	parser.add_option("--blocks", default=4, dest="blocks", metavar="N",
+			  help="Conditional branches per function (default 4)")
+	parser.add_option("--calls", default=2, dest="calls", metavar="N",
+			  help="Calls (R_MIPS_26 relocations) per function (default 2)")
+	parser.add_option("--hilos", default=1, dest="hilos", metavar="N",
+			  help="HI16/LO16 pairs with function addresses per function (default 1)")
+	parser.add_option("--rodata-pointers", default=100, dest="rodataPointers", metavar="N",
+			  help="Function pointers in .rodata (default 100)")
+	parser.add_option("--seed", default=1, dest="seed", metavar="N",
+			  help="Random seed for the call targets (default 1)")
+
+	(options, args) = parser.parse_args()
+	if len(args) < 1:
+		parser.error("No output file given")
+
+	opts = Options()
+	opts.functions = int(options.functions)
+	opts.blocks = int(options.blocks)
+	opts.calls = int(options.calls)
+	opts.hilos = int(options.hilos)
+	opts.rodataPointers = int(options.rodataPointers)
+	opts.seed = int(options.seed)
+
+	generate(args[0], opts)
+	if len(args) > 1:
+		generateSyscallDatabase(args[1])
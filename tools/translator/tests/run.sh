@@ -7,8 +7,27 @@ rm -rf html/* out/* lcov.info
 ../xcibyl-translator config:maboo out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
 ../xcibyl-translator config:maboo=1 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
 ../xcibyl-translator config: out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+# The jump table of jr_switch in tests/c/tests/jr_test.c should be recovered
+if ! sed -n '/^\.method public static jr_switch_[0-9a-f]*(/,/^\.end method/p' out/*.j | grep -q tableswitch ; then
+    echo "No tableswitch emitted for jr_switch"
+    exit 1
+fi
 ../xcibyl-translator config:thread_safe=1 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
 ../xcibyl-translator config:prune_call_table=1,call_table_hierarchy=2,class_size_limit=99999999,prune_unused_functions=1,trace_start=0x01000000,trace_end=0x2000000,trace_stores=1 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:java_profile=cldc1.1 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:memory_model=byte out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:check_object_handles=1 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:optimize_tail_calls=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:optimize_jump_tables=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:optimize_call_liveness=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:optimize_constant_muldiv=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:optimize_base_index=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:optimize_load_forwarding=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:inline_syscalls=0 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:cache_rodata_strings=1 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:stats=out/cibyl-stats.txt out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:profile=1,profile_loops=1,profile_time=5 out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
+../xcibyl-translator config:use_profile=cibyl-profile.txt out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
 ../xcibyl-translator config:optimize_partial_memory_operations=1,class_size_limit=99999999 -DMABOO=1  out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
 ../xcibyl-translator "config:colocate_functions=main;test_run_all_tests;vsnprintf,optimize_partial_memory_operations=1,class_size_limit=99999999" -DMABOO=1  out $CIBYL_BASE/tests/c/program $CIBYL_BASE/include/generated/cibyl-syscalls.db $CIBYL_BASE/tests/include/cibyl-syscalls.db
 